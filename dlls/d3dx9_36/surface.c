@@ -1875,6 +1875,128 @@ void point_filter_argb_pixels(const BYTE *src, UINT src_row_pitch, UINT src_slic
     }
 }
 
+/* Each thread pool task gets at least this many rows of blocks; smaller
+ * surfaces are not worth the synchronisation. */
+#define DXT_MIN_BLOCK_ROWS_PER_TASK 16
+#define DXT_MAX_TASKS 16
+
+struct dxt_block_rows_task
+{
+    void (*func)(void *ctx, unsigned int first, unsigned int last);
+    void *ctx;
+    unsigned int first, last;
+    LONG *pending;
+    HANDLE done;
+};
+
+static void CALLBACK dxt_block_rows_callback(TP_CALLBACK_INSTANCE *instance, void *context)
+{
+    struct dxt_block_rows_task *task = context;
+
+    task->func(task->ctx, task->first, task->last);
+    if (!InterlockedDecrement(task->pending))
+        SetEvent(task->done);
+}
+
+/* Splits "row_count" rows of blocks into bands, and calls "func" for each band
+ * from the thread pool. The first band is processed on the calling thread. */
+static void process_dxt_block_rows(unsigned int row_count,
+        void (*func)(void *ctx, unsigned int first, unsigned int last), void *ctx)
+{
+    struct dxt_block_rows_task tasks[DXT_MAX_TASKS];
+    unsigned int i, task_count, band_size;
+    SYSTEM_INFO info;
+    HANDLE done;
+    LONG pending;
+
+    GetSystemInfo(&info);
+    task_count = min(min(info.dwNumberOfProcessors, DXT_MAX_TASKS), row_count / DXT_MIN_BLOCK_ROWS_PER_TASK);
+    if (task_count < 2 || !(done = CreateEventW(NULL, TRUE, FALSE, NULL)))
+    {
+        func(ctx, 0, row_count);
+        return;
+    }
+
+    TRACE("Processing %u rows of blocks in %u tasks.\n", row_count, task_count);
+
+    band_size = (row_count + task_count - 1) / task_count;
+    pending = task_count - 1;
+    for (i = 1; i < task_count; ++i)
+    {
+        tasks[i].func = func;
+        tasks[i].ctx = ctx;
+        tasks[i].first = min(i * band_size, row_count);
+        tasks[i].last = min(tasks[i].first + band_size, row_count);
+        tasks[i].pending = &pending;
+        tasks[i].done = done;
+        if (!TrySubmitThreadpoolCallback(dxt_block_rows_callback, &tasks[i], NULL))
+            dxt_block_rows_callback(NULL, &tasks[i]);
+    }
+    func(ctx, 0, band_size);
+
+    WaitForSingleObject(done, INFINITE);
+    CloseHandle(done);
+}
+
+struct dxt_decompress_context
+{
+    void (*fetch_dxt_block)(const BYTE *blksrc, void *texels);
+    const BYTE *src;
+    unsigned int src_pitch;
+    unsigned int block_byte_count;
+    unsigned int left, top;
+    const struct volume *size;
+    DWORD *dst;
+};
+
+static void decompress_dxt_block_rows(void *ctx, unsigned int first, unsigned int last)
+{
+    const struct dxt_decompress_context *c = ctx;
+    unsigned int bx, by, x, y, x_start, x_end, y_start, y_end;
+    DWORD texels[16];
+
+    for (by = c->top / 4 + first; by < c->top / 4 + last; ++by)
+    {
+        y_start = max(by * 4, c->top);
+        y_end = min(by * 4 + 4, c->top + c->size->height);
+        for (bx = c->left / 4; bx * 4 < c->left + c->size->width; ++bx)
+        {
+            x_start = max(bx * 4, c->left);
+            x_end = min(bx * 4 + 4, c->left + c->size->width);
+            c->fetch_dxt_block(c->src + by * c->src_pitch + bx * c->block_byte_count, texels);
+            for (y = y_start; y < y_end; ++y)
+            {
+                DWORD *ptr = &c->dst[(y - c->top) * c->size->width];
+
+                for (x = x_start; x < x_end; ++x)
+                    ptr[x - c->left] = texels[(y & 3) * 4 + (x & 3)];
+            }
+        }
+    }
+}
+
+struct dxt_compress_context
+{
+    const BYTE *src;
+    unsigned int width, height;
+    GLenum gl_format;
+    BYTE *dst;
+    unsigned int dst_row_stride;
+};
+
+static void compress_dxt_block_rows(void *ctx, unsigned int first, unsigned int last)
+{
+    const struct dxt_compress_context *c = ctx;
+    unsigned int row_pitch = tx_compress_dxtn_row_pitch(c->width, c->gl_format, c->dst_row_stride);
+
+    if (first == last)
+        return;
+
+    tx_compress_dxtn(4, c->width, min(last * 4, c->height) - first * 4,
+            c->src + first * 4 * c->width * sizeof(DWORD), c->gl_format,
+            c->dst + first * row_pitch, c->dst_row_stride);
+}
+
 /************************************************************
  * D3DXLoadSurfaceFromMemory
  *
@@ -2033,9 +2155,7 @@ HRESULT WINAPI D3DXLoadSurfaceFromMemory(IDirect3DSurface9 *dst_surface,
 
         if (srcformatdesc->type == FORMAT_DXT)
         {
-            void (*fetch_dxt_texel)(int srcRowStride, const BYTE *pixdata,
-                    int i, int j, void *texel);
-            unsigned int x, y;
+            struct dxt_decompress_context context;
 
             src_pitch = src_pitch * srcformatdesc->block_width / srcformatdesc->block_byte_count;
 
@@ -2049,31 +2169,31 @@ HRESULT WINAPI D3DXLoadSurfaceFromMemory(IDirect3DSurface9 *dst_surface,
             switch(src_format)
             {
                 case D3DFMT_DXT1:
-                    fetch_dxt_texel = fetch_2d_texel_rgba_dxt1;
+                    context.fetch_dxt_block = fetch_2d_block_rgba_dxt1;
                     break;
                 case D3DFMT_DXT2:
                 case D3DFMT_DXT3:
-                    fetch_dxt_texel = fetch_2d_texel_rgba_dxt3;
+                    context.fetch_dxt_block = fetch_2d_block_rgba_dxt3;
                     break;
                 case D3DFMT_DXT4:
                 case D3DFMT_DXT5:
-                    fetch_dxt_texel = fetch_2d_texel_rgba_dxt5;
+                    context.fetch_dxt_block = fetch_2d_block_rgba_dxt5;
                     break;
                 default:
                     FIXME("Unexpected compressed texture format %u.\n", src_format);
-                    fetch_dxt_texel = NULL;
+                    context.fetch_dxt_block = NULL;
             }
 
             TRACE("Uncompressing DXTn surface.\n");
-            for (y = 0; y < src_size.height; ++y)
-            {
-                DWORD *ptr = &src_uncompressed[y * src_size.width];
-                for (x = 0; x < src_size.width; ++x)
-                {
-                    fetch_dxt_texel(src_pitch, src_memory, x + src_rect->left, y + src_rect->top, ptr);
-                    ++ptr;
-                }
-            }
+            context.src = src_memory;
+            context.src_pitch = (src_pitch + 3) / 4 * srcformatdesc->block_byte_count;
+            context.block_byte_count = srcformatdesc->block_byte_count;
+            context.left = src_rect->left;
+            context.top = src_rect->top;
+            context.size = &src_size;
+            context.dst = src_uncompressed;
+            process_dxt_block_rows((context.top + src_size.height - 1) / 4 - context.top / 4 + 1,
+                    decompress_dxt_block_rows, &context);
             src_memory = src_uncompressed;
             src_pitch = src_size.width * sizeof(DWORD);
             srcformatdesc = get_format_info(D3DFMT_A8B8G8R8);
@@ -2126,6 +2246,7 @@ HRESULT WINAPI D3DXLoadSurfaceFromMemory(IDirect3DSurface9 *dst_surface,
 
         if (dst_uncompressed)
         {
+            struct dxt_compress_context context;
             GLenum gl_format = 0;
 
             TRACE("Compressing DXTn surface.\n");
@@ -2145,9 +2266,13 @@ HRESULT WINAPI D3DXLoadSurfaceFromMemory(IDirect3DSurface9 *dst_surface,
                 default:
                     ERR("Unexpected destination compressed format %u.\n", surfdesc.Format);
             }
-            tx_compress_dxtn(4, dst_size_aligned.width, dst_size_aligned.height,
-                    dst_uncompressed, gl_format, lockrect.pBits,
-                    lockrect.Pitch * destformatdesc->block_width / destformatdesc->block_byte_count);
+            context.src = dst_uncompressed;
+            context.width = dst_size_aligned.width;
+            context.height = dst_size_aligned.height;
+            context.gl_format = gl_format;
+            context.dst = lockrect.pBits;
+            context.dst_row_stride = lockrect.Pitch * destformatdesc->block_width / destformatdesc->block_byte_count;
+            process_dxt_block_rows((dst_size_aligned.height + 3) / 4, compress_dxt_block_rows, &context);
             heap_free(dst_uncompressed);
         }
     }
@@ -1519,6 +1519,63 @@ static void test_D3DXLoadSurface(IDirect3DDevice9 *device)
         check_release((IUnknown*)surf, 0);
     }
 
+    /* Large enough to be compressed and decompressed in several bands. Solid
+     * blocks with R5G6B5 representable colours survive the round trip. */
+    hr = IDirect3DDevice9_CreateTexture(device, 256, 256, 1, 0, D3DFMT_DXT5, D3DPOOL_SYSTEMMEM, &tex, NULL);
+    if (FAILED(hr))
+        skip("Failed to create DXT5 texture, hr %#x.\n", hr);
+    else
+    {
+        unsigned int x, y, bx, by, mismatches = 0;
+        DWORD *pixels, expected, color;
+
+        pixels = HeapAlloc(GetProcessHeap(), 0, 256 * 256 * sizeof(*pixels));
+        for (y = 0; y < 256; ++y)
+        {
+            for (x = 0; x < 256; ++x)
+            {
+                bx = x / 4;
+                by = y / 4;
+                pixels[y * 256 + x] = ((bx ^ by) & 0xf) * 0x11000000
+                        | ((bx & 0x1f) << 19 | (bx & 0x1c) << 14)
+                        | ((by * 3 & 0x3f) << 10 | (by * 3 & 0x30) << 4)
+                        | (((bx + by) & 0x1f) << 3 | ((bx + by) & 0x1c) >> 2);
+            }
+        }
+
+        hr = IDirect3DTexture9_GetSurfaceLevel(tex, 0, &newsurf);
+        ok(hr == D3D_OK, "Got unexpected hr %#x.\n", hr);
+        SetRect(&rect, 0, 0, 256, 256);
+        hr = D3DXLoadSurfaceFromMemory(newsurf, NULL, NULL, pixels, D3DFMT_A8R8G8B8,
+                256 * sizeof(*pixels), NULL, &rect, D3DX_FILTER_NONE, 0);
+        ok(hr == D3D_OK, "Got unexpected hr %#x.\n", hr);
+
+        hr = IDirect3DDevice9_CreateOffscreenPlainSurface(device, 256, 256, D3DFMT_A8R8G8B8,
+                D3DPOOL_SYSTEMMEM, &surf, NULL);
+        ok(hr == D3D_OK, "Got unexpected hr %#x.\n", hr);
+        hr = D3DXLoadSurfaceFromSurface(surf, NULL, NULL, newsurf, NULL, NULL, D3DX_FILTER_NONE, 0);
+        ok(hr == D3D_OK, "Got unexpected hr %#x.\n", hr);
+
+        IDirect3DSurface9_LockRect(surf, &lockrect, NULL, D3DLOCK_READONLY);
+        for (y = 0; y < 256; ++y)
+        {
+            for (x = 0; x < 256; ++x)
+            {
+                expected = pixels[y * 256 + x];
+                color = ((DWORD *)((BYTE *)lockrect.pBits + y * lockrect.Pitch))[x];
+                if (color != expected && !mismatches++)
+                    ok(0, "Got unexpected color 0x%08x, expected 0x%08x at (%u, %u).\n", color, expected, x, y);
+            }
+        }
+        IDirect3DSurface9_UnlockRect(surf);
+        ok(!mismatches, "Got %u mismatching pixels.\n", mismatches);
+
+        check_release((IUnknown *)surf, 0);
+        check_release((IUnknown *)newsurf, 1);
+        check_release((IUnknown *)tex, 0);
+        HeapFree(GetProcessHeap(), 0, pixels);
+    }
+
     /* cleanup */
     if(testdummy_ok) DeleteFileA("testdummy.bmp");
     if(testbitmap_ok) DeleteFileA("testbitmap.bmp");
@@ -839,3 +839,15 @@ void tx_compress_dxtn(GLint srccomps, GLint width, GLint height, const GLubyte *
       return;
    }
 }
+
+/* Returns the distance in bytes between rows of blocks written by
+   tx_compress_dxtn(), so that callers can compress a texture in bands. */
+GLint tx_compress_dxtn_row_pitch(GLint width, GLenum destFormat, GLint dstRowStride)
+{
+   GLint blocksize = destFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+         || destFormat == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT ? 8 : 16;
+
+   if (dstRowStride >= width * blocksize / 4)
+      return dstRowStride;
+   return (width + 3) / 4 * blocksize;
+}
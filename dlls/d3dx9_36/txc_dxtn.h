@@ -44,9 +44,13 @@ void fetch_2d_texel_rgba_dxt3(GLint srcRowStride, const GLubyte *pixdata,
 			     GLint i, GLint j, GLvoid *texel);
 void fetch_2d_texel_rgba_dxt5(GLint srcRowStride, const GLubyte *pixdata,
 			     GLint i, GLint j, GLvoid *texel);
+void fetch_2d_block_rgba_dxt1(const GLubyte *blksrc, GLvoid *texels);
+void fetch_2d_block_rgba_dxt3(const GLubyte *blksrc, GLvoid *texels);
+void fetch_2d_block_rgba_dxt5(const GLubyte *blksrc, GLvoid *texels);
 
 void tx_compress_dxtn(GLint srccomps, GLint width, GLint height,
 		      const GLubyte *srcPixData, GLenum destformat,
 		      GLubyte *dest, GLint dstRowStride);
+GLint tx_compress_dxtn_row_pitch(GLint width, GLenum destformat, GLint dstRowStride);
 
 #endif /* _TXC_DXTN_H */
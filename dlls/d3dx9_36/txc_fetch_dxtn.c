@@ -94,6 +94,53 @@ static void dxt135_decode_imageblock ( const GLubyte *img_block_src,
 }
 
 
+/* Decodes all 16 texels of a block at once, in row order. The palette is only
+   built once, and the results match dxt135_decode_imageblock(). */
+
+static void dxt135_decode_block ( const GLubyte *img_block_src, GLuint dxt_type,
+                         GLchan texels[16][4] ) {
+   const GLushort color0 = img_block_src[0] | (img_block_src[1] << 8);
+   const GLushort color1 = img_block_src[2] | (img_block_src[3] << 8);
+   GLuint bits = img_block_src[4] | (img_block_src[5] << 8) |
+      (img_block_src[6] << 16) | ((GLuint)img_block_src[7] << 24);
+   GLchan palette[4][4];
+   GLint k, c;
+
+   palette[0][RCOMP] = UBYTE_TO_CHAN( EXP5TO8R(color0) );
+   palette[0][GCOMP] = UBYTE_TO_CHAN( EXP6TO8G(color0) );
+   palette[0][BCOMP] = UBYTE_TO_CHAN( EXP5TO8B(color0) );
+   palette[0][ACOMP] = CHAN_MAX;
+   palette[1][RCOMP] = UBYTE_TO_CHAN( EXP5TO8R(color1) );
+   palette[1][GCOMP] = UBYTE_TO_CHAN( EXP6TO8G(color1) );
+   palette[1][BCOMP] = UBYTE_TO_CHAN( EXP5TO8B(color1) );
+   palette[1][ACOMP] = CHAN_MAX;
+   if ((dxt_type > 1) || (color0 > color1)) {
+      palette[2][RCOMP] = UBYTE_TO_CHAN( ((EXP5TO8R(color0) * 2 + EXP5TO8R(color1)) / 3) );
+      palette[2][GCOMP] = UBYTE_TO_CHAN( ((EXP6TO8G(color0) * 2 + EXP6TO8G(color1)) / 3) );
+      palette[2][BCOMP] = UBYTE_TO_CHAN( ((EXP5TO8B(color0) * 2 + EXP5TO8B(color1)) / 3) );
+      palette[3][RCOMP] = UBYTE_TO_CHAN( ((EXP5TO8R(color0) + EXP5TO8R(color1) * 2) / 3) );
+      palette[3][GCOMP] = UBYTE_TO_CHAN( ((EXP6TO8G(color0) + EXP6TO8G(color1) * 2) / 3) );
+      palette[3][BCOMP] = UBYTE_TO_CHAN( ((EXP5TO8B(color0) + EXP5TO8B(color1) * 2) / 3) );
+      palette[3][ACOMP] = CHAN_MAX;
+   }
+   else {
+      palette[2][RCOMP] = UBYTE_TO_CHAN( ((EXP5TO8R(color0) + EXP5TO8R(color1)) / 2) );
+      palette[2][GCOMP] = UBYTE_TO_CHAN( ((EXP6TO8G(color0) + EXP6TO8G(color1)) / 2) );
+      palette[2][BCOMP] = UBYTE_TO_CHAN( ((EXP5TO8B(color0) + EXP5TO8B(color1)) / 2) );
+      palette[3][RCOMP] = 0;
+      palette[3][GCOMP] = 0;
+      palette[3][BCOMP] = 0;
+      palette[3][ACOMP] = dxt_type == 1 ? UBYTE_TO_CHAN(0) : CHAN_MAX;
+   }
+   palette[2][ACOMP] = CHAN_MAX;
+
+   for (k = 0; k < 16; k++, bits >>= 2) {
+      for (c = 0; c < 4; c++) {
+         texels[k][c] = palette[bits & 3][c];
+      }
+   }
+}
+
 void fetch_2d_texel_rgb_dxt1(GLint srcRowStride, const GLubyte *pixdata,
                          GLint i, GLint j, GLvoid *texel)
 {
@@ -241,3 +288,52 @@ void fetch_2d_texel_rgba_dxt5(GLint srcRowStride, const GLubyte *pixdata,
       rgba[ACOMP] = CHAN_MAX;
 #endif
 }
+
+void fetch_2d_block_rgba_dxt1(const GLubyte *blksrc, GLvoid *texels)
+{
+   /* Extract all 16 pixels of the block at blksrc, in row order. */
+
+   dxt135_decode_block(blksrc, 1, texels);
+}
+
+void fetch_2d_block_rgba_dxt3(const GLubyte *blksrc, GLvoid *texels)
+{
+   GLchan (*rgba)[4] = texels;
+   GLint k;
+
+   dxt135_decode_block(blksrc + 8, 2, texels);
+   for (k = 0; k < 16; k++) {
+      const GLubyte anibble = (blksrc[k / 2] >> (4 * (k & 1))) & 0xf;
+      rgba[k][ACOMP] = UBYTE_TO_CHAN( (GLubyte)(EXP4TO8(anibble)) );
+   }
+}
+
+void fetch_2d_block_rgba_dxt5(const GLubyte *blksrc, GLvoid *texels)
+{
+   GLchan (*rgba)[4] = texels;
+   const GLubyte alpha0 = blksrc[0];
+   const GLubyte alpha1 = blksrc[1];
+   GLuint bits_low = blksrc[2] | (blksrc[3] << 8) | (blksrc[4] << 16);
+   GLuint bits_high = blksrc[5] | (blksrc[6] << 8) | (blksrc[7] << 16);
+   GLchan alpha[8];
+   GLint k;
+
+   alpha[0] = UBYTE_TO_CHAN( alpha0 );
+   alpha[1] = UBYTE_TO_CHAN( alpha1 );
+   for (k = 2; k < 8; k++) {
+      if (alpha0 > alpha1)
+         alpha[k] = UBYTE_TO_CHAN( ((alpha0 * (8 - k) + (alpha1 * (k - 1))) / 7) );
+      else if (k < 6)
+         alpha[k] = UBYTE_TO_CHAN( ((alpha0 * (6 - k) + (alpha1 * (k - 1))) / 5) );
+      else if (k == 6)
+         alpha[k] = 0;
+      else
+         alpha[k] = CHAN_MAX;
+   }
+
+   dxt135_decode_block(blksrc + 8, 2, texels);
+   for (k = 0; k < 8; k++, bits_low >>= 3, bits_high >>= 3) {
+      rgba[k][ACOMP] = alpha[bits_low & 7];
+      rgba[k + 8][ACOMP] = alpha[bits_high & 7];
+   }
+}
@@ -477,6 +477,98 @@ static void test_VirtualAllocFromApp(void)
             p, GetLastError());
 }
 
+static void test_large_pages(void)
+{
+    MEMORY_BASIC_INFORMATION info;
+    TOKEN_PRIVILEGES privs;
+    SIZE_T min_size;
+    HANDLE token;
+    char *p, *base;
+    BOOL ret;
+
+    min_size = GetLargePageMinimum();
+    if (!min_size)
+    {
+        skip("Large pages are not supported.\n");
+        return;
+    }
+    ok(!(min_size & (min_size - 1)), "Got unexpected large page minimum %#lx.\n", min_size);
+    ok(!(min_size % si.dwAllocationGranularity), "Got unexpected large page minimum %#lx.\n", min_size);
+
+    SetLastError(0xdeadbeef);
+    p = VirtualAlloc(NULL, min_size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    ok(!p, "Got unexpected mem %p.\n", p);
+    ok(GetLastError() == ERROR_PRIVILEGE_NOT_HELD, "Got unexpected error %u.\n", GetLastError());
+
+    privs.PrivilegeCount = 1;
+    privs.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES, &token) ||
+        !LookupPrivilegeValueA(NULL, SE_LOCK_MEMORY_NAME, &privs.Privileges[0].Luid) ||
+        !AdjustTokenPrivileges(token, FALSE, &privs, sizeof(privs), NULL, NULL) ||
+        GetLastError() == ERROR_NOT_ALL_ASSIGNED)
+    {
+        skip("Cannot enable SE_LOCK_MEMORY_NAME privilege.\n");
+        CloseHandle(token);
+        return;
+    }
+
+    SetLastError(0xdeadbeef);
+    p = VirtualAlloc(NULL, min_size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    if (!p && GetLastError() == ERROR_NO_SYSTEM_RESOURCES)
+    {
+        /* physical memory is too fragmented */
+        skip("Cannot allocate large pages.\n");
+        goto done;
+    }
+    ok(!!p, "Got unexpected error %u.\n", GetLastError());
+    ok(!((ULONG_PTR)p & (min_size - 1)), "Got unaligned mem %p.\n", p);
+    ret = VirtualQuery(p, &info, sizeof(info));
+    ok(ret, "VirtualQuery failed, error %u.\n", GetLastError());
+    ok(info.AllocationBase == p, "Got unexpected allocation base %p.\n", info.AllocationBase);
+    ok(info.RegionSize == min_size, "Got unexpected region size %#lx.\n", info.RegionSize);
+    ok(info.State == MEM_COMMIT, "Got unexpected state %#x.\n", info.State);
+    ok(info.Protect == PAGE_READWRITE, "Got unexpected protection %#x.\n", info.Protect);
+    p[0] = p[min_size - 1] = 1;
+    ret = VirtualFree(p, 0, MEM_RELEASE);
+    ok(ret, "VirtualFree failed, error %u.\n", GetLastError());
+
+    /* the size is rounded up to the large page minimum */
+    SetLastError(0xdeadbeef);
+    p = VirtualAlloc(NULL, min_size + si.dwPageSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    ok(!!p || broken(GetLastError() == ERROR_INVALID_PARAMETER), "Got unexpected error %u.\n", GetLastError());
+    if (p)
+    {
+        ret = VirtualQuery(p, &info, sizeof(info));
+        ok(ret, "VirtualQuery failed, error %u.\n", GetLastError());
+        ok(info.RegionSize == 2 * min_size, "Got unexpected region size %#lx.\n", info.RegionSize);
+        ret = VirtualFree(p, 0, MEM_RELEASE);
+        ok(ret, "VirtualFree failed, error %u.\n", GetLastError());
+    }
+
+    /* large pages must be reserved and committed at once */
+    SetLastError(0xdeadbeef);
+    p = VirtualAlloc(NULL, min_size, MEM_RESERVE | MEM_LARGE_PAGES, PAGE_READWRITE);
+    ok(!p, "Got unexpected mem %p.\n", p);
+    ok(GetLastError() == ERROR_INVALID_PARAMETER, "Got unexpected error %u.\n", GetLastError());
+
+    /* the base address must be aligned to the large page minimum */
+    base = VirtualAlloc(NULL, 3 * min_size, MEM_RESERVE, PAGE_NOACCESS);
+    ok(!!base, "VirtualAlloc failed, error %u.\n", GetLastError());
+    ret = VirtualFree(base, 0, MEM_RELEASE);
+    ok(ret, "VirtualFree failed, error %u.\n", GetLastError());
+    base = (char *)(((ULONG_PTR)base + min_size - 1) & ~(min_size - 1));
+    SetLastError(0xdeadbeef);
+    p = VirtualAlloc(base + si.dwAllocationGranularity, min_size,
+                     MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    ok(!p, "Got unexpected mem %p.\n", p);
+    ok(GetLastError() == ERROR_INVALID_PARAMETER, "Got unexpected error %u.\n", GetLastError());
+
+done:
+    privs.Privileges[0].Attributes = 0;
+    AdjustTokenPrivileges(token, FALSE, &privs, sizeof(privs), NULL, NULL);
+    CloseHandle(token);
+}
+
 static void test_MapViewOfFile(void)
 {
     static const char testfile[] = "testfile.xxx";
@@ -4356,6 +4448,7 @@ START_TEST(virtual)
     test_VirtualAllocEx();
     test_VirtualAlloc();
     test_VirtualAllocFromApp();
+    test_large_pages();
     test_MapViewOfFile();
     test_NtAreMappedFilesTheSame();
     test_CreateFileMapping();
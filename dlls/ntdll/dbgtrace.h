@@ -0,0 +1,266 @@
+/*
+ * Binary debug trace records
+ *
+ * Copyright (C) the Wine project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef __WINE_NTDLL_DBGTRACE_H
+#define __WINE_NTDLL_DBGTRACE_H
+
+/* When WINE_TRACE_BUFFER is set, debug messages are stored as log records holding the format
+ * string and the raw arguments, and only formatted by tools/decode-trace. The record starts
+ * with struct trace_log_record, followed by the channel name, function name and format string,
+ * each nul-terminated, and by the arguments in format order:
+ * - integers, characters and pointers as 64-bit values, sign- or zero-extended as printf would,
+ * - floating point values as doubles,
+ * - strings as a 32-bit length, ~0 for NULL, followed by the characters, in UTF-16 for wide strings,
+ * - '*' widths and precisions as 64-bit values.
+ * Records that don't fit in the buffer are cut short and the decoder prints the rest of the
+ * format string verbatim. */
+
+#define TRACE_LOG_FUNCTION  0x01  /* print the class, channel and function prefix */
+#define TRACE_LOG_UNIX      0x02  /* formatted with the Unix C library conventions */
+#define TRACE_LOG_PTR64     0x04  /* pointers are 64-bit */
+
+struct trace_log_record
+{
+    unsigned char cls;       /* debug class */
+    unsigned char flags;     /* TRACE_LOG_* flags */
+    unsigned char reserved[2];
+};
+
+#define TRACE_LOG_MAX_STRING 1024
+
+#ifdef WINE_UNIX_LIB
+typedef wchar_t trace_wchar_t;
+#else
+typedef WCHAR trace_wchar_t;
+#endif
+
+static inline BOOL trace_put( char **pos, const char *end, const void *data, size_t len )
+{
+    if (len > (size_t)(end - *pos)) return FALSE;
+    memcpy( *pos, data, len );
+    *pos += len;
+    return TRUE;
+}
+
+static inline BOOL trace_put_int( char **pos, const char *end, ULONG64 val )
+{
+    return trace_put( pos, end, &val, sizeof(val) );
+}
+
+static inline BOOL trace_put_double( char **pos, const char *end, double val )
+{
+    return trace_put( pos, end, &val, sizeof(val) );
+}
+
+/* store a nul-terminated string, truncated to the available space */
+static inline void trace_put_name( char **pos, const char *end, const char *str )
+{
+    size_t len = str ? strlen( str ) : 0;
+
+    if (*pos == end) return;
+    len = min( len, (size_t)(end - *pos) - 1 );
+    memcpy( *pos, str, len );
+    (*pos)[len] = 0;
+    *pos += len + 1;
+}
+
+static inline BOOL trace_put_str( char **pos, const char *end, const char *str, int prec )
+{
+    UINT len = 0;
+
+    if (!str) len = ~0u;
+    else while (len < TRACE_LOG_MAX_STRING && (prec < 0 || len < (UINT)prec) && str[len]) len++;
+    if (!trace_put( pos, end, &len, sizeof(len) )) return FALSE;
+    return !str || trace_put( pos, end, str, len );
+}
+
+static inline BOOL trace_put_wstr( char **pos, const char *end, const trace_wchar_t *str, int prec )
+{
+    UINT i, len = 0;
+    WCHAR ch;
+
+    if (!str) len = ~0u;
+    else while (len < TRACE_LOG_MAX_STRING && (prec < 0 || len < (UINT)prec) && str[len]) len++;
+    if (!trace_put( pos, end, &len, sizeof(len) )) return FALSE;
+    for (i = 0; str && i < len; i++)
+    {
+        ch = str[i];
+        if (!trace_put( pos, end, &ch, sizeof(ch) )) return FALSE;
+    }
+    return TRUE;
+}
+
+enum trace_arg_size
+{
+    TRACE_ARG_INT,
+    TRACE_ARG_CHAR,
+    TRACE_ARG_SHORT,
+    TRACE_ARG_LONG,
+    TRACE_ARG_INT64,
+    TRACE_ARG_PTR,
+    TRACE_ARG_LONGDOUBLE
+};
+
+/***********************************************************************
+ *		trace_encode_log
+ *
+ * Store a debug message into a log record, without formatting it. Returns the record size.
+ */
+static inline unsigned int trace_encode_log( char *buffer, unsigned int size, enum __wine_debug_class cls,
+                                             const char *channel, const char *function,
+                                             const char *format, __wine_dbg_va_list args )
+{
+    struct trace_log_record *rec = (struct trace_log_record *)buffer;
+    char *pos = (char *)(rec + 1);
+    const char *end = buffer + size, *p;
+    enum trace_arg_size arg_size;
+    BOOL wide, ok = TRUE;
+    int prec;
+
+    rec->cls = cls;
+    rec->flags = (function ? TRACE_LOG_FUNCTION : 0) | (sizeof(void *) == 8 ? TRACE_LOG_PTR64 : 0);
+#ifdef WINE_UNIX_LIB
+    rec->flags |= TRACE_LOG_UNIX;
+#endif
+    rec->reserved[0] = rec->reserved[1] = 0;
+    trace_put_name( &pos, end, channel );
+    trace_put_name( &pos, end, function );
+    trace_put_name( &pos, end, format );
+
+    for (p = format; ok && *p; p++)
+    {
+        if (*p != '%') continue;
+        if (*++p == '%') continue;
+
+        while (*p && strchr( "-+ #0'", *p )) p++;
+        if (*p == '*')
+        {
+            ok = trace_put_int( &pos, end, (LONG64)va_arg( args, int ));
+            p++;
+        }
+        else while (*p >= '0' && *p <= '9') p++;
+
+        prec = -1;
+        if (*p == '.')
+        {
+            p++;
+            if (*p == '*')
+            {
+                prec = va_arg( args, int );
+                ok = ok && trace_put_int( &pos, end, (LONG64)prec );
+                p++;
+            }
+            else for (prec = 0; *p >= '0' && *p <= '9'; p++) prec = prec * 10 + *p - '0';
+        }
+        if (!ok) break;
+
+        arg_size = TRACE_ARG_INT;
+        wide = FALSE;
+        for (;;)
+        {
+            if (*p == 'h')
+            {
+                arg_size = (p[1] == 'h') ? TRACE_ARG_CHAR : TRACE_ARG_SHORT;
+                p += (p[1] == 'h') ? 2 : 1;
+            }
+            else if (*p == 'l')
+            {
+                if (p[1] == 'l') arg_size = TRACE_ARG_INT64;
+                else arg_size = TRACE_ARG_LONG;
+                p += (p[1] == 'l') ? 2 : 1;
+                wide = TRUE;
+            }
+            else if (*p == 'L') { arg_size = TRACE_ARG_LONGDOUBLE; p++; }
+            else if (*p == 'q' || *p == 'j') { arg_size = TRACE_ARG_INT64; p++; }
+            else if (*p == 'z' || *p == 't') { arg_size = TRACE_ARG_PTR; p++; }
+            else if (*p == 'w') { wide = TRUE; p++; }
+            else if (*p == 'I' && p[1] == '6' && p[2] == '4') { arg_size = TRACE_ARG_INT64; p += 3; }
+            else if (*p == 'I' && p[1] == '3' && p[2] == '2') { arg_size = TRACE_ARG_INT; p += 3; }
+            else if (*p == 'I') { arg_size = TRACE_ARG_PTR; p++; }
+            else break;
+        }
+
+        switch (*p)
+        {
+        case 'd':
+        case 'i':
+            switch (arg_size)
+            {
+            case TRACE_ARG_CHAR:  ok = trace_put_int( &pos, end, (signed char)va_arg( args, int )); break;
+            case TRACE_ARG_SHORT: ok = trace_put_int( &pos, end, (short)va_arg( args, int )); break;
+            case TRACE_ARG_LONG:  ok = trace_put_int( &pos, end, va_arg( args, long )); break;
+            case TRACE_ARG_INT64:
+            case TRACE_ARG_LONGDOUBLE: ok = trace_put_int( &pos, end, va_arg( args, LONG64 )); break;
+            case TRACE_ARG_PTR:   ok = trace_put_int( &pos, end, va_arg( args, INT_PTR )); break;
+            default:              ok = trace_put_int( &pos, end, va_arg( args, int )); break;
+            }
+            break;
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            switch (arg_size)
+            {
+            case TRACE_ARG_CHAR:  ok = trace_put_int( &pos, end, (unsigned char)va_arg( args, int )); break;
+            case TRACE_ARG_SHORT: ok = trace_put_int( &pos, end, (unsigned short)va_arg( args, int )); break;
+            case TRACE_ARG_LONG:  ok = trace_put_int( &pos, end, va_arg( args, unsigned long )); break;
+            case TRACE_ARG_INT64:
+            case TRACE_ARG_LONGDOUBLE: ok = trace_put_int( &pos, end, va_arg( args, ULONG64 )); break;
+            case TRACE_ARG_PTR:   ok = trace_put_int( &pos, end, va_arg( args, ULONG_PTR )); break;
+            default:              ok = trace_put_int( &pos, end, va_arg( args, unsigned int )); break;
+            }
+            break;
+        case 'c':
+        case 'C':
+            ok = trace_put_int( &pos, end, (wide || *p == 'C') ? (WCHAR)va_arg( args, int )
+                                                              : (unsigned char)va_arg( args, int ));
+            break;
+        case 's':
+        case 'S':
+            if (wide || *p == 'S') ok = trace_put_wstr( &pos, end, va_arg( args, const trace_wchar_t * ), prec );
+            else ok = trace_put_str( &pos, end, va_arg( args, const char * ), prec );
+            break;
+        case 'p':
+            ok = trace_put_int( &pos, end, (ULONG_PTR)va_arg( args, void * ));
+            break;
+        case 'e':
+        case 'E':
+        case 'f':
+        case 'F':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            if (arg_size == TRACE_ARG_LONGDOUBLE) ok = trace_put_double( &pos, end, va_arg( args, long double ));
+            else ok = trace_put_double( &pos, end, va_arg( args, double ));
+            break;
+        case 'n':
+            va_arg( args, void * );
+            break;
+        default:  /* unknown argument type, the decoder prints the rest of the format */
+            ok = FALSE;
+            break;
+        }
+        if (!*p) break;
+    }
+    return pos - buffer;
+}
+
+#endif  /* __WINE_NTDLL_DBGTRACE_H */
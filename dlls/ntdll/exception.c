@@ -293,10 +293,18 @@ struct dynamic_unwind_entry
     DWORD             max_count;
     PGET_RUNTIME_FUNCTION_CALLBACK callback;
     PVOID             context;
+    ULONG             seq;       /* registration order, the first registered entry wins on overlap */
 };
 
 static struct list dynamic_unwind_list = LIST_INIT(dynamic_unwind_list);
 
+/* entries sorted by base address, for lookups by address */
+static struct dynamic_unwind_entry **dynamic_unwind_sorted;
+static ULONG_PTR *dynamic_unwind_max_end;  /* highest end address of the sorted entries up to each index */
+static unsigned int dynamic_unwind_count;
+static unsigned int dynamic_unwind_size;
+static ULONG dynamic_unwind_seq;
+
 static RTL_CRITICAL_SECTION dynamic_unwind_section;
 static RTL_CRITICAL_SECTION_DEBUG dynamic_unwind_debug =
 {
@@ -344,12 +352,107 @@ static ULONG_PTR get_runtime_function_end( RUNTIME_FUNCTION *func, ULONG_PTR add
 #endif
 }
 
+/* find the index of the first sorted entry with a base address above addr */
+static unsigned int dynamic_unwind_upper_bound( ULONG_PTR addr )
+{
+    unsigned int min = 0, max = dynamic_unwind_count;
+
+    while (min < max)
+    {
+        unsigned int pos = (min + max) / 2;
+        if (dynamic_unwind_sorted[pos]->base <= addr) min = pos + 1;
+        else max = pos;
+    }
+    return min;
+}
+
+static void update_dynamic_unwind_max_end( unsigned int pos )
+{
+    for ( ; pos < dynamic_unwind_count; pos++)
+    {
+        ULONG_PTR end = dynamic_unwind_sorted[pos]->end;
+        if (pos && dynamic_unwind_max_end[pos - 1] > end) end = dynamic_unwind_max_end[pos - 1];
+        dynamic_unwind_max_end[pos] = end;
+    }
+}
+
+/* add an entry to the dynamic unwind list; dynamic_unwind_section must be held */
+static BOOL add_dynamic_unwind_entry( struct dynamic_unwind_entry *entry )
+{
+    unsigned int pos;
+
+    if (dynamic_unwind_count == dynamic_unwind_size)
+    {
+        unsigned int new_size = max( 16, dynamic_unwind_size * 2 );
+        struct dynamic_unwind_entry **sorted;
+        ULONG_PTR *max_end;
+
+        if (!dynamic_unwind_sorted)
+        {
+            sorted = RtlAllocateHeap( GetProcessHeap(), 0, new_size * sizeof(*sorted) );
+            max_end = RtlAllocateHeap( GetProcessHeap(), 0, new_size * sizeof(*max_end) );
+        }
+        else
+        {
+            sorted = RtlReAllocateHeap( GetProcessHeap(), 0, dynamic_unwind_sorted, new_size * sizeof(*sorted) );
+            max_end = RtlReAllocateHeap( GetProcessHeap(), 0, dynamic_unwind_max_end, new_size * sizeof(*max_end) );
+        }
+        if (sorted) dynamic_unwind_sorted = sorted;
+        if (max_end) dynamic_unwind_max_end = max_end;
+        if (!sorted || !max_end) return FALSE;
+        dynamic_unwind_size = new_size;
+    }
+
+    pos = dynamic_unwind_upper_bound( entry->base );
+    memmove( dynamic_unwind_sorted + pos + 1, dynamic_unwind_sorted + pos,
+             (dynamic_unwind_count - pos) * sizeof(*dynamic_unwind_sorted) );
+    dynamic_unwind_sorted[pos] = entry;
+    dynamic_unwind_count++;
+    update_dynamic_unwind_max_end( pos );
+
+    entry->seq = dynamic_unwind_seq++;
+    list_add_tail( &dynamic_unwind_list, &entry->entry );
+    return TRUE;
+}
+
+/* remove an entry from the dynamic unwind list; dynamic_unwind_section must be held */
+static void remove_dynamic_unwind_entry( struct dynamic_unwind_entry *entry )
+{
+    unsigned int pos = dynamic_unwind_upper_bound( entry->base );
+
+    while (pos-- && dynamic_unwind_sorted[pos] != entry) ;
+    assert( pos < dynamic_unwind_count );
+    memmove( dynamic_unwind_sorted + pos, dynamic_unwind_sorted + pos + 1,
+             (dynamic_unwind_count - pos - 1) * sizeof(*dynamic_unwind_sorted) );
+    dynamic_unwind_count--;
+    update_dynamic_unwind_max_end( pos );
+
+    list_remove( &entry->entry );
+}
+
+/* find the entry containing an address; dynamic_unwind_section must be held */
+static struct dynamic_unwind_entry *find_dynamic_unwind_entry( ULONG_PTR pc )
+{
+    struct dynamic_unwind_entry *entry, *ret = NULL;
+    unsigned int pos = dynamic_unwind_upper_bound( pc );
+
+    /* walk back over the entries starting below pc, as long as some of them may still contain it */
+    while (pos-- && dynamic_unwind_max_end[pos] > pc)
+    {
+        entry = dynamic_unwind_sorted[pos];
+        if (pc < entry->end && (!ret || entry->seq < ret->seq)) ret = entry;
+    }
+    return ret;
+}
+
+
 /**********************************************************************
  *              RtlAddFunctionTable   (NTDLL.@)
  */
 BOOLEAN CDECL RtlAddFunctionTable( RUNTIME_FUNCTION *table, DWORD count, ULONG_PTR addr )
 {
     struct dynamic_unwind_entry *entry;
+    BOOL ret;
 
     TRACE( "%p %u %lx\n", table, count, addr );
 
@@ -368,9 +471,10 @@ BOOLEAN CDECL RtlAddFunctionTable( RUNTIME_FUNCTION *table, DWORD count, ULONG_P
     entry->context   = NULL;
 
     RtlEnterCriticalSection( &dynamic_unwind_section );
-    list_add_tail( &dynamic_unwind_list, &entry->entry );
+    ret = add_dynamic_unwind_entry( entry );
     RtlLeaveCriticalSection( &dynamic_unwind_section );
-    return TRUE;
+    if (!ret) RtlFreeHeap( GetProcessHeap(), 0, entry );
+    return ret;
 }
 
 
@@ -382,6 +486,7 @@ BOOLEAN CDECL RtlInstallFunctionTableCallback( ULONG_PTR table, ULONG_PTR base,
                                                PCWSTR dll )
 {
     struct dynamic_unwind_entry *entry;
+    BOOL ret;
 
     TRACE( "%lx %lx %d %p %p %s\n", table, base, length, callback, context, wine_dbgstr_w(dll) );
 
@@ -404,10 +509,11 @@ BOOLEAN CDECL RtlInstallFunctionTableCallback( ULONG_PTR table, ULONG_PTR base,
     entry->context   = context;
 
     RtlEnterCriticalSection( &dynamic_unwind_section );
-    list_add_tail( &dynamic_unwind_list, &entry->entry );
+    ret = add_dynamic_unwind_entry( entry );
     RtlLeaveCriticalSection( &dynamic_unwind_section );
+    if (!ret) RtlFreeHeap( GetProcessHeap(), 0, entry );
 
-    return TRUE;
+    return ret;
 }
 
 
@@ -418,6 +524,7 @@ DWORD WINAPI RtlAddGrowableFunctionTable( void **table, RUNTIME_FUNCTION *functi
                                           DWORD max_count, ULONG_PTR base, ULONG_PTR end )
 {
     struct dynamic_unwind_entry *entry;
+    BOOL ret;
 
     TRACE( "%p, %p, %u, %u, %lx, %lx\n", table, functions, count, max_count, base, end );
 
@@ -434,8 +541,13 @@ DWORD WINAPI RtlAddGrowableFunctionTable( void **table, RUNTIME_FUNCTION *functi
     entry->context   = NULL;
 
     RtlEnterCriticalSection( &dynamic_unwind_section );
-    list_add_tail( &dynamic_unwind_list, &entry->entry );
+    ret = add_dynamic_unwind_entry( entry );
     RtlLeaveCriticalSection( &dynamic_unwind_section );
+    if (!ret)
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, entry );
+        return STATUS_NO_MEMORY;
+    }
 
     *table = entry;
 
@@ -481,7 +593,7 @@ void WINAPI RtlDeleteGrowableFunctionTable( void *table )
         if (entry == table)
         {
             to_free = entry;
-            list_remove( &entry->entry );
+            remove_dynamic_unwind_entry( entry );
             break;
         }
     }
@@ -506,7 +618,7 @@ BOOLEAN CDECL RtlDeleteFunctionTable( RUNTIME_FUNCTION *table )
         if (entry->table == table)
         {
             to_free = entry;
-            list_remove( &entry->entry );
+            remove_dynamic_unwind_entry( entry );
             break;
         }
     }
@@ -521,7 +633,8 @@ BOOLEAN CDECL RtlDeleteFunctionTable( RUNTIME_FUNCTION *table )
 
 /* helper for lookup_function_info() */
 static RUNTIME_FUNCTION *find_function_info( ULONG_PTR pc, ULONG_PTR base,
-                                             RUNTIME_FUNCTION *func, ULONG size )
+                                             RUNTIME_FUNCTION *func, ULONG size,
+                                             ULONG_PTR *start, ULONG_PTR *end )
 {
     int min = 0;
     int max = size - 1;
@@ -535,6 +648,8 @@ static RUNTIME_FUNCTION *find_function_info( ULONG_PTR pc, ULONG_PTR base,
         else
         {
             func += pos;
+            *start = base + func->BeginAddress;
+            *end = base + func->EndAddress;
             while (func->UnwindData & 1)  /* follow chained entry */
                 func = (RUNTIME_FUNCTION *)(base + (func->UnwindData & ~1));
             return func;
@@ -542,18 +657,92 @@ static RUNTIME_FUNCTION *find_function_info( ULONG_PTR pc, ULONG_PTR base,
 #elif defined(__arm__)
         int pos = (min + max) / 2;
         if (pc < base + (func[pos].BeginAddress & ~1)) max = pos - 1;
-        else if (pc >= base + get_runtime_function_end( &func[pos], base )) min = pos + 1;
-        else return func + pos;
+        else if (pc >= (*end = base + get_runtime_function_end( &func[pos], base ))) min = pos + 1;
+        else
+        {
+            *start = base + (func[pos].BeginAddress & ~1);
+            return func + pos;
+        }
 #else  /* __aarch64__ */
         int pos = (min + max) / 2;
         if (pc < base + func[pos].BeginAddress) max = pos - 1;
-        else if (pc >= base + get_runtime_function_end( &func[pos], base )) min = pos + 1;
-        else return func + pos;
+        else if (pc >= (*end = base + get_runtime_function_end( &func[pos], base ))) min = pos + 1;
+        else
+        {
+            *start = base + func[pos].BeginAddress;
+            return func + pos;
+        }
 #endif
     }
     return NULL;
 }
 
+/* Cache of recent lookups in the exception tables of loaded modules, indexed by address.
+ * Entries are updated under a sequence counter so that lookups don't need any locking,
+ * and are invalidated when a module is unloaded. */
+
+#define UNWIND_CACHE_SIZE 512
+
+struct unwind_cache_entry
+{
+    LONG                  seq;         /* odd while the entry is being updated */
+    LONG                  generation;  /* value of unwind_cache_generation when added */
+    ULONG_PTR             start;       /* address range covered by the function entry */
+    ULONG_PTR             end;
+    ULONG_PTR             base;
+    RUNTIME_FUNCTION     *func;
+    LDR_DATA_TABLE_ENTRY *module;
+};
+
+static struct unwind_cache_entry unwind_cache[UNWIND_CACHE_SIZE];
+static LONG unwind_cache_generation;
+
+static inline struct unwind_cache_entry *get_unwind_cache_entry( ULONG_PTR pc )
+{
+    return &unwind_cache[(pc >> 4) % UNWIND_CACHE_SIZE];
+}
+
+static RUNTIME_FUNCTION *lookup_unwind_cache( ULONG_PTR pc, ULONG_PTR *base, LDR_DATA_TABLE_ENTRY **module )
+{
+    volatile struct unwind_cache_entry *entry = get_unwind_cache_entry( pc );
+    struct unwind_cache_entry copy;
+    LONG seq = entry->seq;
+
+    if (seq & 1) return NULL;
+    MemoryBarrier();
+    copy.generation = entry->generation;
+    copy.start      = entry->start;
+    copy.end        = entry->end;
+    copy.base       = entry->base;
+    copy.func       = entry->func;
+    copy.module     = entry->module;
+    MemoryBarrier();
+    if (entry->seq != seq) return NULL;
+
+    if (!copy.func || copy.generation != unwind_cache_generation) return NULL;
+    if (pc < copy.start || pc >= copy.end) return NULL;
+    *base = copy.base;
+    *module = copy.module;
+    return copy.func;
+}
+
+static void add_unwind_cache( ULONG_PTR pc, ULONG_PTR start, ULONG_PTR end, ULONG_PTR base,
+                              RUNTIME_FUNCTION *func, LDR_DATA_TABLE_ENTRY *module, LONG generation )
+{
+    struct unwind_cache_entry *entry = get_unwind_cache_entry( pc );
+    LONG seq = entry->seq;
+
+    /* don't wait if another thread is updating the entry */
+    if ((seq & 1) || InterlockedCompareExchange( &entry->seq, seq + 1, seq ) != seq) return;
+    entry->generation = generation;
+    entry->start      = start;
+    entry->end        = end;
+    entry->base       = base;
+    entry->func       = func;
+    entry->module     = module;
+    InterlockedExchange( &entry->seq, seq + 2 );
+}
+
 /**********************************************************************
  *           lookup_function_info
  */
@@ -561,8 +750,12 @@ RUNTIME_FUNCTION *lookup_function_info( ULONG_PTR pc, ULONG_PTR *base, LDR_DATA_
 {
     RUNTIME_FUNCTION *func = NULL;
     struct dynamic_unwind_entry *entry;
+    ULONG_PTR start, end;
+    LONG generation = unwind_cache_generation;
     ULONG size;
 
+    if ((func = lookup_unwind_cache( pc, base, module ))) return func;
+
     /* PE module or wine module */
     if (!LdrFindEntryForAddress( (void *)pc, module ))
     {
@@ -571,7 +764,9 @@ RUNTIME_FUNCTION *lookup_function_info( ULONG_PTR pc, ULONG_PTR *base, LDR_DATA_
                                                   IMAGE_DIRECTORY_ENTRY_EXCEPTION, &size )))
         {
             /* lookup in function table */
-            func = find_function_info( pc, (ULONG_PTR)(*module)->DllBase, func, size/sizeof(*func) );
+            func = find_function_info( pc, (ULONG_PTR)(*module)->DllBase, func, size/sizeof(*func),
+                                       &start, &end );
+            if (func) add_unwind_cache( pc, start, end, *base, func, *module, generation );
         }
     }
     else
@@ -579,18 +774,14 @@ RUNTIME_FUNCTION *lookup_function_info( ULONG_PTR pc, ULONG_PTR *base, LDR_DATA_
         *module = NULL;
 
         RtlEnterCriticalSection( &dynamic_unwind_section );
-        LIST_FOR_EACH_ENTRY( entry, &dynamic_unwind_list, struct dynamic_unwind_entry, entry )
+        if ((entry = find_dynamic_unwind_entry( pc )))
         {
-            if (pc >= entry->base && pc < entry->end)
-            {
-                *base = entry->base;
-                /* use callback or lookup in function table */
-                if (entry->callback)
-                    func = entry->callback( pc, entry->context );
-                else
-                    func = find_function_info( pc, entry->base, entry->table, entry->count );
-                break;
-            }
+            *base = entry->base;
+            /* use callback or lookup in function table */
+            if (entry->callback)
+                func = entry->callback( pc, entry->context );
+            else
+                func = find_function_info( pc, entry->base, entry->table, entry->count, &start, &end );
         }
         RtlLeaveCriticalSection( &dynamic_unwind_section );
     }
@@ -598,6 +789,16 @@ RUNTIME_FUNCTION *lookup_function_info( ULONG_PTR pc, ULONG_PTR *base, LDR_DATA_
     return func;
 }
 
+/**********************************************************************
+ *           invalidate_unwind_cache
+ *
+ * Called by the loader when a module is unloaded.
+ */
+void invalidate_unwind_cache(void)
+{
+    InterlockedIncrement( &unwind_cache_generation );
+}
+
 /**********************************************************************
  *              RtlLookupFunctionEntry   (NTDLL.@)
  */
@@ -617,6 +818,12 @@ PRUNTIME_FUNCTION WINAPI RtlLookupFunctionEntry( ULONG_PTR pc, ULONG_PTR *base,
     return func;
 }
 
+#else  /* __x86_64__ || __arm__ || __aarch64__ */
+
+void invalidate_unwind_cache(void)
+{
+}
+
 #endif  /* __x86_64__ || __arm__ || __aarch64__ */
 
 
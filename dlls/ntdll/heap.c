@@ -126,6 +126,14 @@ typedef union
 
 struct tagHEAP;
 
+struct DECLSPEC_ALIGN(8) heap_profile_stats
+{
+    LONG64              live;       /* Bytes currently allocated */
+    LONG64              peak;       /* Peak of allocated bytes */
+    LONG64              allocs;     /* Number of allocations */
+    LONG64              frees;      /* Number of frees */
+};
+
 typedef struct tagSUBHEAP
 {
     void               *base;       /* Base address of the sub-heap memory block */
@@ -163,6 +171,7 @@ typedef struct tagHEAP
     RTL_CRITICAL_SECTION critSection; /* Critical section for serialization */
     FREE_LIST_ENTRY *freeList;      /* Free lists */
     int              extended_type; /* Extended heap type */
+    struct heap_profile_stats profile; /* Usage statistics when profiling is enabled */
 } HEAP;
 
 #define HEAP_MAGIC       ((DWORD)('H' | ('E'<<8) | ('A'<<16) | ('P'<<24)))
@@ -927,6 +936,7 @@ static SUBHEAP *HEAP_CreateSubHeap( HEAP *heap, LPVOID address, DWORD flags,
         heap->grow_size     = max( HEAP_DEF_SIZE, totalSize );
         list_init( &heap->subheap_list );
         list_init( &heap->large_list );
+        memset( &heap->profile, 0, sizeof(heap->profile) );
 
         subheap = &heap->subheap;
         subheap->base       = address;
@@ -1507,6 +1517,308 @@ static void heap_set_debug_flags( HANDLE handle )
 }
 
 
+/***********************************************************************
+ * Heap profiling
+ *
+ * Enabled by setting WINE_HEAP_PROFILE to the name of the output file (a DOS
+ * path, or a Unix path starting with '/'). Every allocation then updates the
+ * size histogram and the per-heap counters, and about one allocation every
+ * WINE_HEAP_PROFILE_RATE bytes (512KiB by default) gets its backtrace recorded.
+ * The profile is written at process exit, and every time the
+ * Global\WineHeapProfile_<pid> event is signaled.
+ */
+
+#define PROFILE_HISTOGRAM_SIZE (sizeof(SIZE_T) * 8 + 1)
+#define PROFILE_MAX_FRAMES     16
+#define PROFILE_MAX_SITES      4096  /* must be a power of two */
+#define PROFILE_DEFAULT_RATE   (512 * 1024)
+
+struct heap_profile_site
+{
+    ULONG               hash;        /* backtrace hash from RtlCaptureStackBackTrace */
+    ULONG               frame_count; /* number of valid frames, 0 if the entry is free */
+    LONG64              count;       /* number of sampled allocations */
+    LONG64              bytes;       /* bytes requested by the sampled allocations */
+    void               *frames[PROFILE_MAX_FRAMES];
+};
+
+struct heap_profile_writer
+{
+    HANDLE              file;
+    SIZE_T              pos;
+    char                buffer[4096];
+};
+
+static BOOL heap_profile_enabled;
+static WCHAR heap_profile_path[MAX_PATH];
+static LONG64 heap_profile_rate = PROFILE_DEFAULT_RATE;
+static LONG64 DECLSPEC_ALIGN(8) heap_profile_countdown = PROFILE_DEFAULT_RATE;
+static LONG64 DECLSPEC_ALIGN(8) heap_profile_histogram[PROFILE_HISTOGRAM_SIZE];
+static struct heap_profile_site *heap_profile_sites;
+static LONG heap_profile_dropped;
+static HANDLE heap_profile_event;
+
+static RTL_CRITICAL_SECTION heap_profile_section;
+static RTL_CRITICAL_SECTION_DEBUG heap_profile_section_debug =
+{
+    0, 0, &heap_profile_section,
+    { &heap_profile_section_debug.ProcessLocksList, &heap_profile_section_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": heap_profile_section") }
+};
+static RTL_CRITICAL_SECTION heap_profile_section = { &heap_profile_section_debug, -1, 0, 0, 0, 0 };
+
+static inline LONG64 interlocked_add64( LONG64 volatile *dest, LONG64 val )
+{
+    LONG64 old, tmp = *dest;
+    do old = tmp; while ((tmp = InterlockedCompareExchange64( dest, old + val, old )) != old);
+    return old + val;
+}
+
+static void heap_profile_sample( SIZE_T size, void **frames, ULONG count, ULONG hash )
+{
+    struct heap_profile_site *site = NULL;
+    ULONG i;
+
+    RtlEnterCriticalSection( &heap_profile_section );
+    for (i = 0; i < PROFILE_MAX_SITES; i++)
+    {
+        site = &heap_profile_sites[(hash + i) & (PROFILE_MAX_SITES - 1)];
+        if (!site->frame_count)
+        {
+            site->hash = hash;
+            site->frame_count = count;
+            memcpy( site->frames, frames, count * sizeof(*frames) );
+            break;
+        }
+        if (site->hash == hash && site->frame_count == count &&
+            !memcmp( site->frames, frames, count * sizeof(*frames) ))
+            break;
+    }
+    if (i < PROFILE_MAX_SITES)
+    {
+        site->count++;
+        site->bytes += size;
+    }
+    else heap_profile_dropped++;
+    RtlLeaveCriticalSection( &heap_profile_section );
+}
+
+/* returns TRUE when the caller should record a backtrace with heap_profile_sample() */
+static BOOL heap_profile_alloc( HEAP *heap, SIZE_T size )
+{
+    LONG64 live, peak, left;
+    SIZE_T tmp;
+    unsigned int bucket;
+
+    /* bucket n counts the allocations with 2^(n-1) < size <= 2^n */
+    for (bucket = 0, tmp = size ? size - 1 : 0; tmp; bucket++) tmp >>= 1;
+    interlocked_add64( &heap_profile_histogram[bucket], 1 );
+
+    interlocked_add64( &heap->profile.allocs, 1 );
+    live = interlocked_add64( &heap->profile.live, size );
+    while ((peak = heap->profile.peak) < live &&
+           InterlockedCompareExchange64( &heap->profile.peak, live, peak ) != peak);
+
+    if ((left = interlocked_add64( &heap_profile_countdown, -(LONG64)size )) > 0) return FALSE;
+    interlocked_add64( &heap_profile_countdown, (-left / heap_profile_rate + 1) * heap_profile_rate );
+    return TRUE;
+}
+
+static void heap_profile_free( HEAP *heap, SIZE_T size )
+{
+    interlocked_add64( &heap->profile.frees, 1 );
+    interlocked_add64( &heap->profile.live, -(LONG64)size );
+}
+
+static void heap_profile_flush( struct heap_profile_writer *writer )
+{
+    IO_STATUS_BLOCK io;
+
+    if (writer->pos) NtWriteFile( writer->file, 0, NULL, NULL, &io, writer->buffer, writer->pos, NULL, NULL );
+    writer->pos = 0;
+}
+
+static void WINAPIV heap_profile_printf( struct heap_profile_writer *writer, const char *format, ... )
+{
+    va_list args;
+    int len;
+
+    if (writer->pos > sizeof(writer->buffer) - 512) heap_profile_flush( writer );
+
+    va_start( args, format );
+    len = _vsnprintf( writer->buffer + writer->pos, sizeof(writer->buffer) - writer->pos, format, args );
+    va_end( args );
+    writer->pos += len >= 0 ? len : sizeof(writer->buffer) - writer->pos;
+}
+
+static void heap_profile_dump_heap( struct heap_profile_writer *writer, HEAP *heap )
+{
+    SIZE_T committed = 0, free = 0, largest = 0, size;
+    SUBHEAP *subheap;
+    ARENA_LARGE *large;
+    struct list *ptr;
+
+    RtlEnterCriticalSection( &heap->critSection );
+
+    LIST_FOR_EACH_ENTRY( subheap, &heap->subheap_list, SUBHEAP, entry )
+        committed += subheap->commitSize;
+    LIST_FOR_EACH_ENTRY( large, &heap->large_list, ARENA_LARGE, entry )
+        committed += large->block_size;
+    LIST_FOR_EACH( ptr, &heap->freeList[0].arena.entry )
+    {
+        size = LIST_ENTRY( ptr, ARENA_FREE, entry )->size & ARENA_SIZE_MASK;
+        free += size;
+        largest = max( largest, size );
+    }
+
+    heap_profile_printf( writer, "heap %p type %u live %I64d peak %I64d allocs %I64d frees %I64d "
+                         "committed %Iu free %Iu largest_free %Iu fragmentation %Iu%%\n",
+                         heap, heap->extended_type, heap->profile.live, heap->profile.peak,
+                         heap->profile.allocs, heap->profile.frees, committed, free, largest,
+                         free ? 100 - largest * 100 / free : 0 );
+
+    RtlLeaveCriticalSection( &heap->critSection );
+}
+
+static void heap_profile_dump_frame( struct heap_profile_writer *writer, void *pc )
+{
+    LDR_DATA_TABLE_ENTRY *mod;
+    char name[256];
+    DWORD len;
+
+    if (!LdrFindEntryForAddress( pc, &mod ) &&
+        !RtlUnicodeToUTF8N( name, sizeof(name) - 1, &len, mod->BaseDllName.Buffer, mod->BaseDllName.Length ))
+    {
+        name[len] = 0;
+        heap_profile_printf( writer, "    %p %s+0x%Ix\n", pc, name, (ULONG_PTR)pc - (ULONG_PTR)mod->DllBase );
+    }
+    else heap_profile_printf( writer, "    %p\n", pc );
+}
+
+/***********************************************************************
+ *           heap_profile_dump
+ *
+ * Write the current heap profile to the output file.
+ */
+static void heap_profile_dump(void)
+{
+    static const WCHAR unix_prefixW[] = L"\\??\\unix";
+    struct heap_profile_writer writer;
+    struct heap_profile_site *site;
+    UNICODE_STRING nt_name;
+    OBJECT_ATTRIBUTES attr;
+    IO_STATUS_BLOCK io;
+    ULONG_PTR magic;
+    struct list *ptr;
+    unsigned int i, j;
+    NTSTATUS status;
+
+    if (heap_profile_path[0] == '/')
+    {
+        nt_name.MaximumLength = sizeof(unix_prefixW) + wcslen( heap_profile_path ) * sizeof(WCHAR);
+        if (!(nt_name.Buffer = RtlAllocateHeap( GetProcessHeap(), 0, nt_name.MaximumLength ))) return;
+        wcscpy( nt_name.Buffer, unix_prefixW );
+        wcscat( nt_name.Buffer, heap_profile_path );
+        nt_name.Length = wcslen( nt_name.Buffer ) * sizeof(WCHAR);
+    }
+    else if (!RtlDosPathNameToNtPathName_U( heap_profile_path, &nt_name, NULL, NULL )) return;
+
+    InitializeObjectAttributes( &attr, &nt_name, OBJ_CASE_INSENSITIVE, 0, NULL );
+    status = NtCreateFile( &writer.file, FILE_GENERIC_WRITE | SYNCHRONIZE, &attr, &io, NULL, 0,
+                           FILE_SHARE_READ, FILE_OVERWRITE_IF,
+                           FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT, NULL, 0 );
+    RtlFreeUnicodeString( &nt_name );
+    if (status)
+    {
+        WARN( "failed to create %s, status %#x\n", debugstr_w(heap_profile_path), status );
+        return;
+    }
+    writer.pos = 0;
+
+    heap_profile_printf( &writer, "# Wine heap profile, process %04x, sampling rate %I64d\n",
+                         HandleToULong( NtCurrentTeb()->ClientId.UniqueProcess ), heap_profile_rate );
+
+    RtlEnterCriticalSection( &processHeap->critSection );
+    heap_profile_dump_heap( &writer, processHeap );
+    LIST_FOR_EACH( ptr, &processHeap->entry )
+        heap_profile_dump_heap( &writer, LIST_ENTRY( ptr, HEAP, entry ) );
+    RtlLeaveCriticalSection( &processHeap->critSection );
+
+    for (i = 0; i < PROFILE_HISTOGRAM_SIZE; i++)
+    {
+        if (!heap_profile_histogram[i]) continue;
+        heap_profile_printf( &writer, "size %I64u count %I64d\n",
+                             i < sizeof(SIZE_T) * 8 ? (ULONGLONG)1 << i : ~(ULONGLONG)0,
+                             heap_profile_histogram[i] );
+    }
+
+    LdrLockLoaderLock( 0, NULL, &magic );
+    RtlEnterCriticalSection( &heap_profile_section );
+    for (i = 0; i < PROFILE_MAX_SITES; i++)
+    {
+        site = &heap_profile_sites[i];
+        if (!site->frame_count) continue;
+        heap_profile_printf( &writer, "site samples %I64d bytes %I64d\n", site->count, site->bytes );
+        for (j = 0; j < site->frame_count; j++) heap_profile_dump_frame( &writer, site->frames[j] );
+    }
+    if (heap_profile_dropped) heap_profile_printf( &writer, "dropped %u\n", heap_profile_dropped );
+    RtlLeaveCriticalSection( &heap_profile_section );
+    LdrUnlockLoaderLock( 0, magic );
+
+    heap_profile_flush( &writer );
+    NtClose( writer.file );
+}
+
+static void CALLBACK heap_profile_event_callback( void *context, BOOLEAN timeout )
+{
+    heap_profile_dump();
+}
+
+/***********************************************************************
+ *           HEAP_profile_init
+ *
+ * Enable heap profiling; must be called before the process heap is created.
+ */
+void HEAP_profile_init( const WCHAR *path, ULONG rate )
+{
+    SIZE_T size = PROFILE_MAX_SITES * sizeof(*heap_profile_sites);
+    void *addr = NULL;
+
+    if (wcslen( path ) >= ARRAY_SIZE(heap_profile_path)) return;
+    if (NtAllocateVirtualMemory( NtCurrentProcess(), &addr, 0, &size, MEM_COMMIT, PAGE_READWRITE ))
+        return;
+
+    wcscpy( heap_profile_path, path );
+    if (rate) heap_profile_rate = heap_profile_countdown = rate;
+    heap_profile_sites = addr;
+    heap_profile_enabled = TRUE;
+}
+
+/***********************************************************************
+ *           HEAP_profile_start
+ *
+ * Register the event used to request profile dumps; called once the
+ * process is initialized enough to start thread pool threads.
+ */
+void HEAP_profile_start(void)
+{
+    UNICODE_STRING name;
+    OBJECT_ATTRIBUTES attr;
+    WCHAR buffer[64];
+    HANDLE wait;
+
+    if (!heap_profile_enabled) return;
+
+    swprintf( buffer, ARRAY_SIZE(buffer), L"\\BaseNamedObjects\\WineHeapProfile_%04x",
+              HandleToULong( NtCurrentTeb()->ClientId.UniqueProcess ) );
+    RtlInitUnicodeString( &name, buffer );
+    InitializeObjectAttributes( &attr, &name, OBJ_OPENIF, 0, NULL );
+    if (NtCreateEvent( &heap_profile_event, EVENT_ALL_ACCESS, &attr, SynchronizationEvent, FALSE ))
+        return;
+    RtlRegisterWait( &wait, heap_profile_event, heap_profile_event_callback, NULL, INFINITE, 0 );
+}
+
+
 /***********************************************************************
  *           RtlCreateHeap   (NTDLL.@)
  *
@@ -1667,7 +1979,19 @@ void * WINAPI DECLSPEC_HOTPATCH RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_
     }
 
     TRACE("(%p,%08x,%08lx), status %#x, ptr %p\n", heapPtr, flags, size, status, ptr );
-    if (!status) return ptr;
+    if (!status)
+    {
+        if (heap_profile_enabled && heap_profile_alloc( heapPtr, size ))
+        {
+            void *frames[PROFILE_MAX_FRAMES];
+            ULONG hash, count;
+
+            /* captured from the entry point, so that only our own frame needs skipping */
+            if ((count = RtlCaptureStackBackTrace( 1, PROFILE_MAX_FRAMES, frames, &hash )))
+                heap_profile_sample( size, frames, count, hash );
+        }
+        return ptr;
+    }
     if ((flags & HEAP_GENERATE_EXCEPTIONS) && status == STATUS_NO_MEMORY) RtlRaiseStatus( status );
     RtlSetLastWin32ErrorAndNtStatusFromNtStatus( status );
     return NULL;
@@ -1739,6 +2063,7 @@ BOOLEAN WINAPI DECLSPEC_HOTPATCH RtlFreeHeap( HANDLE heap, ULONG flags, void *pt
 {
     NTSTATUS status;
     HEAP *heapPtr;
+    SIZE_T old_size = 0;
 
     /* Validate the parameters */
 
@@ -1757,17 +2082,23 @@ BOOLEAN WINAPI DECLSPEC_HOTPATCH RtlFreeHeap( HANDLE heap, ULONG flags, void *pt
     switch (heapPtr->extended_type)
     {
     case HEAP_LFH:
+        if (heap_profile_enabled && HEAP_lfh_get_allocated_size( heap, flags, ptr, &old_size )) old_size = 0;
         if (!(status = HEAP_lfh_free( heap, flags, ptr ))) break;
         /* fallthrough */
     default:
         if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
+        if (heap_profile_enabled && HEAP_std_get_allocated_size( heap, flags, ptr, &old_size )) old_size = 0;
         status = HEAP_std_free( heap, flags, ptr );
         if (!(flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heapPtr->critSection );
         break;
     }
 
     TRACE("(%p,%08x,%p), status %#x\n", heapPtr, flags, ptr, status );
-    if (!status) return TRUE;
+    if (!status)
+    {
+        if (heap_profile_enabled) heap_profile_free( heapPtr, old_size );
+        return TRUE;
+    }
     RtlSetLastWin32ErrorAndNtStatusFromNtStatus( status );
     return FALSE;
 }
@@ -1813,6 +2144,7 @@ PVOID WINAPI RtlReAllocateHeap( HANDLE heap, ULONG flags, PVOID ptr, SIZE_T size
 {
     NTSTATUS status;
     HEAP *heapPtr;
+    SIZE_T old_size = 0;
     void *ret;
 
     if (!ptr) return NULL;
@@ -1831,17 +2163,34 @@ PVOID WINAPI RtlReAllocateHeap( HANDLE heap, ULONG flags, PVOID ptr, SIZE_T size
     switch (heapPtr->extended_type)
     {
     case HEAP_LFH:
+        if (heap_profile_enabled && HEAP_lfh_get_allocated_size( heap, flags, ptr, &old_size )) old_size = 0;
         if (!(status = HEAP_lfh_reallocate( heap, flags, ptr, size, &ret ))) break;
         /* fallthrough */
     default:
         if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
+        if (heap_profile_enabled && HEAP_std_get_allocated_size( heap, flags, ptr, &old_size )) old_size = 0;
         status = HEAP_std_reallocate( heap, flags, ptr, size, &ret );
         if (!(flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heapPtr->critSection );
         break;
     }
 
     TRACE("(%p,%08x,%p,%08lx): returning %p, status %#x\n", heapPtr, flags, ptr, size, ret, status );
-    if (!status) return ret;
+    if (!status)
+    {
+        if (heap_profile_enabled)
+        {
+            heap_profile_free( heapPtr, old_size );
+            if (heap_profile_alloc( heapPtr, size ))
+            {
+                void *frames[PROFILE_MAX_FRAMES];
+                ULONG hash, count;
+
+                if ((count = RtlCaptureStackBackTrace( 1, PROFILE_MAX_FRAMES, frames, &hash )))
+                    heap_profile_sample( size, frames, count, hash );
+            }
+        }
+        return ret;
+    }
     if ((flags & HEAP_GENERATE_EXCEPTIONS) && (status == STATUS_NO_MEMORY)) RtlRaiseStatus( status );
     RtlSetLastWin32ErrorAndNtStatusFromNtStatus( status );
     return NULL;
@@ -2350,5 +2699,6 @@ NTSTATUS WINAPI RtlSetHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS info_
 
 void HEAP_notify_thread_destroy( BOOLEAN last )
 {
+    if (last && heap_profile_enabled) heap_profile_dump();
     HEAP_lfh_notify_thread_destroy( last );
 }
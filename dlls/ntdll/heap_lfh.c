@@ -41,6 +41,8 @@ typedef struct LFH_slist LFH_slist;
 #define LARGE_ARENA_SIZE 0x400000 /* 4MiB */
 #define LARGE_ARENA_MASK (LARGE_ARENA_SIZE - 1)
 
+#define LARGE_PAGE_SIZE 0x200000 /* 2MiB */
+
 #define BLOCK_ARENA_SIZE 0x10000 /* 64kiB */
 #define BLOCK_ARENA_MASK (BLOCK_ARENA_SIZE - 1)
 
@@ -255,6 +257,29 @@ static inline void *LFH_memory_allocate(size_t size)
     return addr;
 }
 
+/* large arenas are backed by large pages when WINE_HEAP_LARGE_PAGES is set, to reduce TLB misses */
+C_ASSERT(LARGE_ARENA_SIZE % LARGE_PAGE_SIZE == 0);
+
+/* only written during process initialization */
+BOOL heap_large_pages = FALSE;
+
+static inline void *LFH_memory_allocate_large(size_t size)
+{
+    void *addr = NULL;
+    SIZE_T alloc_size = size;
+
+    if (!heap_large_pages) return LFH_memory_allocate(size);
+
+    if (NtAllocateVirtualMemory(NtCurrentProcess(), (void **)&addr, 0, &alloc_size,
+                                MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE))
+    {
+        WARN("failed to allocate large pages\n");
+        return LFH_memory_allocate(size);
+    }
+
+    return addr;
+}
+
 static inline BOOLEAN LFH_memory_deallocate(void *addr, size_t size)
 {
     SIZE_T release_size = 0;
@@ -446,7 +471,7 @@ static inline LFH_arena *LFH_allocate_large_arena(LFH_heap *heap, LFH_class *cla
     LFH_arena *arena;
 
     if ((arena = heap->cached_large_arena) ||
-        (arena = LFH_memory_allocate(LARGE_ARENA_SIZE)))
+        (arena = LFH_memory_allocate_large(LARGE_ARENA_SIZE)))
     {
         heap->cached_large_arena = NULL;
         LFH_arena_initialize(heap, class, arena, 0);
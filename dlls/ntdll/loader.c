@@ -127,13 +127,38 @@ struct file_id
     BYTE ObjectId[16];
 };
 
+/* hash index of the exported names of a module */
+struct export_hash
+{
+    const IMAGE_EXPORT_DIRECTORY *exports;  /* export directory the index was built for */
+    DWORD                         names;    /* AddressOfNames the index was built for */
+    DWORD                         count;    /* NumberOfNames the index was built for */
+    DWORD                         mask;     /* size of the table - 1 */
+    struct
+    {
+        DWORD hash;                          /* name hash */
+        DWORD index;                         /* index in the names table + 1, 0 if the slot is free */
+    } table[1];
+};
+
+/* resolved forwarded export */
+struct export_forward
+{
+    const char *forward;     /* forward string the entry was resolved for */
+    FARPROC     proc;        /* resolved function */
+    ULONG       generation;  /* value of export_forward_generation when resolved */
+};
+
 /* internal representation of loaded modules */
 typedef struct _wine_modref
 {
-    LDR_DATA_TABLE_ENTRY  ldr;
-    struct file_id        id;
-    ULONG                 CheckSum;
-    BOOL                  system;
+    LDR_DATA_TABLE_ENTRY   ldr;
+    struct file_id         id;
+    ULONG                  CheckSum;
+    BOOL                   system;
+    struct export_hash    *export_hash;      /* lazily built index of the exported names */
+    struct export_forward *export_forwards;  /* resolved forwards, indexed by ordinal */
+    DWORD                  forward_count;    /* size of the export_forwards array */
 } WINE_MODREF;
 
 static UINT tls_module_count;      /* number of modules with TLS directory */
@@ -182,6 +207,8 @@ static WINE_MODREF *cached_modref;
 static WINE_MODREF *current_modref;
 static WINE_MODREF *last_failed_modref;
 
+static ULONG export_forward_generation = 1;  /* incremented when a module is unloaded */
+
 static LDR_DDAG_NODE *node_ntdll, *node_kernel32;
 
 static NTSTATUS load_dll( const WCHAR *load_path, const WCHAR *libname, DWORD flags, WINE_MODREF** pwm, BOOL system );
@@ -190,6 +217,8 @@ static FARPROC find_ordinal_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY
                                     DWORD exp_size, DWORD ordinal, LPCWSTR load_path );
 static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *exports,
                                   DWORD exp_size, const char *name, int hint, LPCWSTR load_path );
+static FARPROC find_cached_forwarded_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *exports,
+                                             DWORD ordinal, const char *forward, LPCWSTR load_path );
 
 /* convert PE image VirtualAddress to Real Address */
 static inline void *get_rva( HMODULE module, DWORD va )
@@ -857,6 +886,52 @@ static FARPROC find_forwarded_export( HMODULE module, const char *forward, LPCWS
 }
 
 
+/*************************************************************************
+ *		find_cached_forwarded_export
+ *
+ * Find the final function pointer for a forwarded function, caching the result in the
+ * module so that the target module doesn't need to be looked up again.
+ * The loader_section must be locked while calling this function.
+ */
+static FARPROC find_cached_forwarded_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *exports,
+                                             DWORD ordinal, const char *forward, LPCWSTR load_path )
+{
+    struct export_forward *cache;
+    WINE_MODREF *wm;
+    FARPROC proc;
+
+    /* relay and snoop thunks depend on the importing module */
+    if (TRACE_ON(relay) || TRACE_ON(snoop)) return find_forwarded_export( module, forward, load_path );
+
+    if ((wm = get_modref( module )) && ordinal < wm->forward_count)
+    {
+        cache = &wm->export_forwards[ordinal];
+        if (cache->proc && cache->forward == forward && cache->generation == export_forward_generation)
+            return cache->proc;
+    }
+
+    if (!(proc = find_forwarded_export( module, forward, load_path ))) return NULL;
+
+    /* resolving the forward may have loaded or unloaded modules, look up the module again */
+    if (!(wm = get_modref( module ))) return proc;
+    if (!wm->export_forwards)
+    {
+        if (!(wm->export_forwards = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                                     exports->NumberOfFunctions * sizeof(*cache) )))
+            return proc;
+        wm->forward_count = exports->NumberOfFunctions;
+    }
+    if (ordinal < wm->forward_count)
+    {
+        cache = &wm->export_forwards[ordinal];
+        cache->forward = forward;
+        cache->proc = proc;
+        cache->generation = export_forward_generation;
+    }
+    return proc;
+}
+
+
 /*************************************************************************
  *		find_ordinal_export
  *
@@ -882,7 +957,7 @@ static FARPROC find_ordinal_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY
     /* if the address falls into the export dir, it's a forward */
     if (((const char *)proc >= (const char *)exports) && 
         ((const char *)proc < (const char *)exports + exp_size))
-        return find_forwarded_export( module, (const char *)proc, load_path );
+        return find_cached_forwarded_export( module, exports, ordinal, (const char *)proc, load_path );
 
     if (TRACE_ON(snoop))
     {
@@ -899,13 +974,12 @@ static FARPROC find_ordinal_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY
 
 
 /*************************************************************************
- *		find_name_in_exports
+ *		find_name_index_in_exports
  *
- * Helper for find_named_export.
+ * Binary search of a name in the exports names table.
  */
-static int find_name_in_exports( HMODULE module, const IMAGE_EXPORT_DIRECTORY *exports, const char *name )
+static int find_name_index_in_exports( HMODULE module, const IMAGE_EXPORT_DIRECTORY *exports, const char *name )
 {
-    const WORD *ordinals = get_rva( module, exports->AddressOfNameOrdinals );
     const DWORD *names = get_rva( module, exports->AddressOfNames );
     int min = 0, max = exports->NumberOfNames - 1;
 
@@ -913,7 +987,7 @@ static int find_name_in_exports( HMODULE module, const IMAGE_EXPORT_DIRECTORY *e
     {
         int res, pos = (min + max) / 2;
         char *ename = get_rva( module, names[pos] );
-        if (!(res = strcmp( ename, name ))) return ordinals[pos];
+        if (!(res = strcmp( ename, name ))) return pos;
         if (res > 0) max = pos - 1;
         else min = pos + 1;
     }
@@ -921,6 +995,90 @@ static int find_name_in_exports( HMODULE module, const IMAGE_EXPORT_DIRECTORY *e
 }
 
 
+/*************************************************************************
+ *		find_name_in_exports
+ *
+ * Helper for find_named_export.
+ */
+static int find_name_in_exports( HMODULE module, const IMAGE_EXPORT_DIRECTORY *exports, const char *name )
+{
+    const WORD *ordinals = get_rva( module, exports->AddressOfNameOrdinals );
+    int pos = find_name_index_in_exports( module, exports, name );
+
+    return pos == -1 ? -1 : ordinals[pos];
+}
+
+
+static DWORD hash_export_name( const char *name )
+{
+    DWORD hash = 0x811c9dc5;  /* FNV-1a */
+    while (*name) hash = (hash ^ (BYTE)*name++) * 0x01000193;
+    return hash;
+}
+
+
+/*************************************************************************
+ *		get_export_hash
+ *
+ * Get the hash index of the exported names of a module, building it if needed.
+ * The loader_section must be locked while calling this function.
+ */
+static struct export_hash *get_export_hash( WINE_MODREF *wm, const IMAGE_EXPORT_DIRECTORY *exports )
+{
+    struct export_hash *hash = wm->export_hash;
+    const DWORD *names;
+    DWORD i, size, pos;
+
+    /* rebuild the index if the export directory has been modified */
+    if (hash && hash->exports == exports && hash->names == exports->AddressOfNames &&
+        hash->count == exports->NumberOfNames) return hash;
+
+    RtlFreeHeap( GetProcessHeap(), 0, hash );
+    wm->export_hash = NULL;
+
+    for (size = 16; size < 2 * exports->NumberOfNames; size *= 2) ;
+    if (!(hash = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                  offsetof( struct export_hash, table[size] ) ))) return NULL;
+    hash->exports = exports;
+    hash->names   = exports->AddressOfNames;
+    hash->count   = exports->NumberOfNames;
+    hash->mask    = size - 1;
+
+    names = get_rva( wm->ldr.DllBase, exports->AddressOfNames );
+    for (i = 0; i < exports->NumberOfNames; i++)
+    {
+        DWORD h = hash_export_name( get_rva( wm->ldr.DllBase, names[i] ));
+        for (pos = h & hash->mask; hash->table[pos].index; pos = (pos + 1) & hash->mask) ;
+        hash->table[pos].hash = h;
+        hash->table[pos].index = i + 1;
+    }
+    TRACE( "built export index for %s, %u names\n", debugstr_w(wm->ldr.BaseDllName.Buffer),
+           exports->NumberOfNames );
+    return wm->export_hash = hash;
+}
+
+
+/*************************************************************************
+ *		find_hashed_name_in_exports
+ *
+ * Find the index of a name in the exports names table, using the module hash index.
+ */
+static int find_hashed_name_in_exports( WINE_MODREF *wm, const struct export_hash *hash,
+                                        const IMAGE_EXPORT_DIRECTORY *exports, const char *name )
+{
+    const DWORD *names = get_rva( wm->ldr.DllBase, exports->AddressOfNames );
+    DWORD h = hash_export_name( name ), pos;
+
+    for (pos = h & hash->mask; hash->table[pos].index; pos = (pos + 1) & hash->mask)
+    {
+        DWORD index = hash->table[pos].index - 1;
+        if (hash->table[pos].hash == h && !strcmp( get_rva( wm->ldr.DllBase, names[index] ), name ))
+            return index;
+    }
+    return -1;
+}
+
+
 /*************************************************************************
  *		find_named_export
  *
@@ -932,7 +1090,9 @@ static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *
 {
     const WORD *ordinals = get_rva( module, exports->AddressOfNameOrdinals );
     const DWORD *names = get_rva( module, exports->AddressOfNames );
-    int ordinal;
+    struct export_hash *hash;
+    WINE_MODREF *wm;
+    int pos;
 
     /* first check the hint */
     if (hint >= 0 && hint < exports->NumberOfNames)
@@ -942,10 +1102,14 @@ static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *
             return find_ordinal_export( module, exports, exp_size, ordinals[hint], load_path );
     }
 
-    /* then do a binary search */
-    if ((ordinal = find_name_in_exports( module, exports, name )) == -1) return NULL;
-    return find_ordinal_export( module, exports, exp_size, ordinal, load_path );
+    /* then use the module index, or do a binary search */
+    if ((wm = get_modref( module )) && (hash = get_export_hash( wm, exports )))
+        pos = find_hashed_name_in_exports( wm, hash, exports, name );
+    else
+        pos = find_name_index_in_exports( module, exports, name );
 
+    if (pos == -1) return NULL;
+    return find_ordinal_export( module, exports, exp_size, ordinals[pos], load_path );
 }
 
 
@@ -3780,9 +3944,13 @@ static void free_modref( WINE_MODREF *wm )
 
     free_tls_slot( &wm->ldr );
     RtlReleaseActivationContext( wm->ldr.ActivationContext );
+    invalidate_unwind_cache();
     NtUnmapViewOfSection( NtCurrentProcess(), wm->ldr.DllBase );
     if (cached_modref == wm) cached_modref = NULL;
+    export_forward_generation++;  /* forwards resolved to this module are no longer valid */
     RtlFreeUnicodeString( &wm->ldr.FullDllName );
+    RtlFreeHeap( GetProcessHeap(), 0, wm->export_hash );
+    RtlFreeHeap( GetProcessHeap(), 0, wm->export_forwards );
     RtlFreeHeap( GetProcessHeap(), 0, wm );
 }
 
@@ -4116,7 +4284,7 @@ void WINAPI LdrInitializeThunk( CONTEXT *context, ULONG_PTR unknown2, ULONG_PTR
         ANSI_STRING func_name;
         WINE_MODREF *kernel32;
         PEB *peb = NtCurrentTeb()->Peb;
-        WCHAR env_str[16];
+        WCHAR env_str[16], heap_profile_path[MAX_PATH];
         DWORD hci = 2;
 
         peb->LdrData            = &ldr;
@@ -4134,6 +4302,21 @@ void WINAPI LdrInitializeThunk( CONTEXT *context, ULONG_PTR unknown2, ULONG_PTR
             }
         }
 
+        if (get_env( L"WINE_HEAP_LARGE_PAGES", env_str, sizeof(env_str)) && env_str[0] == L'1')
+        {
+            TRACE( "Using large pages for the low fragmentation heap.\n" );
+            heap_large_pages = TRUE;
+        }
+
+        if (get_env( L"WINE_HEAP_PROFILE", heap_profile_path, sizeof(heap_profile_path) ))
+        {
+            ULONG rate = 0;
+
+            if (get_env( L"WINE_HEAP_PROFILE_RATE", env_str, sizeof(env_str) ))
+                rate = wcstoul( env_str, NULL, 10 );
+            HEAP_profile_init( heap_profile_path, rate );
+        }
+
         peb->ProcessHeap        = RtlCreateHeap( HEAP_GROWABLE, NULL, 0, 0, NULL, NULL );
 
         RtlInitializeBitMap( &tls_bitmap, peb->TlsBitmapBits, sizeof(peb->TlsBitmapBits) * 8 );
@@ -4188,6 +4371,7 @@ void WINAPI LdrInitializeThunk( CONTEXT *context, ULONG_PTR unknown2, ULONG_PTR
             NtTerminateProcess( GetCurrentProcess(), status );
         }
         imports_fixup_done = TRUE;
+        HEAP_profile_start();
     }
     else wm = get_modref( NtCurrentTeb()->Peb->ImageBaseAddress );
 
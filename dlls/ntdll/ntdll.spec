@@ -1644,10 +1644,12 @@
 
 # Debugging
 @ stdcall -syscall -norelay __wine_dbg_write(ptr long)
+@ stdcall -syscall -norelay __wine_dbg_write_record(ptr long)
 @ cdecl -norelay __wine_dbg_get_channel_flags(ptr)
 @ cdecl -norelay __wine_dbg_header(long long str)
 @ cdecl -norelay __wine_dbg_output(str)
 @ cdecl -norelay __wine_dbg_strdup(str)
+@ cdecl -norelay __wine_dbg_vlog(long ptr str str ptr)
 
 # Version
 @ cdecl wine_get_version()
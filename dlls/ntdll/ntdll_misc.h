@@ -44,6 +44,7 @@ extern UINT_PTR page_size DECLSPEC_HIDDEN;
 #endif
 
 extern BOOL delay_heap_free DECLSPEC_HIDDEN;
+extern BOOL heap_large_pages DECLSPEC_HIDDEN;
 
 /* exceptions */
 extern LONG call_vectored_handlers( EXCEPTION_RECORD *rec, CONTEXT *context ) DECLSPEC_HIDDEN;
@@ -59,6 +60,7 @@ extern void (WINAPI *pWow64PrepareForException)( EXCEPTION_RECORD *rec, CONTEXT
 #if defined(__x86_64__) || defined(__arm__) || defined(__aarch64__)
 extern RUNTIME_FUNCTION *lookup_function_info( ULONG_PTR pc, ULONG_PTR *base, LDR_DATA_TABLE_ENTRY **module ) DECLSPEC_HIDDEN;
 #endif
+extern void invalidate_unwind_cache(void) DECLSPEC_HIDDEN;
 
 /* debug helpers */
 extern LPCSTR debugstr_us( const UNICODE_STRING *str ) DECLSPEC_HIDDEN;
@@ -134,6 +136,8 @@ NTSTATUS HEAP_lfh_get_allocated_size( HANDLE std_heap, ULONG flags, const void *
 NTSTATUS HEAP_lfh_validate( HANDLE std_heap, ULONG flags, const void *ptr );
 
 void HEAP_notify_thread_destroy( BOOLEAN last );
+void HEAP_profile_init( const WCHAR *path, ULONG rate );
+void HEAP_profile_start(void);
 void HEAP_lfh_notify_thread_destroy( BOOLEAN last );
 void HEAP_lfh_set_debug_flags( ULONG flags );
 
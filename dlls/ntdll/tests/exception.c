@@ -2566,12 +2566,14 @@ static RUNTIME_FUNCTION* CALLBACK dynamic_unwind_callback( DWORD64 pc, PVOID con
 static void test_dynamic_unwind(void)
 {
     static const int code_offset = 1024;
+    static RUNTIME_FUNCTION many_funcs[64];
     char buf[2 * sizeof(RUNTIME_FUNCTION) + 4];
     RUNTIME_FUNCTION *runtime_func, *func;
     ULONG_PTR table, base;
     void *growable_table;
     NTSTATUS status;
     DWORD count;
+    int i;
 
     /* Test RtlAddFunctionTable with aligned RUNTIME_FUNCTION pointer */
     runtime_func = (RUNTIME_FUNCTION *)buf;
@@ -2675,6 +2677,35 @@ static void test_dynamic_unwind(void)
     ok( !pRtlDeleteFunctionTable( (PRUNTIME_FUNCTION)table ),
         "RtlDeleteFunctionTable returned success for nonexistent table = %p\n", (PVOID)table );
 
+    /* Many tables, registered out of address order */
+    for (i = 0; i < ARRAY_SIZE(many_funcs); i++)
+    {
+        int idx = (i * 7) % ARRAY_SIZE(many_funcs);
+        many_funcs[idx].BeginAddress = 0;
+        many_funcs[idx].EndAddress   = 16;
+        many_funcs[idx].UnwindData   = 0;
+        ok( pRtlAddFunctionTable( &many_funcs[idx], 1, (ULONG_PTR)code_mem + idx * 32 ),
+            "RtlAddFunctionTable failed for table %d\n", idx );
+    }
+    for (i = 0; i < ARRAY_SIZE(many_funcs); i++)
+    {
+        base = 0xdeadbeef;
+        func = pRtlLookupFunctionEntry( (ULONG_PTR)code_mem + i * 32 + 8, &base, NULL );
+        ok( func == &many_funcs[i], "%d: expected %p, got %p\n", i, &many_funcs[i], func );
+        ok( base == (ULONG_PTR)code_mem + i * 32, "%d: got base %lx\n", i, base );
+        func = pRtlLookupFunctionEntry( (ULONG_PTR)code_mem + i * 32 + 24, &base, NULL );
+        ok( func == NULL, "%d: expected NULL, got %p\n", i, func );
+    }
+    for (i = 0; i < ARRAY_SIZE(many_funcs); i += 2)
+        ok( pRtlDeleteFunctionTable( &many_funcs[i] ), "RtlDeleteFunctionTable failed for table %d\n", i );
+    for (i = 0; i < ARRAY_SIZE(many_funcs); i++)
+    {
+        func = pRtlLookupFunctionEntry( (ULONG_PTR)code_mem + i * 32 + 8, &base, NULL );
+        ok( func == (i % 2 ? &many_funcs[i] : NULL), "%d: got %p\n", i, func );
+    }
+    for (i = 1; i < ARRAY_SIZE(many_funcs); i += 2)
+        ok( pRtlDeleteFunctionTable( &many_funcs[i] ), "RtlDeleteFunctionTable failed for table %d\n", i );
+
     if (!pRtlAddGrowableFunctionTable)
     {
         win_skip("Growable function tables are not supported.\n");
@@ -1733,6 +1733,72 @@ static void test_syscalls(void)
     UnmapViewOfFile( ptr );
 }
 
+static void test_large_pages(void)
+{
+    const SIZE_T min_size = 0x200000; /* GetLargePageMinimum() */
+    BOOLEAN enabled;
+    NTSTATUS status;
+    SIZE_T size;
+    void *addr;
+
+    size = min_size;
+    addr = NULL;
+    status = NtAllocateVirtualMemory(NtCurrentProcess(), &addr, 0, &size,
+                                     MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    ok(status == STATUS_PRIVILEGE_NOT_HELD, "NtAllocateVirtualMemory returned %08x\n", status);
+
+    if (RtlAdjustPrivilege(SE_LOCK_MEMORY_PRIVILEGE, TRUE, FALSE, &enabled))
+    {
+        skip("Cannot enable SeLockMemoryPrivilege\n");
+        return;
+    }
+
+    size = min_size;
+    addr = NULL;
+    status = NtAllocateVirtualMemory(NtCurrentProcess(), &addr, 0, &size,
+                                     MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    if (status == STATUS_INSUFFICIENT_RESOURCES)
+    {
+        skip("Cannot allocate large pages\n");
+        RtlAdjustPrivilege(SE_LOCK_MEMORY_PRIVILEGE, enabled, FALSE, &enabled);
+        return;
+    }
+    ok(status == STATUS_SUCCESS, "NtAllocateVirtualMemory returned %08x\n", status);
+    ok(!((ULONG_PTR)addr & (min_size - 1)), "Unexpected address %p\n", addr);
+    ok(size == min_size, "Unexpected size %#Ix\n", size);
+    size = 0;
+    status = NtFreeVirtualMemory(NtCurrentProcess(), &addr, &size, MEM_RELEASE);
+    ok(status == STATUS_SUCCESS, "NtFreeVirtualMemory returned %08x\n", status);
+
+    size = min_size / 2;
+    addr = NULL;
+    status = NtAllocateVirtualMemory(NtCurrentProcess(), &addr, 0, &size,
+                                     MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    ok(status == STATUS_SUCCESS || broken(status == STATUS_INVALID_PARAMETER),
+       "NtAllocateVirtualMemory returned %08x\n", status);
+    if (!status)
+    {
+        ok(size == min_size, "Unexpected size %#Ix\n", size);
+        size = 0;
+        status = NtFreeVirtualMemory(NtCurrentProcess(), &addr, &size, MEM_RELEASE);
+        ok(status == STATUS_SUCCESS, "NtFreeVirtualMemory returned %08x\n", status);
+    }
+
+    size = min_size;
+    addr = NULL;
+    status = NtAllocateVirtualMemory(NtCurrentProcess(), &addr, 0, &size,
+                                     MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    ok(status == STATUS_INVALID_PARAMETER, "NtAllocateVirtualMemory returned %08x\n", status);
+
+    size = min_size;
+    addr = (void *)(min_size + 0x10000);
+    status = NtAllocateVirtualMemory(NtCurrentProcess(), &addr, 0, &size,
+                                     MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    ok(status == STATUS_INVALID_PARAMETER, "NtAllocateVirtualMemory returned %08x\n", status);
+
+    RtlAdjustPrivilege(SE_LOCK_MEMORY_PRIVILEGE, enabled, FALSE, &enabled);
+}
+
 static void test_NtFreeVirtualMemory(void)
 {
     void *addr1, *addr;
@@ -1815,6 +1881,84 @@ static void test_NtFreeVirtualMemory(void)
     ok(status == STATUS_SUCCESS, "Unexpected status %08lx.\n", status);
 }
 
+static DWORD WINAPI concurrent_alloc_thread(void *arg)
+{
+    HANDLE stop = arg;
+    NTSTATUS status;
+    SIZE_T size;
+    ULONG old_prot;
+    void *addr;
+
+    while (WaitForSingleObject(stop, 0) == WAIT_TIMEOUT)
+    {
+        addr = NULL;
+        size = 0x10000;
+        status = NtAllocateVirtualMemory(NtCurrentProcess(), &addr, 0, &size, MEM_RESERVE, PAGE_NOACCESS);
+        ok(status == STATUS_SUCCESS, "Unexpected status %08lx.\n", status);
+        size = 0x4000;
+        status = NtAllocateVirtualMemory(NtCurrentProcess(), &addr, 0, &size, MEM_COMMIT, PAGE_READWRITE);
+        ok(status == STATUS_SUCCESS, "Unexpected status %08lx.\n", status);
+        status = NtProtectVirtualMemory(NtCurrentProcess(), &addr, &size, PAGE_READONLY, &old_prot);
+        ok(status == STATUS_SUCCESS, "Unexpected status %08lx.\n", status);
+        size = 0;
+        status = NtFreeVirtualMemory(NtCurrentProcess(), &addr, &size, MEM_RELEASE);
+        ok(status == STATUS_SUCCESS, "Unexpected status %08lx.\n", status);
+    }
+    return 0;
+}
+
+static void test_concurrent_query(void)
+{
+    MEMORY_BASIC_INFORMATION info;
+    HANDLE threads[2], stop;
+    NTSTATUS status;
+    LONG failures;
+    SIZE_T size;
+    void *addr;
+    unsigned int i;
+
+    addr = NULL;
+    size = 0x10000;
+    status = NtAllocateVirtualMemory(NtCurrentProcess(), &addr, 0, &size, MEM_RESERVE, PAGE_NOACCESS);
+    ok(status == STATUS_SUCCESS, "Unexpected status %08lx.\n", status);
+    size = 0x4000;
+    status = NtAllocateVirtualMemory(NtCurrentProcess(), &addr, 0, &size, MEM_COMMIT, PAGE_READWRITE);
+    ok(status == STATUS_SUCCESS, "Unexpected status %08lx.\n", status);
+
+    stop = CreateEventA(NULL, TRUE, FALSE, NULL);
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+        threads[i] = CreateThread(NULL, 0, concurrent_alloc_thread, stop, 0, NULL);
+
+    /* queries must give consistent results while other views are being updated */
+    failures = winetest_get_failures();
+    for (i = 0; i < 20000; i++)
+    {
+        status = NtQueryVirtualMemory(NtCurrentProcess(), (char *)addr + 0x1000, MemoryBasicInformation,
+                                      &info, sizeof(info), NULL);
+        ok(status == STATUS_SUCCESS, "Unexpected status %08lx.\n", status);
+        ok(info.AllocationBase == addr, "Unexpected AllocationBase %p.\n", info.AllocationBase);
+        ok(info.RegionSize == 0x3000, "Unexpected RegionSize %#Ix.\n", info.RegionSize);
+        ok(info.State == MEM_COMMIT, "Unexpected State %#lx.\n", info.State);
+        ok(info.Protect == PAGE_READWRITE, "Unexpected Protect %#lx.\n", info.Protect);
+
+        status = NtQueryVirtualMemory(NtCurrentProcess(), (char *)addr + 0x8000, MemoryBasicInformation,
+                                      &info, sizeof(info), NULL);
+        ok(status == STATUS_SUCCESS, "Unexpected status %08lx.\n", status);
+        ok(info.RegionSize == 0x8000, "Unexpected RegionSize %#Ix.\n", info.RegionSize);
+        ok(info.State == MEM_RESERVE, "Unexpected State %#lx.\n", info.State);
+        if (winetest_get_failures() != failures) break;
+    }
+
+    SetEvent(stop);
+    WaitForMultipleObjects(ARRAY_SIZE(threads), threads, TRUE, INFINITE);
+    for (i = 0; i < ARRAY_SIZE(threads); i++) CloseHandle(threads[i]);
+    CloseHandle(stop);
+
+    size = 0;
+    status = NtFreeVirtualMemory(NtCurrentProcess(), &addr, &size, MEM_RELEASE);
+    ok(status == STATUS_SUCCESS, "Unexpected status %08lx.\n", status);
+}
+
 START_TEST(virtual)
 {
     HMODULE mod;
@@ -1853,7 +1997,9 @@ START_TEST(virtual)
     test_NtAllocateVirtualMemory();
     test_NtAllocateVirtualMemoryEx();
     test_NtAllocateVirtualMemoryEx_address_requirements();
+    test_large_pages();
     test_NtFreeVirtualMemory();
+    test_concurrent_query();
     test_RtlCreateUserStack();
     test_NtMapViewOfSection();
     test_NtMapViewOfSectionEx();
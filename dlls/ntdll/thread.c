@@ -29,6 +29,7 @@
 #include "winternl.h"
 #include "wine/debug.h"
 #include "ntdll_misc.h"
+#include "dbgtrace.h"
 #include "ddk/wdm.h"
 #include "wine/exception.h"
 
@@ -185,6 +186,32 @@ int __cdecl __wine_dbg_output( const char *str )
     return ret;
 }
 
+/***********************************************************************
+ *		__wine_dbg_vlog  (NTDLL.@)
+ */
+int __wine_dbg_cdecl __wine_dbg_vlog( enum __wine_debug_class cls, struct __wine_debug_channel *channel,
+                                      const char *function, const char *format, __wine_dbg_va_list args )
+{
+    static int use_records = -1;
+    struct debug_info *info;
+    char buffer[1024];
+    int ret;
+
+    if (use_records == -1) use_records = (__wine_dbg_write_record( NULL, 0 ) != -1);
+    if (!use_records) return -2;  /* formatted by the caller */
+
+    if (!(__wine_dbg_get_channel_flags( channel ) & (1 << cls))) return -1;
+    info = get_info();
+    if (info->out_pos)  /* keep the pending partial line ahead of this record */
+    {
+        __wine_dbg_write( info->output, info->out_pos );
+        info->out_pos = 0;
+    }
+    ret = trace_encode_log( buffer, sizeof(buffer), cls, channel->name, function, format, args );
+    __wine_dbg_write_record( buffer, ret );
+    return ret;
+}
+
 
 /***********************************************************************
  *           RtlExitUserThread  (NTDLL.@)
@@ -32,6 +32,8 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "ntstatus.h"
@@ -41,6 +43,7 @@
 #include "winternl.h"
 #include "unix_private.h"
 #include "wine/debug.h"
+#include "dbgtrace.h"
 
 WINE_DECLARE_DEBUG_CHANNEL(pid);
 WINE_DECLARE_DEBUG_CHANNEL(timestamp);
@@ -191,6 +194,152 @@ static void debug_usage(void)
     exit(1);
 }
 
+/* Binary trace rings. When WINE_TRACE_BUFFER is set to a file name prefix, debug output is
+ * stored as records in a ring buffer mapped from "<prefix>.<unix pid>.<n>", one per thread,
+ * instead of being written to stderr. Debug messages are stored unformatted, see dbgtrace.h.
+ * Only the owning thread writes to a ring, so no lock or system call is needed; the files
+ * can be decoded with tools/decode-trace once the process is done. */
+
+#define TRACE_RING_MAGIC "WINETRC2"
+#define TRACE_RING_DATA_OFFSET 0x1000
+#define TRACE_RING_NONE ((struct trace_ring *)~(ULONG_PTR)0)
+
+enum trace_record_type
+{
+    TRACE_RECORD_TEXT,    /* followed by the text */
+    TRACE_RECORD_LOG      /* followed by a log record, see dbgtrace.h */
+};
+
+struct trace_ring
+{
+    char    magic[8];     /* TRACE_RING_MAGIC */
+    ULONG64 size;         /* size of the ring data, power of 2 */
+    ULONG64 head;         /* stream position of the next record */
+    ULONG64 data_offset;  /* file offset of the ring data */
+    UINT    pid;          /* process id of the owning thread */
+    UINT    tid;          /* thread id of the owning thread */
+};
+
+struct trace_record
+{
+    ULONG64 pos;          /* stream position of the record, used to resynchronize after wrapping */
+    ULONG64 time;         /* monotonic time in nanoseconds */
+    UINT    size;         /* size of the record, including this header, aligned to 8 bytes */
+    USHORT  type;         /* enum trace_record_type */
+    USHORT  len;          /* length of the data */
+    /* followed by the data */
+};
+
+static char *trace_prefix;
+static ULONG64 trace_ring_size;  /* size of the thread rings, 0 if disabled */
+static LONG trace_ring_count;
+static struct trace_ring *initial_ring;
+
+static struct trace_ring **get_trace_ring(void)
+{
+    if (!init_done) return &initial_ring;
+    return (struct trace_ring **)&ntdll_get_thread_data()->trace_ring;
+}
+
+static struct trace_ring *create_trace_ring(void)
+{
+    struct trace_ring *ring;
+    char name[MAX_PATH];
+    ULONG64 total = trace_ring_size + TRACE_RING_DATA_OFFSET;
+    int fd;
+
+    if (snprintf( name, sizeof(name), "%s.%u.%u", trace_prefix, (unsigned int)getpid(),
+                  (unsigned int)InterlockedIncrement( &trace_ring_count )) >= sizeof(name))
+        return TRACE_RING_NONE;
+    if ((fd = open( name, O_RDWR | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0600 )) == -1)
+    {
+        fprintf( stderr, "wine: failed to create trace buffer %s\n", name );
+        return TRACE_RING_NONE;
+    }
+    if (ftruncate( fd, total ) == -1 ||
+        (ring = mmap( NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 )) == MAP_FAILED)
+    {
+        fprintf( stderr, "wine: failed to map trace buffer %s\n", name );
+        close( fd );
+        return TRACE_RING_NONE;
+    }
+    close( fd );
+
+    ring->size = trace_ring_size;
+    ring->head = 0;
+    ring->data_offset = TRACE_RING_DATA_OFFSET;
+    ring->pid = 0;
+    ring->tid = 0;
+    memcpy( ring->magic, TRACE_RING_MAGIC, sizeof(ring->magic) );
+    return ring;
+}
+
+static void trace_ring_copy( struct trace_ring *ring, ULONG64 pos, const void *data, size_t len )
+{
+    char *ring_data = (char *)ring + ring->data_offset;
+    size_t offset = pos & (ring->size - 1), count = min( len, ring->size - offset );
+
+    memcpy( ring_data + offset, data, count );
+    if (count < len) memcpy( ring_data, (const char *)data + count, len - count );
+}
+
+static void trace_ring_write( enum trace_record_type type, const void *data, unsigned int len )
+{
+    struct trace_ring **ring_ptr = get_trace_ring(), *ring;
+    struct trace_record record;
+    struct timespec ts;
+    UINT size;
+
+    if (!*ring_ptr) *ring_ptr = create_trace_ring();
+    if ((ring = *ring_ptr) == TRACE_RING_NONE) return;
+    if (!ring->tid && init_done)  /* the ids are not known yet when the initial thread starts */
+    {
+        ring->pid = GetCurrentProcessId();
+        ring->tid = GetCurrentThreadId();
+    }
+
+    len = min( len, 0xffff );
+    size = (sizeof(record) + len + 7) & ~7;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    /* the thread may be interrupted by a signal handler that traces too */
+    record.pos  = __atomic_fetch_add( &ring->head, size, __ATOMIC_RELAXED );
+    record.time = (ULONG64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    record.size = size;
+    record.type = type;
+    record.len  = len;
+    trace_ring_copy( ring, record.pos + sizeof(record), data, len );
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+    trace_ring_copy( ring, record.pos, &record, sizeof(record) );
+}
+
+static void init_trace_rings(void)
+{
+    const char *prefix = getenv( "WINE_TRACE_BUFFER" ), *env;
+    ULONG64 size = 4;
+
+    if (!prefix || !prefix[0]) return;
+    if ((env = getenv( "WINE_TRACE_BUFFER_SIZE" ))) size = max( 1, min( atoi( env ), 4096 ));
+    size <<= 20;
+    while (size & (size - 1)) size &= size - 1;  /* round down to a power of 2 */
+    trace_prefix = strdup( prefix );
+    trace_ring_size = size;
+}
+
+/***********************************************************************
+ *		dbg_exit_thread
+ *
+ * Release the trace ring of the current thread.
+ */
+void dbg_exit_thread(void)
+{
+    struct trace_ring **ring_ptr = get_trace_ring(), *ring = *ring_ptr;
+
+    if (!ring || ring == TRACE_RING_NONE) return;
+    *ring_ptr = TRACE_RING_NONE;
+    munmap( ring, ring->data_offset + ring->size );
+}
+
 /* initialize all options at startup */
 static void init_options(void)
 {
@@ -198,9 +347,10 @@ static void init_options(void)
     struct stat st1, st2;
 
     nb_debug_options = 0;
+    init_trace_rings();
 
     /* check for stderr pointing to /dev/null */
-    if (!fstat( 2, &st1 ) && S_ISCHR(st1.st_mode) &&
+    if (!trace_ring_size && !fstat( 2, &st1 ) && S_ISCHR(st1.st_mode) &&
         !stat( "/dev/null", &st2 ) && S_ISCHR(st2.st_mode) &&
         st1.st_rdev == st2.st_rdev)
     {
@@ -258,7 +408,21 @@ const char * __cdecl __wine_dbg_strdup( const char *str )
  */
 int WINAPI __wine_dbg_write( const char *str, unsigned int len )
 {
-    return write( 2, str, len );
+    if (!trace_ring_size) return write( 2, str, len );
+    trace_ring_write( TRACE_RECORD_TEXT, str, len );
+    return len;
+}
+
+/***********************************************************************
+ *		__wine_dbg_write_record  (NTDLL.@)
+ *
+ * Store a log record built with trace_encode_log(). Returns -1 if binary tracing is disabled.
+ */
+int WINAPI __wine_dbg_write_record( const void *data, unsigned int len )
+{
+    if (!trace_ring_size) return -1;
+    if (len) trace_ring_write( TRACE_RECORD_LOG, data, len );
+    return len;
 }
 
 /***********************************************************************
@@ -320,6 +484,30 @@ int __cdecl __wine_dbg_header( enum __wine_debug_class cls, struct __wine_debug_
     return info->out_pos;
 }
 
+/***********************************************************************
+ *		__wine_dbg_vlog  (NTDLL.@)
+ */
+int __wine_dbg_cdecl __wine_dbg_vlog( enum __wine_debug_class cls, struct __wine_debug_channel *channel,
+                                      const char *function, const char *format, __wine_dbg_va_list args )
+{
+    struct debug_info *info;
+    char buffer[1024];
+    int ret;
+
+    if (!trace_ring_size) return -2;  /* formatted by the caller */
+
+    if (!(__wine_dbg_get_channel_flags( channel ) & (1 << cls))) return -1;
+    info = get_info();
+    if (info->out_pos)  /* keep the pending partial line ahead of this record */
+    {
+        trace_ring_write( TRACE_RECORD_TEXT, info->output, info->out_pos );
+        info->out_pos = 0;
+    }
+    ret = trace_encode_log( buffer, sizeof(buffer), cls, channel->name, function, format, args );
+    trace_ring_write( TRACE_RECORD_LOG, buffer, ret );
+    return ret;
+}
+
 /***********************************************************************
  *		dbg_init
  */
@@ -337,6 +525,7 @@ void dbg_init(void)
     free( debug_options );
     debug_options = options;
     options[nb_debug_options] = default_option;
+    ntdll_get_thread_data()->trace_ring = initial_ring;
     init_done = TRUE;
 }
 
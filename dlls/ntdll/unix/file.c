@@ -98,6 +98,9 @@
 #ifdef HAVE_SYS_STATFS_H
 #include <sys/statfs.h>
 #endif
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
 #include <time.h>
 #include <unistd.h>
 
@@ -174,6 +177,7 @@ struct file_identity
 };
 
 static struct file_identity ignored_files[MAX_IGNORED_FILES];
+static BOOL ignored_files_are_dirs = TRUE;
 static unsigned int ignored_files_count;
 
 union file_directory_info
@@ -196,11 +200,23 @@ struct dir_data_buffer
     char                    data[1];
 };
 
+#ifndef DT_UNKNOWN
+#define DT_UNKNOWN 0
+#endif
+
 struct dir_data_names
 {
-    const WCHAR *long_name;          /* long file name in Unicode */
-    const WCHAR *short_name;         /* short file name in Unicode */
-    const char  *unix_name;          /* Unix file name in host encoding */
+    const WCHAR  *long_name;         /* long file name in Unicode */
+    const WCHAR  *short_name;        /* short file name in Unicode */
+    const char   *unix_name;         /* Unix file name in host encoding */
+    unsigned char type;              /* file type from the directory entry, DT_UNKNOWN if not known */
+};
+
+struct dir_data_info
+{
+    struct stat             st;      /* file stat info */
+    ULONG                   attr;    /* file attributes */
+    int                     ret;     /* get_file_info() return value */
 };
 
 struct dir_data
@@ -211,6 +227,9 @@ struct dir_data
     struct file_identity    id;      /* directory file identity */
     struct dir_data_names  *names;   /* directory file names */
     struct dir_data_buffer *buffer;  /* head of data buffers list */
+    struct dir_data_info   *info;    /* prefetched file info */
+    unsigned int            info_pos;   /* index of the first entry in the info array */
+    unsigned int            info_count; /* count of valid entries in the info array */
 };
 
 static const unsigned int dir_data_buffer_initial_size = 4096;
@@ -257,6 +276,7 @@ static inline void ignore_file( const char *name )
         ignored_files[ignored_files_count].dev = st.st_dev;
         ignored_files[ignored_files_count].ino = st.st_ino;
         ignored_files_count++;
+        if (!S_ISDIR( st.st_mode )) ignored_files_are_dirs = FALSE;
     }
 }
 
@@ -395,7 +415,7 @@ static const WCHAR *add_dir_data_nameW( struct dir_data *data, const WCHAR *name
 
 /* add an entry to the directory names array */
 static BOOL add_dir_data_names( struct dir_data *data, const WCHAR *long_name,
-                                const WCHAR *short_name, const char *unix_name )
+                                const WCHAR *short_name, const char *unix_name, unsigned char type )
 {
     static const WCHAR empty[1];
     struct dir_data_names *names = data->names;
@@ -417,6 +437,7 @@ static BOOL add_dir_data_names( struct dir_data *data, const WCHAR *long_name,
 
     if (!(names[data->count].long_name = add_dir_data_nameW( data, long_name ))) return FALSE;
     if (!(names[data->count].unix_name = add_dir_data_nameA( data, unix_name ))) return FALSE;
+    names[data->count].type = type;
     data->count++;
     return TRUE;
 }
@@ -434,6 +455,7 @@ static void free_dir_data( struct dir_data *data )
         free( buffer );
     }
     free( data->names );
+    free( data->info );
     free( data );
 }
 
@@ -1399,7 +1421,7 @@ static BOOLEAN is_legal_8dot3_name( const WCHAR *name, int len )
  * Add a file to the directory data if it matches the mask.
  */
 static BOOL append_entry( struct dir_data *data, const char *long_name,
-                          const char *short_name, const UNICODE_STRING *mask )
+                          const char *short_name, const UNICODE_STRING *mask, unsigned char type )
 {
     int long_len, short_len;
     WCHAR long_nameW[MAX_DIR_ENTRY_LEN + 1];
@@ -1432,7 +1454,7 @@ static BOOL append_entry( struct dir_data *data, const char *long_name,
         if (!match_filename( short_nameW, short_len, mask )) return TRUE;
     }
 
-    return add_dir_data_names( data, long_nameW, short_nameW, long_name );
+    return add_dir_data_names( data, long_nameW, short_nameW, long_name, type );
 }
 
 
@@ -1989,6 +2011,26 @@ static NTSTATUS get_mountmgr_fs_info( HANDLE handle, int fd, struct mountmgr_uni
 }
 
 
+/* check whether the file attributes are needed to return a directory entry */
+static BOOL dir_entry_needs_info( const struct dir_data_names *names, FILE_INFORMATION_CLASS class )
+{
+    if (class != FileNamesInformation) return TRUE;
+    /* file names don't need the attributes, unless the file might be ignored; when all
+     * ignored files are directories, we can skip entries known to be something else */
+    if (!ignored_files_count) return FALSE;
+    if (!ignored_files_are_dirs) return TRUE;
+    switch (names->type)
+    {
+    case DT_UNKNOWN:
+#ifdef DT_DIR
+    case DT_DIR:
+    case DT_LNK:
+#endif
+        return TRUE;
+    }
+    return FALSE;
+}
+
 /***********************************************************************
  *           get_dir_data_entry
  *
@@ -2002,16 +2044,29 @@ static NTSTATUS get_dir_data_entry( struct dir_data *dir_data, void *info_ptr, I
     union file_directory_info *info;
     struct stat st;
     ULONG name_len, start, dir_size, attributes;
+    int ret;
 
-    if (get_file_info( names->unix_name, &st, &attributes ) == -1)
-    {
-        TRACE( "file no longer exists %s\n", names->unix_name );
-        return STATUS_SUCCESS;
-    }
-    if (is_ignored_file( &st ))
+    if (dir_entry_needs_info( names, class ))
     {
-        TRACE( "ignoring file %s\n", names->unix_name );
-        return STATUS_SUCCESS;
+        if (dir_data->pos - dir_data->info_pos < dir_data->info_count)
+        {
+            const struct dir_data_info *prefetched = &dir_data->info[dir_data->pos - dir_data->info_pos];
+            st = prefetched->st;
+            attributes = prefetched->attr;
+            ret = prefetched->ret;
+        }
+        else ret = get_file_info( names->unix_name, &st, &attributes );
+
+        if (ret == -1)
+        {
+            TRACE( "file no longer exists %s\n", names->unix_name );
+            return STATUS_SUCCESS;
+        }
+        if (is_ignored_file( &st ))
+        {
+            TRACE( "ignoring file %s\n", names->unix_name );
+            return STATUS_SUCCESS;
+        }
     }
     start = dir_info_align( io->Information );
     dir_size = dir_info_size( class, 0 );
@@ -2115,8 +2170,8 @@ static NTSTATUS read_directory_data_vfat( struct dir_data *data, int fd, const U
         de[0].d_reclen = 0;
     }
 
-    if (!append_entry( data, ".", NULL, mask )) goto done;
-    if (!append_entry( data, "..", NULL, mask )) goto done;
+    if (!append_entry( data, ".", NULL, mask, DT_UNKNOWN )) goto done;
+    if (!append_entry( data, "..", NULL, mask, DT_UNKNOWN )) goto done;
 
     while (de[0].d_reclen)
     {
@@ -2132,7 +2187,7 @@ static NTSTATUS read_directory_data_vfat( struct dir_data *data, int fd, const U
                 long_name = de[0].d_name;
                 short_name = NULL;
             }
-            if (!append_entry( data, long_name, short_name, mask )) goto done;
+            if (!append_entry( data, long_name, short_name, mask, DT_UNKNOWN )) goto done;
         }
         if (ioctl( fd, VFAT_IOCTL_READDIR_BOTH, (long)de ) == -1) break;
     }
@@ -2181,7 +2236,7 @@ static NTSTATUS read_directory_data_getattrlist( struct dir_data *data, const ch
 
     TRACE( "found %s\n", buffer.name );
 
-    if (!append_entry( data, buffer.name, NULL, NULL )) return STATUS_NO_MEMORY;
+    if (!append_entry( data, buffer.name, NULL, NULL, DT_UNKNOWN )) return STATUS_NO_MEMORY;
 
     return STATUS_SUCCESS;
 }
@@ -2204,7 +2259,7 @@ static NTSTATUS read_directory_data_stat( struct dir_data *data, const char *uni
 
     TRACE( "found %s\n", unix_name );
 
-    if (!append_entry( data, unix_name, NULL, NULL )) return STATUS_NO_MEMORY;
+    if (!append_entry( data, unix_name, NULL, NULL, DT_UNKNOWN )) return STATUS_NO_MEMORY;
 
     return STATUS_SUCCESS;
 }
@@ -2223,12 +2278,16 @@ static NTSTATUS read_directory_data_readdir( struct dir_data *data, const UNICOD
 
     if (!dir) return STATUS_NO_SUCH_FILE;
 
-    if (!append_entry( data, ".", NULL, mask )) goto done;
-    if (!append_entry( data, "..", NULL, mask )) goto done;
+    if (!append_entry( data, ".", NULL, mask, DT_UNKNOWN )) goto done;
+    if (!append_entry( data, "..", NULL, mask, DT_UNKNOWN )) goto done;
     while ((de = readdir( dir )))
     {
         if (!strcmp( de->d_name, "." ) || !strcmp( de->d_name, ".." )) continue;
-        if (!append_entry( data, de->d_name, NULL, mask )) goto done;
+#ifdef DT_DIR
+        if (!append_entry( data, de->d_name, NULL, mask, de->d_type )) goto done;
+#else
+        if (!append_entry( data, de->d_name, NULL, mask, DT_UNKNOWN )) goto done;
+#endif
     }
     status = STATUS_SUCCESS;
 
@@ -2238,6 +2297,66 @@ done:
 }
 
 
+#if defined(linux) && defined(__NR_getdents64)
+struct linux_dirent64
+{
+    ULONG64        d_ino;
+    LONG64         d_off;
+    unsigned short d_reclen;
+    unsigned char  d_type;
+    char           d_name[1];
+};
+
+/***********************************************************************
+ *           read_directory_data_getdents
+ *
+ * Same as read_directory_data_readdir, but reads large batches of entries at once.
+ */
+static NTSTATUS read_directory_data_getdents( struct dir_data *data, int fd, const UNICODE_STRING *mask )
+{
+    static const unsigned int buffer_size = 0x10000;
+    const struct linux_dirent64 *de;
+    NTSTATUS status = STATUS_NO_MEMORY;
+    off_t old_pos = lseek( fd, 0, SEEK_CUR );
+    char *buffer;
+    int pos, size;
+
+    lseek( fd, 0, SEEK_SET );
+    if (!(buffer = malloc( buffer_size ))) goto done;
+
+    if ((size = syscall( __NR_getdents64, fd, buffer, buffer_size )) == -1)
+    {
+        status = STATUS_NOT_SUPPORTED;
+        goto done;
+    }
+
+    if (!append_entry( data, ".", NULL, mask, DT_UNKNOWN )) goto done;
+    if (!append_entry( data, "..", NULL, mask, DT_UNKNOWN )) goto done;
+    while (size > 0)
+    {
+        for (pos = 0; pos < size; pos += de->d_reclen)
+        {
+            de = (const struct linux_dirent64 *)(buffer + pos);
+            if (!strcmp( de->d_name, "." ) || !strcmp( de->d_name, ".." )) continue;
+            if (!append_entry( data, de->d_name, NULL, mask, de->d_type )) goto done;
+        }
+        /* don't return a truncated listing if reading fails halfway through */
+        if ((size = syscall( __NR_getdents64, fd, buffer, buffer_size )) == -1)
+        {
+            status = errno_to_status( errno );
+            goto done;
+        }
+    }
+    status = STATUS_SUCCESS;
+
+done:
+    free( buffer );
+    lseek( fd, old_pos, SEEK_SET );
+    return status;
+}
+#endif
+
+
 /***********************************************************************
  *           read_directory_data
  *
@@ -2267,6 +2386,9 @@ static NTSTATUS read_directory_data( struct dir_data *data, int fd, const UNICOD
         }
     }
 
+#if defined(linux) && defined(__NR_getdents64)
+    if ((status = read_directory_data_getdents( data, fd, mask )) != STATUS_NOT_SUPPORTED) return status;
+#endif
     return read_directory_data_readdir( data, mask );
 }
 
@@ -2378,6 +2500,131 @@ static NTSTATUS get_cached_dir_data( HANDLE handle, struct dir_data **data_ret,
 }
 
 
+/* Attributes of entries returned by NtQueryDirectoryFile are fetched in parallel for large
+ * batches, since a stat() per file dominates the cost of listing big directories. */
+
+#define DIR_PREFETCH_MIN_ENTRIES   256   /* minimum batch size for parallel prefetch */
+#define DIR_PREFETCH_MAX_ENTRIES   4096  /* maximum batch size */
+#define DIR_PREFETCH_THREAD_CHUNK  128   /* minimum entries per worker thread */
+#define DIR_PREFETCH_MAX_THREADS   8
+
+struct dir_prefetch
+{
+    struct dir_data *data;
+    unsigned int     next;    /* next entry to fetch, relative to data->info_pos */
+    unsigned int     active;  /* number of worker threads working on this batch */
+};
+
+/* the worker threads are started on first use and kept for the life of the process */
+static pthread_mutex_t dir_prefetch_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t dir_prefetch_start_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t dir_prefetch_done_cond = PTHREAD_COND_INITIALIZER;
+static struct dir_prefetch *dir_prefetch_batch;  /* batch being fetched, NULL if none */
+static unsigned int dir_prefetch_serial;         /* incremented for every batch */
+static unsigned int dir_prefetch_threads;
+
+static void dir_prefetch_entries( struct dir_prefetch *prefetch )
+{
+    struct dir_data *data = prefetch->data;
+    struct dir_data_info *info;
+    unsigned int i;
+
+    while ((i = __atomic_fetch_add( &prefetch->next, 1, __ATOMIC_RELAXED )) < data->info_count)
+    {
+        info = &data->info[i];
+        info->ret = get_file_info( data->names[data->info_pos + i].unix_name, &info->st, &info->attr );
+    }
+}
+
+static void *dir_prefetch_thread( void *arg )
+{
+    struct dir_prefetch *prefetch;
+    unsigned int serial = 0;
+
+    pthread_mutex_lock( &dir_prefetch_mutex );
+    for (;;)
+    {
+        while (!dir_prefetch_batch || dir_prefetch_serial == serial)
+            pthread_cond_wait( &dir_prefetch_start_cond, &dir_prefetch_mutex );
+        prefetch = dir_prefetch_batch;
+        serial = dir_prefetch_serial;
+        prefetch->active++;
+        pthread_mutex_unlock( &dir_prefetch_mutex );
+
+        dir_prefetch_entries( prefetch );
+
+        pthread_mutex_lock( &dir_prefetch_mutex );
+        if (!--prefetch->active) pthread_cond_signal( &dir_prefetch_done_cond );
+    }
+    return NULL;
+}
+
+
+/***********************************************************************
+ *           prefetch_dir_data_info
+ *
+ * Fetch file attributes for the entries that will likely be returned by the current
+ * NtQueryDirectoryFile call. Must be called with dir_mutex held and the current directory
+ * set to the directory being listed.
+ */
+static void prefetch_dir_data_info( struct dir_data *data, FILE_INFORMATION_CLASS class, ULONG length )
+{
+    struct dir_prefetch prefetch;
+    unsigned int count, nb_threads;
+    long nb_cpus;
+    sigset_t sigset, old_sigset;
+    pthread_t thread;
+
+    data->info_count = 0;
+    if (class == FileNamesInformation) return;  /* attributes are not needed */
+
+    count = min( data->count - data->pos, length / dir_info_size( class, 8 ) + 1 );
+    count = min( count, DIR_PREFETCH_MAX_ENTRIES );
+    if (count < DIR_PREFETCH_MIN_ENTRIES) return;
+
+    if ((nb_cpus = sysconf( _SC_NPROCESSORS_ONLN )) < 2) return;
+    nb_threads = min( count / DIR_PREFETCH_THREAD_CHUNK, nb_cpus ) - 1;
+    nb_threads = min( nb_threads, DIR_PREFETCH_MAX_THREADS );
+    if (!nb_threads) return;
+
+    if (!data->info && !(data->info = malloc( DIR_PREFETCH_MAX_ENTRIES * sizeof(*data->info) ))) return;
+
+    data->info_pos = data->pos;
+    data->info_count = count;
+    prefetch.data = data;
+    prefetch.next = 0;
+    prefetch.active = 0;
+
+    pthread_mutex_lock( &dir_prefetch_mutex );
+    if (dir_prefetch_threads < nb_threads)
+    {
+        /* worker threads are not Wine threads, make sure they never receive signals */
+        sigfillset( &sigset );
+        pthread_sigmask( SIG_SETMASK, &sigset, &old_sigset );
+        while (dir_prefetch_threads < nb_threads)
+        {
+            if (pthread_create( &thread, NULL, dir_prefetch_thread, NULL )) break;
+            pthread_detach( thread );
+            dir_prefetch_threads++;
+        }
+        pthread_sigmask( SIG_SETMASK, &old_sigset, NULL );
+    }
+    dir_prefetch_batch = &prefetch;
+    dir_prefetch_serial++;
+    pthread_cond_broadcast( &dir_prefetch_start_cond );
+    pthread_mutex_unlock( &dir_prefetch_mutex );
+
+    dir_prefetch_entries( &prefetch );
+
+    pthread_mutex_lock( &dir_prefetch_mutex );
+    dir_prefetch_batch = NULL;
+    while (prefetch.active) pthread_cond_wait( &dir_prefetch_done_cond, &dir_prefetch_mutex );
+    pthread_mutex_unlock( &dir_prefetch_mutex );
+
+    TRACE( "prefetched %u entries using up to %u threads\n", count, min( nb_threads, dir_prefetch_threads ) + 1 );
+}
+
+
 /******************************************************************************
  *              NtQueryDirectoryFile   (NTDLL.@)
  */
@@ -2447,6 +2694,7 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event, PIO_APC_ROUTI
             union file_directory_info *last_info = NULL;
 
             if (restart_scan) data->pos = 0;
+            prefetch_dir_data_info( data, info_class, single_entry ? 0 : length );
 
             while (!status && data->pos < data->count)
             {
@@ -2457,6 +2705,7 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event, PIO_APC_ROUTI
 
             if (!last_info) status = STATUS_NO_MORE_FILES;
             else if (status == STATUS_MORE_ENTRIES) status = STATUS_SUCCESS;
+            data->info_count = 0;
 
             io->u.Status = status;
         }
@@ -2473,6 +2722,305 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event, PIO_APC_ROUTI
 }
 
 
+/* Cache of directory listings used by find_file_in_dir() for case-insensitive lookups.
+ * Entries are keyed by device and inode, and validated against the directory modification
+ * time. When inotify is available the directories are also watched, which allows to trust
+ * listings of directories modified within the timestamp granularity. Enabled with
+ * WINE_DIR_CACHE=1. */
+
+struct dir_cache_entry
+{
+    unsigned int   next;          /* index + 1 of the next entry in the long name hash chain */
+    unsigned int   short_next;    /* index + 1 of the next entry in the short name hash chain */
+    unsigned int   name;          /* offset of the long name in the names buffer */
+    unsigned int   unix_name;     /* offset of the Unix name in the unix_names buffer */
+    unsigned short len;           /* length of the long name */
+    unsigned short short_len;     /* length of the short name, 0 if the long name is a legal 8.3 name */
+    WCHAR          short_name[12];
+};
+
+struct dir_cache
+{
+    struct list             entry;         /* entry in the LRU list */
+    dev_t                   dev;           /* directory device */
+    ino_t                   ino;           /* directory inode */
+    time_t                  mtime;         /* directory modification time when it was read */
+    long                    mtime_nsec;
+    int                     wd;            /* inotify watch descriptor, -1 if not watched */
+    unsigned int            count;         /* number of entries */
+    unsigned int            hash_mask;     /* hash table size - 1 */
+    unsigned int           *buckets;       /* long name hash table, entry index + 1 */
+    unsigned int           *short_buckets; /* short name hash table, entry index + 1 */
+    struct dir_cache_entry *entries;
+    WCHAR                  *names;
+    char                   *unix_names;
+};
+
+/* each cached directory uses an inotify watch, which is a per-user resource */
+#define DIR_CACHE_MAX_DIRS    32
+#define DIR_CACHE_MAX_ENTRIES 0x10000
+
+static struct list dir_cache_list = LIST_INIT( dir_cache_list );
+static unsigned int dir_cache_dirs;
+static unsigned int dir_cache_entries;
+static unsigned int dir_cache_serial;  /* incremented for every inotify event */
+static int dir_cache_inotify_fd = -1;
+static BOOL dir_cache_enabled;
+static pthread_mutex_t dir_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline void get_stat_mtime( const struct stat *st, time_t *mtime, long *nsec )
+{
+    *mtime = st->st_mtime;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    *nsec = st->st_mtim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    *nsec = st->st_mtimespec.tv_nsec;
+#else
+    *nsec = 0;
+#endif
+}
+
+static unsigned int dir_cache_hash( const WCHAR *name, unsigned int len )
+{
+    unsigned int hash = 0;
+    while (len--) hash = hash * 31 + towupper( *name++ );
+    return hash;
+}
+
+static void free_dir_cache( struct dir_cache *cache )
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    if (cache->wd != -1) inotify_rm_watch( dir_cache_inotify_fd, cache->wd );
+#endif
+    free( cache->buckets );
+    free( cache->entries );
+    free( cache->names );
+    free( cache->unix_names );
+    free( cache );
+}
+
+static void remove_dir_cache( struct dir_cache *cache )
+{
+    list_remove( &cache->entry );
+    dir_cache_dirs--;
+    dir_cache_entries -= cache->count;
+    free_dir_cache( cache );
+}
+
+/* invalidate the listings of directories that changed since the last call */
+static void process_dir_cache_events(void)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *event;
+    struct dir_cache *cache, *next;
+    ssize_t size;
+    char *ptr;
+
+    if (dir_cache_inotify_fd == -1) return;
+
+    while ((size = read( dir_cache_inotify_fd, buffer, sizeof(buffer) )) > 0)
+    {
+        for (ptr = buffer; ptr < buffer + size; ptr += sizeof(*event) + event->len)
+        {
+            event = (const struct inotify_event *)ptr;
+            dir_cache_serial++;
+            LIST_FOR_EACH_ENTRY_SAFE( cache, next, &dir_cache_list, struct dir_cache, entry )
+            {
+                if (!(event->mask & IN_Q_OVERFLOW) && cache->wd != event->wd) continue;
+                if (event->mask & IN_IGNORED) cache->wd = -1;  /* watch is already gone */
+                remove_dir_cache( cache );
+            }
+        }
+    }
+#endif
+}
+
+static BOOL add_dir_cache_entry( struct dir_cache *cache, unsigned int *size, unsigned int *names_size,
+                                 unsigned int *names_pos, unsigned int *unix_size, unsigned int *unix_pos,
+                                 const char *unix_name )
+{
+    WCHAR buffer[MAX_DIR_ENTRY_LEN];
+    struct dir_cache_entry *entry;
+    unsigned int unix_len = strlen( unix_name ) + 1;
+    int len;
+
+    len = ntdll_umbstowcs( unix_name, unix_len - 1, buffer, MAX_DIR_ENTRY_LEN );
+
+    if (cache->count == *size)
+    {
+        unsigned int new_size = max( 64, *size * 2 );
+        void *new_entries = realloc( cache->entries, new_size * sizeof(*cache->entries) );
+        if (!new_entries) return FALSE;
+        cache->entries = new_entries;
+        *size = new_size;
+    }
+    if (*names_pos + len > *names_size)
+    {
+        unsigned int new_size = max( 1024, max( *names_size * 2, *names_pos + len ));
+        void *new_names = realloc( cache->names, new_size * sizeof(WCHAR) );
+        if (!new_names) return FALSE;
+        cache->names = new_names;
+        *names_size = new_size;
+    }
+    if (*unix_pos + unix_len > *unix_size)
+    {
+        unsigned int new_size = max( 1024, max( *unix_size * 2, *unix_pos + unix_len ));
+        void *new_names = realloc( cache->unix_names, new_size );
+        if (!new_names) return FALSE;
+        cache->unix_names = new_names;
+        *unix_size = new_size;
+    }
+
+    entry = &cache->entries[cache->count++];
+    entry->name = *names_pos;
+    entry->len = len;
+    memcpy( cache->names + *names_pos, buffer, len * sizeof(WCHAR) );
+    *names_pos += len;
+    entry->unix_name = *unix_pos;
+    memcpy( cache->unix_names + *unix_pos, unix_name, unix_len );
+    *unix_pos += unix_len;
+    if (is_legal_8dot3_name( buffer, len )) entry->short_len = 0;
+    else entry->short_len = hash_short_file_name( buffer, len, entry->short_name );
+    return TRUE;
+}
+
+/* read the directory and build the hash tables, called without dir_cache_mutex held */
+static struct dir_cache *create_dir_cache( const char *dir, const struct stat *st )
+{
+    unsigned int i, hash, size = 0, names_size = 0, names_pos = 0, unix_size = 0, unix_pos = 0;
+    struct dir_cache *cache;
+    struct dirent *de;
+    DIR *dirp;
+
+    if (!(cache = calloc( 1, sizeof(*cache) ))) return NULL;
+    cache->dev = st->st_dev;
+    cache->ino = st->st_ino;
+    cache->wd = -1;
+    get_stat_mtime( st, &cache->mtime, &cache->mtime_nsec );
+
+#ifdef HAVE_SYS_INOTIFY_H
+    /* add the watch first so that we don't miss changes made while reading */
+    if (dir_cache_inotify_fd != -1)
+    {
+        cache->wd = inotify_add_watch( dir_cache_inotify_fd, dir, IN_ONLYDIR | IN_CREATE | IN_DELETE |
+                                       IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF );
+        /* the watch limit is shared with other processes, don't make things worse */
+        if (cache->wd == -1 && errno == ENOSPC) goto failed;
+    }
+#endif
+
+    if (!(dirp = opendir( dir ))) goto failed;
+    while ((de = readdir( dirp )))
+        if (cache->count >= DIR_CACHE_MAX_ENTRIES ||
+            !add_dir_cache_entry( cache, &size, &names_size, &names_pos, &unix_size, &unix_pos, de->d_name ))
+            break;
+    closedir( dirp );
+    if (de) goto failed;
+
+    for (cache->hash_mask = 15; cache->hash_mask < cache->count; cache->hash_mask = cache->hash_mask * 2 + 1);
+    if (!(cache->buckets = calloc( 2 * (cache->hash_mask + 1), sizeof(*cache->buckets) ))) goto failed;
+    cache->short_buckets = cache->buckets + cache->hash_mask + 1;
+
+    for (i = 0; i < cache->count; i++)
+    {
+        struct dir_cache_entry *entry = &cache->entries[i];
+
+        hash = dir_cache_hash( cache->names + entry->name, entry->len ) & cache->hash_mask;
+        entry->next = cache->buckets[hash];
+        cache->buckets[hash] = i + 1;
+        if (!entry->short_len) continue;
+        hash = dir_cache_hash( entry->short_name, entry->short_len ) & cache->hash_mask;
+        entry->short_next = cache->short_buckets[hash];
+        cache->short_buckets[hash] = i + 1;
+    }
+    return cache;
+
+failed:
+    free_dir_cache( cache );
+    return NULL;
+}
+
+/* get the cached listing of a directory, dir_cache_mutex must be held */
+static struct dir_cache *get_dir_cache( const struct stat *st )
+{
+    struct dir_cache *cache;
+    time_t mtime;
+    long nsec;
+
+    get_stat_mtime( st, &mtime, &nsec );
+
+    process_dir_cache_events();
+
+    LIST_FOR_EACH_ENTRY( cache, &dir_cache_list, struct dir_cache, entry )
+    {
+        if (cache->dev != st->st_dev || cache->ino != st->st_ino) continue;
+        if (cache->mtime == mtime && cache->mtime_nsec == nsec)
+        {
+            list_remove( &cache->entry );
+            list_add_head( &dir_cache_list, &cache->entry );
+            return cache;
+        }
+        remove_dir_cache( cache );
+        break;
+    }
+    return NULL;
+}
+
+/* add a listing read with create_dir_cache() to the cache, dir_cache_mutex must be held;
+ * returns FALSE if it can't be kept, in which case the caller must free it */
+static BOOL add_dir_cache( struct dir_cache *cache, unsigned int serial )
+{
+    struct dir_cache *other;
+
+    process_dir_cache_events();
+
+    /* something changed while the directory was read, we can't tell what */
+    if (serial != dir_cache_serial) return FALSE;
+
+    /* without a watch we can't detect changes made within the timestamp granularity */
+    if (cache->wd == -1 && cache->mtime >= time( NULL ) - 1) return FALSE;
+
+    if (cache->count >= DIR_CACHE_MAX_ENTRIES) return FALSE;
+
+    /* another thread may have read it in the meantime */
+    LIST_FOR_EACH_ENTRY( other, &dir_cache_list, struct dir_cache, entry )
+        if (other->dev == cache->dev && other->ino == cache->ino) return FALSE;
+
+    list_add_head( &dir_cache_list, &cache->entry );
+    dir_cache_dirs++;
+    dir_cache_entries += cache->count;
+    while (dir_cache_dirs > 1 && (dir_cache_dirs > DIR_CACHE_MAX_DIRS || dir_cache_entries > DIR_CACHE_MAX_ENTRIES))
+        remove_dir_cache( LIST_ENTRY( list_tail( &dir_cache_list ), struct dir_cache, entry ));
+    return TRUE;
+}
+
+/* find a name in a cached listing, returning the Unix name */
+static const char *find_dir_cache_entry( const struct dir_cache *cache, const WCHAR *name, int length,
+                                         BOOLEAN is_name_8_dot_3 )
+{
+    const struct dir_cache_entry *entry;
+    unsigned int i, hash = dir_cache_hash( name, length ) & cache->hash_mask;
+
+    for (i = cache->buckets[hash]; i; i = entry->next)
+    {
+        entry = &cache->entries[i - 1];
+        if (entry->len == length && !wcsnicmp( cache->names + entry->name, name, length ))
+            return cache->unix_names + entry->unix_name;
+    }
+
+    if (!is_name_8_dot_3) return NULL;
+
+    for (i = cache->short_buckets[hash]; i; i = entry->short_next)
+    {
+        entry = &cache->entries[i - 1];
+        if (entry->short_len == length && !wcsnicmp( entry->short_name, name, length ))
+            return cache->unix_names + entry->unix_name;
+    }
+    return NULL;
+}
+
+
 /***********************************************************************
  *           find_file_in_dir
  *
@@ -2563,6 +3111,47 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
     }
 #endif /* VFAT_IOCTL_READDIR_BOTH */
 
+    if (dir_cache_enabled && !stat( unix_name, &st ))
+    {
+        struct dir_cache *cache;
+        const char *found;
+        NTSTATUS status = STATUS_NO_MEMORY;
+        unsigned int serial;
+
+        mutex_lock( &dir_cache_mutex );
+        if ((cache = get_dir_cache( &st )))
+        {
+            if ((found = find_dir_cache_entry( cache, name, length, is_name_8_dot_3 )))
+            {
+                unix_name[pos - 1] = '/';
+                strcpy( unix_name + pos, found );
+                status = STATUS_SUCCESS;
+            }
+            else status = STATUS_OBJECT_PATH_NOT_FOUND;
+        }
+        serial = dir_cache_serial;
+        mutex_unlock( &dir_cache_mutex );
+
+        /* read the directory without holding the lock, the new listing is private until it's added */
+        if (!cache && (cache = create_dir_cache( unix_name, &st )))
+        {
+            if ((found = find_dir_cache_entry( cache, name, length, is_name_8_dot_3 )))
+            {
+                unix_name[pos - 1] = '/';
+                strcpy( unix_name + pos, found );
+                status = STATUS_SUCCESS;
+            }
+            else status = STATUS_OBJECT_PATH_NOT_FOUND;
+
+            mutex_lock( &dir_cache_mutex );
+            if (!add_dir_cache( cache, serial )) free_dir_cache( cache );
+            mutex_unlock( &dir_cache_mutex );
+        }
+        if (status == STATUS_SUCCESS) return status;
+        if (status == STATUS_OBJECT_PATH_NOT_FOUND) goto not_found;
+        /* fall back to reading the directory */
+    }
+
     if (!(dir = opendir( unix_name ))) return errno_to_status( errno );
 
     unix_name[pos - 1] = '/';
@@ -2765,6 +3354,62 @@ BOOL get_redirect( OBJECT_ATTRIBUTES *attr, UNICODE_STRING *redir )
 #endif
 
 
+/* Detection of large sequential reads, used to ask the kernel to start reading the data
+ * that will likely be requested next while the application processes the current block.
+ * Enabled with WINE_FILE_READAHEAD=<maximum readahead window in MiB>. */
+
+#define READAHEAD_MIN_LENGTH 0x10000  /* only consider reads of at least 64KiB */
+#define READAHEAD_SLOTS      64
+
+struct readahead_state
+{
+    HANDLE    handle;  /* file handle, states are only hints so collisions are harmless */
+    ULONGLONG end;     /* end offset of the last read */
+    ULONGLONG ahead;   /* end offset of the data already requested from the kernel */
+    ULONG     window;  /* current readahead window size */
+};
+
+static ULONG readahead_max_window;
+static struct readahead_state readahead_states[READAHEAD_SLOTS];
+static pthread_mutex_t readahead_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void file_readahead( HANDLE handle, int fd, ULONGLONG offset, ULONG length )
+{
+#ifdef HAVE_POSIX_FADVISE
+    struct readahead_state *state;
+    ULONGLONG start = 0, end = offset + length;
+    ULONG size = 0;
+
+    if (!readahead_max_window || length < READAHEAD_MIN_LENGTH) return;
+
+    mutex_lock( &readahead_mutex );
+    state = &readahead_states[((ULONG_PTR)handle >> 2) % READAHEAD_SLOTS];
+    if (state->handle == handle && state->end == offset)
+    {
+        /* sequential access, grow the window and request what isn't already requested */
+        state->window = min( max( state->window * 2, length ), readahead_max_window );
+        start = max( state->ahead, end );
+        if (end + state->window > start) size = end + state->window - start;
+        state->ahead = start + size;
+    }
+    else
+    {
+        state->handle = handle;
+        state->window = 0;
+        state->ahead = end;
+    }
+    state->end = end;
+    mutex_unlock( &readahead_mutex );
+
+    if (size)
+    {
+        TRACE( "handle %p, reading ahead %#x bytes at %s\n", handle, size, wine_dbgstr_longlong(start) );
+        posix_fadvise( fd, start, size, POSIX_FADV_WILLNEED );
+    }
+#endif
+}
+
+
 #define IS_OPTION_TRUE(ch) ((ch) == 'y' || (ch) == 'Y' || (ch) == 't' || (ch) == 'T' || (ch) == '1')
 
 /***********************************************************************
@@ -2772,6 +3417,7 @@ BOOL get_redirect( OBJECT_ATTRIBUTES *attr, UNICODE_STRING *redir )
  */
 void init_files(void)
 {
+    const char *env;
     HANDLE key;
 
 #ifndef _WIN64
@@ -2788,6 +3434,16 @@ void init_files(void)
     start_umask = umask( 0777 );
     umask( start_umask );
 
+    if ((env = getenv( "WINE_DIR_CACHE" )) && atoi( env ))
+    {
+        dir_cache_enabled = TRUE;
+#ifdef HAVE_SYS_INOTIFY_H
+        dir_cache_inotify_fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+#endif
+    }
+    if ((env = getenv( "WINE_FILE_READAHEAD" )))
+        readahead_max_window = min( max( atoi( env ), 0 ), 1024 ) << 20;
+
     if (!open_hkcu_key( "Software\\Wine", &key ))
     {
         static WCHAR showdotfilesW[] = {'S','h','o','w','D','o','t','F','i','l','e','s',0};
@@ -5580,6 +6236,7 @@ NTSTATUS WINAPI NtReadFile( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, vo
             }
             if (!async_read) /* update file pointer position */
                 lseek( unix_handle, offset->QuadPart + result, SEEK_SET );
+            file_readahead( handle, unix_handle, offset->QuadPart, result );
 
             total = result;
             status = (total || !length) ? STATUS_SUCCESS : STATUS_END_OF_FILE;
@@ -5618,6 +6275,11 @@ NTSTATUS WINAPI NtReadFile( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, vo
             {
                 if (total)
                 {
+                    if (type == FD_TYPE_FILE && readahead_max_window)
+                    {
+                        off_t pos = lseek( unix_handle, 0, SEEK_CUR );
+                        if (pos != -1) file_readahead( handle, unix_handle, pos - total, total );
+                    }
                     status = STATUS_SUCCESS;
                     goto done;
                 }
@@ -0,0 +1,617 @@
+/*
+ * Sampling profiler
+ *
+ * Copyright (C) the Wine project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#if 0
+#pragma makedep unix
+#endif
+
+#include "config.h"
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winnt.h"
+#include "winternl.h"
+#include "unix_private.h"
+#include "wine/debug.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(profile);
+
+/* The profiler is enabled by setting WINE_PROFILE to an output file name; the
+ * folded stacks are written to <name>.<pid> when the process exits, in the
+ * format expected by flamegraph.pl.  WINE_PROFILE_FREQ sets the sampling rate
+ * in Hz.  Each thread gets its own CPU time timer, so only threads that are
+ * actually running get sampled, and only Wine threads ever receive SIGPROF.
+ *
+ * The samples are stored in a preallocated buffer, each one as a frame count
+ * followed by the frame addresses, innermost first.  Return addresses are
+ * stored minus one so that they resolve to the calling instruction. */
+
+#define PROFILE_BUFFER_SIZE (16 * 1024 * 1024)  /* in ULONG_PTR units */
+
+static const char *profile_output;
+static BOOL profile_active;
+static unsigned int profile_freq = 1000;
+static ULONG_PTR *profile_buffer;
+static ULONG_PTR profile_pos;
+static LONG profile_dropped;
+static LONG profile_stopped;
+
+#if defined(__linux__) && defined(SIGEV_THREAD_ID) && defined(HAVE_SYS_SYSCALL_H)
+# ifndef sigev_notify_thread_id
+#  define sigev_notify_thread_id _sigev_un._tid
+# endif
+# define HAVE_PROFILE_TIMER
+C_ASSERT( sizeof(timer_t) <= sizeof(void *) );
+#endif
+
+
+/***********************************************************************
+ *           profile_init
+ *
+ * Check whether profiling is requested; the caller then installs the
+ * SIGPROF handler and calls profile_start.
+ */
+BOOL profile_init(void)
+{
+#ifdef HAVE_PROFILE_TIMER
+    const char *env;
+
+    if (!(profile_output = getenv( "WINE_PROFILE" )) || !profile_output[0]) return FALSE;
+    if ((env = getenv( "WINE_PROFILE_FREQ" )) && atoi( env ) > 0) profile_freq = min( atoi( env ), 100000 );
+
+    profile_buffer = mmap( NULL, PROFILE_BUFFER_SIZE * sizeof(ULONG_PTR), PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+    if (profile_buffer == MAP_FAILED)
+    {
+        ERR( "failed to allocate the profile buffer\n" );
+        profile_buffer = NULL;
+        return FALSE;
+    }
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+
+/***********************************************************************
+ *           profile_init_thread
+ *
+ * Start sampling the current thread.
+ */
+void profile_init_thread(void)
+{
+#ifdef HAVE_PROFILE_TIMER
+    struct ntdll_thread_data *thread_data = ntdll_get_thread_data();
+    struct itimerspec spec;
+    struct sigevent sev;
+    timer_t timer;
+
+    if (!profile_active) return;
+
+    memset( &sev, 0, sizeof(sev) );
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_signo = SIGPROF;
+    sev.sigev_notify_thread_id = syscall( SYS_gettid );
+    if (timer_create( CLOCK_THREAD_CPUTIME_ID, &sev, &timer ) == -1)
+    {
+        WARN( "failed to create the profiling timer\n" );
+        return;
+    }
+    spec.it_interval.tv_sec = 0;
+    spec.it_interval.tv_nsec = 1000000000 / profile_freq;
+    spec.it_value = spec.it_interval;
+    timer_settime( timer, 0, &spec, NULL );
+    thread_data->profile_timer = timer;
+#endif
+}
+
+
+/***********************************************************************
+ *           profile_exit_thread
+ */
+void profile_exit_thread(void)
+{
+#ifdef HAVE_PROFILE_TIMER
+    struct ntdll_thread_data *thread_data = ntdll_get_thread_data();
+
+    if (!thread_data->profile_timer) return;
+    timer_delete( (timer_t)thread_data->profile_timer );
+    thread_data->profile_timer = NULL;
+#endif
+}
+
+
+/***********************************************************************
+ *           profile_start
+ *
+ * Called once the SIGPROF handler is installed.
+ */
+void profile_start(void)
+{
+    profile_active = TRUE;
+    profile_init_thread();
+    TRACE( "sampling at %u Hz into %s.%u\n", profile_freq, profile_output, (int)getpid() );
+}
+
+
+/***********************************************************************
+ *           profile_add_sample
+ *
+ * Store a sample; called from the SIGPROF handler.
+ */
+void profile_add_sample( const ULONG_PTR *frames, unsigned int count )
+{
+    ULONG_PTR pos;
+    unsigned int i;
+
+    if (!count || profile_stopped) return;
+    pos = __atomic_fetch_add( &profile_pos, count + 1, __ATOMIC_RELAXED );
+    if (pos + count + 1 > PROFILE_BUFFER_SIZE)
+    {
+        InterlockedIncrement( &profile_dropped );
+        return;
+    }
+    for (i = 0; i < count; i++) profile_buffer[pos + 1 + i] = frames[i];
+    __atomic_store_n( &profile_buffer[pos], count, __ATOMIC_RELEASE );
+}
+
+
+static int compare_samples( const void *p1, const void *p2 )
+{
+    const ULONG_PTR *s1 = *(const ULONG_PTR * const *)p1;
+    const ULONG_PTR *s2 = *(const ULONG_PTR * const *)p2;
+    ULONG_PTR i;
+
+    if (s1[0] != s2[0]) return s1[0] < s2[0] ? -1 : 1;
+    for (i = 1; i <= s1[0]; i++) if (s1[i] != s2[i]) return s1[i] < s2[i] ? -1 : 1;
+    return 0;
+}
+
+static int compare_addrs( const void *p1, const void *p2 )
+{
+    ULONG_PTR a1 = *(const ULONG_PTR *)p1, a2 = *(const ULONG_PTR *)p2;
+    return a1 < a2 ? -1 : a1 > a2;
+}
+
+
+/***********************************************************************
+ *           get_module_name
+ *
+ * Convert a module name to something that can be used in a symbol name.
+ */
+static void get_module_name( const WCHAR *str, size_t len, char *name, size_t size )
+{
+    size_t i, start = 0;
+
+    for (i = 0; i < len; i++) if (str[i] == '\\' || str[i] == '/') start = i + 1;
+    for (i = 0; start + i < len && i < size - 1; i++)
+    {
+        WCHAR ch = str[start + i];
+        name[i] = (ch > 0x20 && ch < 0x7f && ch != ';') ? ch : '_';
+    }
+    name[i] = 0;
+}
+
+
+/***********************************************************************
+ *           is_valid_rva_range
+ */
+static inline BOOL is_valid_rva_range( SIZE_T image_size, ULONG64 rva, ULONG64 len )
+{
+    return rva <= image_size && len <= image_size - rva;
+}
+
+
+/***********************************************************************
+ *           get_nt_headers
+ *
+ * Return the NT headers of a mapped image if they are inside it.
+ */
+static const IMAGE_NT_HEADERS *get_nt_headers( const void *module, SIZE_T image_size )
+{
+    const IMAGE_DOS_HEADER *dos = module;
+    const IMAGE_NT_HEADERS *nt;
+
+    if (!is_valid_rva_range( image_size, 0, sizeof(*dos) )) return NULL;
+    if (!is_valid_rva_range( image_size, (DWORD)dos->e_lfanew,
+                             offsetof( IMAGE_NT_HEADERS, OptionalHeader.Magic ) + sizeof(WORD) ))
+        return NULL;
+    nt = (const IMAGE_NT_HEADERS *)((const char *)module + (DWORD)dos->e_lfanew);
+    if (!is_valid_rva_range( image_size, (DWORD)dos->e_lfanew,
+                             offsetof( IMAGE_NT_HEADERS, OptionalHeader ) + nt->FileHeader.SizeOfOptionalHeader ))
+        return NULL;
+    return nt;
+}
+
+
+/***********************************************************************
+ *           get_export_dir
+ *
+ * Return the export directory of a mapped image, after checking that it and
+ * its function, name and ordinal tables are inside the image.
+ */
+static const IMAGE_EXPORT_DIRECTORY *get_export_dir( const void *module, SIZE_T image_size,
+                                                     DWORD *start, DWORD *size )
+{
+    const IMAGE_NT_HEADERS *nt = get_nt_headers( module, image_size );
+    const IMAGE_DATA_DIRECTORY *dir;
+    const IMAGE_EXPORT_DIRECTORY *exports;
+
+    if (!nt) return NULL;
+    if (nt->OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR32_MAGIC)
+    {
+        const IMAGE_NT_HEADERS32 *nt32 = (const IMAGE_NT_HEADERS32 *)nt;
+        if (nt32->OptionalHeader.NumberOfRvaAndSizes <= IMAGE_DIRECTORY_ENTRY_EXPORT) return NULL;
+        if (nt->FileHeader.SizeOfOptionalHeader <
+            offsetof( IMAGE_OPTIONAL_HEADER32, DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT + 1] ))
+            return NULL;
+        dir = &nt32->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT];
+    }
+    else if (nt->OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC)
+    {
+        const IMAGE_NT_HEADERS64 *nt64 = (const IMAGE_NT_HEADERS64 *)nt;
+        if (nt64->OptionalHeader.NumberOfRvaAndSizes <= IMAGE_DIRECTORY_ENTRY_EXPORT) return NULL;
+        if (nt->FileHeader.SizeOfOptionalHeader <
+            offsetof( IMAGE_OPTIONAL_HEADER64, DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT + 1] ))
+            return NULL;
+        dir = &nt64->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT];
+    }
+    else return NULL;
+
+    if (!dir->VirtualAddress || !dir->Size) return NULL;
+    if (!is_valid_rva_range( image_size, dir->VirtualAddress, sizeof(*exports) )) return NULL;
+    exports = (const IMAGE_EXPORT_DIRECTORY *)((const char *)module + dir->VirtualAddress);
+    if (!is_valid_rva_range( image_size, exports->AddressOfFunctions,
+                             (ULONG64)exports->NumberOfFunctions * sizeof(DWORD) ) ||
+        !is_valid_rva_range( image_size, exports->AddressOfNames,
+                             (ULONG64)exports->NumberOfNames * sizeof(DWORD) ) ||
+        !is_valid_rva_range( image_size, exports->AddressOfNameOrdinals,
+                             (ULONG64)exports->NumberOfNames * sizeof(WORD) ))
+        return NULL;
+    *start = dir->VirtualAddress;
+    *size = dir->Size;
+    return exports;
+}
+
+
+/***********************************************************************
+ *           get_export_name
+ *
+ * Return an export name if it is nul-terminated inside the image.
+ */
+static const char *get_export_name( const void *module, SIZE_T image_size, DWORD rva )
+{
+    const char *name = (const char *)module + rva;
+
+    if (rva >= image_size || !memchr( name, 0, image_size - rva )) return NULL;
+    return name;
+}
+
+
+/***********************************************************************
+ *           find_pe_symbol
+ *
+ * Symbolize an address inside a loaded PE module using its nearest export.
+ */
+static BOOL find_pe_symbol( ULONG_PTR addr, char *buffer, size_t size )
+{
+    LIST_ENTRY *mark, *entry;
+    LDR_DATA_TABLE_ENTRY *mod;
+    const IMAGE_EXPORT_DIRECTORY *exports;
+    const DWORD *functions, *names;
+    const WORD *ordinals;
+    char name[64];
+    const char *export = NULL;
+    DWORD rva, best = 0, dir_start, dir_size, i;
+    int best_ordinal = -1;
+
+    if (!peb || !peb->LdrData) return FALSE;
+    mark = &peb->LdrData->InLoadOrderModuleList;
+    for (entry = mark->Flink; entry && entry != mark; entry = entry->Flink)
+    {
+        mod = CONTAINING_RECORD( entry, LDR_DATA_TABLE_ENTRY, InLoadOrderLinks );
+        if (addr >= (ULONG_PTR)mod->DllBase && addr < (ULONG_PTR)mod->DllBase + mod->SizeOfImage) break;
+    }
+    if (!entry || entry == mark) return FALSE;
+
+    get_module_name( mod->BaseDllName.Buffer, mod->BaseDllName.Length / sizeof(WCHAR), name, sizeof(name) );
+    rva = addr - (ULONG_PTR)mod->DllBase;
+
+    if ((exports = get_export_dir( mod->DllBase, mod->SizeOfImage, &dir_start, &dir_size )))
+    {
+        functions = (const DWORD *)((const char *)mod->DllBase + exports->AddressOfFunctions);
+        names = (const DWORD *)((const char *)mod->DllBase + exports->AddressOfNames);
+        ordinals = (const WORD *)((const char *)mod->DllBase + exports->AddressOfNameOrdinals);
+
+        for (i = 0; i < exports->NumberOfFunctions; i++)
+        {
+            if (functions[i] > rva || functions[i] < best) continue;
+            /* skip forwarded entries */
+            if (functions[i] >= dir_start && functions[i] < dir_start + dir_size) continue;
+            best = functions[i];
+            best_ordinal = i;
+        }
+        if (best_ordinal != -1)
+        {
+            for (i = 0; i < exports->NumberOfNames; i++)
+            {
+                if (ordinals[i] != best_ordinal) continue;
+                export = get_export_name( mod->DllBase, mod->SizeOfImage, names[i] );
+                break;
+            }
+        }
+    }
+
+    if (export) snprintf( buffer, size, "%s!%s+0x%x", name, export, rva - best );
+    else if (best_ordinal != -1) snprintf( buffer, size, "%s!%u+0x%x", name,
+                                           (unsigned int)(best_ordinal + exports->Base), rva - best );
+    else snprintf( buffer, size, "%s+0x%x", name, rva );
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           get_symbol
+ */
+static char *get_symbol( ULONG_PTR addr )
+{
+    char buffer[512];
+    Dl_info info;
+
+    if (!find_pe_symbol( addr, buffer, sizeof(buffer) ))
+    {
+        if (dladdr( (void *)addr, &info ) && info.dli_fname)
+        {
+            const char *name = strrchr( info.dli_fname, '/' );
+
+            name = name ? name + 1 : info.dli_fname;
+            if (info.dli_sname)
+                snprintf( buffer, sizeof(buffer), "%s!%s+0x%lx", name, info.dli_sname,
+                          (unsigned long)(addr - (ULONG_PTR)info.dli_saddr) );
+            else
+                snprintf( buffer, sizeof(buffer), "%s+0x%lx", name,
+                          (unsigned long)(addr - (ULONG_PTR)info.dli_fbase) );
+        }
+        else snprintf( buffer, sizeof(buffer), "0x%lx", (unsigned long)addr );
+    }
+    return strdup( buffer );
+}
+
+
+/***********************************************************************
+ *           profile_dump
+ *
+ * Aggregate the samples and write them out; called on process exit.
+ */
+void profile_dump(void)
+{
+    ULONG_PTR end, pos, *addrs, **samples;
+    size_t i, j, k, count = 0, addr_count = 0, nb_addrs;
+    char **symbols, name[MAX_PATH];
+    FILE *file;
+
+    if (!profile_buffer || InterlockedExchange( &profile_stopped, 1 )) return;
+
+    end = min( __atomic_load_n( &profile_pos, __ATOMIC_ACQUIRE ), PROFILE_BUFFER_SIZE );
+    for (pos = 0; pos < end && profile_buffer[pos]; pos += profile_buffer[pos] + 1)
+    {
+        count++;
+        addr_count += profile_buffer[pos];
+    }
+
+    samples = malloc( count * sizeof(*samples) );
+    addrs = malloc( addr_count * sizeof(*addrs) );
+    if (!samples || !addrs) goto done;
+
+    for (pos = 0, i = j = 0; i < count; pos += profile_buffer[pos] + 1, i++)
+    {
+        samples[i] = profile_buffer + pos;
+        for (k = 1; k <= profile_buffer[pos]; k++) addrs[j++] = profile_buffer[pos + k];
+    }
+    qsort( samples, count, sizeof(*samples), compare_samples );
+
+    /* symbolize each distinct address once */
+    qsort( addrs, addr_count, sizeof(*addrs), compare_addrs );
+    for (i = nb_addrs = 0; i < addr_count; i++)
+        if (!nb_addrs || addrs[i] != addrs[nb_addrs - 1]) addrs[nb_addrs++] = addrs[i];
+    if (!(symbols = malloc( nb_addrs * sizeof(*symbols) ))) goto done;
+    for (i = 0; i < nb_addrs; i++) symbols[i] = get_symbol( addrs[i] );
+
+    snprintf( name, sizeof(name), "%s.%u", profile_output, (int)getpid() );
+    if (!(file = fopen( name, "w" )))
+    {
+        ERR( "failed to create %s\n", debugstr_a(name) );
+        goto free_symbols;
+    }
+    for (i = 0; i < count; i = j)
+    {
+        const ULONG_PTR *sample = samples[i];
+
+        for (j = i + 1; j < count; j++) if (compare_samples( &samples[i], &samples[j] )) break;
+        for (k = sample[0]; k > 0; k--)
+        {
+            ULONG_PTR *ptr = bsearch( &sample[k], addrs, nb_addrs, sizeof(*addrs), compare_addrs );
+            const char *sym = ptr ? symbols[ptr - addrs] : NULL;
+            fprintf( file, "%s%s", k < sample[0] ? ";" : "", sym ? sym : "?" );
+        }
+        fprintf( file, " %u\n", (unsigned int)(j - i) );
+    }
+    fclose( file );
+    if (profile_dropped) WARN( "dropped %d samples, buffer full\n", (int)profile_dropped );
+    TRACE( "wrote %u samples to %s\n", (unsigned int)count, debugstr_a(name) );
+
+free_symbols:
+    for (i = 0; i < nb_addrs; i++) free( symbols[i] );
+    free( symbols );
+done:
+    free( samples );
+    free( addrs );
+}
+
+
+/* When WINE_PERF_MAP is set, every PE image mapping is described in
+ * /tmp/perf-<pid>.map, which is where perf looks for symbols of code that
+ * doesn't come from an ELF file.  Each executable section is split at the
+ * exported functions; perf maps cannot describe unloads, so entries for
+ * unmapped images stay until another image is mapped over them. */
+
+static FILE *perf_map;
+static pthread_mutex_t perf_map_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+struct perf_map_symbol
+{
+    DWORD       rva;
+    DWORD       ordinal;
+    const char *name;
+};
+
+static int compare_perf_map_symbols( const void *p1, const void *p2 )
+{
+    const struct perf_map_symbol *s1 = p1, *s2 = p2;
+    return s1->rva < s2->rva ? -1 : s1->rva > s2->rva;
+}
+
+
+/***********************************************************************
+ *           perf_map_init
+ */
+void perf_map_init(void)
+{
+    const char *env = getenv( "WINE_PERF_MAP" );
+    char name[64];
+    int fd;
+
+    if (!env || !atoi( env )) return;
+    sprintf( name, "/tmp/perf-%u.map", (int)getpid() );
+    if ((fd = open( name, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644 )) == -1 ||
+        !(perf_map = fdopen( fd, "a" )))
+    {
+        ERR( "failed to create %s\n", name );
+        if (fd != -1) close( fd );
+    }
+}
+
+
+/***********************************************************************
+ *           perf_map_add_image
+ *
+ * Describe a newly mapped image in the perf map.
+ */
+void perf_map_add_image( void *module, SIZE_T size, const WCHAR *filename )
+{
+    const IMAGE_NT_HEADERS *nt;
+    const IMAGE_SECTION_HEADER *sec;
+    const IMAGE_EXPORT_DIRECTORY *exports;
+    const DWORD *functions, *names;
+    const WORD *ordinals;
+    struct perf_map_symbol *symbols = NULL;
+    DWORD dir_start, dir_size, i, j, count = 0;
+    char name[64];
+
+    if (!perf_map) return;
+
+    if (!(nt = get_nt_headers( module, size ))) return;
+    sec = (const IMAGE_SECTION_HEADER *)((const char *)&nt->OptionalHeader + nt->FileHeader.SizeOfOptionalHeader);
+    if (!is_valid_rva_range( size, (const char *)sec - (const char *)module,
+                             (ULONG64)nt->FileHeader.NumberOfSections * sizeof(*sec) ))
+        return;
+    get_module_name( filename, filename ? wcslen( filename ) : 0, name, sizeof(name) );
+
+    if ((exports = get_export_dir( module, size, &dir_start, &dir_size )) &&
+        (symbols = malloc( exports->NumberOfFunctions * sizeof(*symbols) )))
+    {
+        functions = (const DWORD *)((const char *)module + exports->AddressOfFunctions);
+        names = (const DWORD *)((const char *)module + exports->AddressOfNames);
+        ordinals = (const WORD *)((const char *)module + exports->AddressOfNameOrdinals);
+
+        for (i = 0; i < exports->NumberOfFunctions; i++)
+        {
+            if (!functions[i] || functions[i] >= size) continue;
+            if (functions[i] >= dir_start && functions[i] < dir_start + dir_size) continue;
+            symbols[count].rva = functions[i];
+            symbols[count].ordinal = exports->Base + i;
+            symbols[count].name = NULL;
+            count++;
+        }
+        qsort( symbols, count, sizeof(*symbols), compare_perf_map_symbols );
+        for (i = j = 0; i < count; i++)  /* merge aliases */
+            if (!j || symbols[i].rva != symbols[j - 1].rva) symbols[j++] = symbols[i];
+        count = j;
+        for (i = 0; i < exports->NumberOfNames; i++)
+        {
+            struct perf_map_symbol key, *sym;
+
+            if (ordinals[i] >= exports->NumberOfFunctions) continue;
+            key.rva = functions[ordinals[i]];
+            if (!(sym = bsearch( &key, symbols, count, sizeof(*symbols), compare_perf_map_symbols ))) continue;
+            if (!sym->name) sym->name = get_export_name( module, size, names[i] );
+        }
+    }
+
+    mutex_lock( &perf_map_mutex );
+    for (j = 0; j < nt->FileHeader.NumberOfSections; j++)
+    {
+        DWORD start = sec[j].VirtualAddress, end = start + sec[j].Misc.VirtualSize, pos = start;
+        const char *sym_name = NULL;
+        DWORD sym_ordinal = 0;
+
+        if (!(sec[j].Characteristics & IMAGE_SCN_MEM_EXECUTE)) continue;
+        if (!is_valid_rva_range( size, start, sec[j].Misc.VirtualSize )) continue;
+
+        for (i = 0; i <= count; i++)
+        {
+            DWORD next = i < count ? symbols[i].rva : end;
+
+            if (i < count && (next < start || next >= end)) continue;
+            if (next > pos)
+            {
+                fprintf( perf_map, "%lx %x ", (unsigned long)((char *)module + pos), next - pos );
+                if (sym_name) fprintf( perf_map, "%s!%s\n", name, sym_name );
+                else if (sym_ordinal) fprintf( perf_map, "%s!%u\n", name, sym_ordinal );
+                else fprintf( perf_map, "%s+0x%x\n", name, pos );
+            }
+            if (i == count) break;
+            pos = next;
+            sym_name = symbols[i].name;
+            sym_ordinal = symbols[i].ordinal;
+        }
+    }
+    fflush( perf_map );
+    mutex_unlock( &perf_map_mutex );
+    free( symbols );
+}
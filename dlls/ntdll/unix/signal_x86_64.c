@@ -3104,6 +3104,57 @@ static void usr1_handler( int signal, siginfo_t *siginfo, void *ucontext )
 }
 
 
+/**********************************************************************
+ *		prof_handler
+ *
+ * Handler for SIGPROF, used by the sampling profiler.  Walks the frame
+ * pointer chain, first on the kernel stack if we are inside a syscall, then
+ * from the syscall frame on the thread stack.
+ */
+static void prof_handler( int signal, siginfo_t *siginfo, void *sigcontext )
+{
+    ucontext_t *ucontext = sigcontext;
+    ULONG_PTR frames[64], *fp, low, high;
+    unsigned int count = 0;
+
+    frames[count++] = RIP_sig(ucontext);
+    if (fs32_sel && CS_sig(ucontext) == cs32_sel) goto done;
+
+    fp = (ULONG_PTR *)RBP_sig(ucontext);
+    if (is_inside_syscall( ucontext ))
+    {
+        struct syscall_frame *frame = amd64_thread_data()->syscall_frame;
+
+        low = RSP_sig(ucontext);
+        high = (ULONG_PTR)frame;
+        while (count < ARRAY_SIZE(frames) - 1 && !((ULONG_PTR)fp & 7) &&
+               (ULONG_PTR)fp >= low && (ULONG_PTR)fp < high - 2 * sizeof(ULONG_PTR) && fp[1])
+        {
+            frames[count++] = fp[1] - 1;
+            low = (ULONG_PTR)(fp + 2);
+            fp = (ULONG_PTR *)fp[0];
+        }
+        frames[count++] = frame->rip;
+        fp = (ULONG_PTR *)frame->rbp;
+        low = frame->rsp;
+    }
+    else low = RSP_sig(ucontext);
+
+    high = (ULONG_PTR)NtCurrentTeb()->Tib.StackBase;
+    if (low < (ULONG_PTR)NtCurrentTeb()->Tib.StackLimit || low >= high) goto done;
+    while (count < ARRAY_SIZE(frames) && !((ULONG_PTR)fp & 7) &&
+           (ULONG_PTR)fp >= low && (ULONG_PTR)fp < high - 2 * sizeof(ULONG_PTR) && fp[1])
+    {
+        frames[count++] = fp[1] - 1;
+        low = (ULONG_PTR)(fp + 2);
+        fp = (ULONG_PTR *)fp[0];
+    }
+
+done:
+    profile_add_sample( frames, count );
+}
+
+
 /**********************************************************************
  *           get_thread_ldt_entry
  */
@@ -3298,6 +3349,13 @@ void signal_init_process(void)
     if (sigaction( SIGILL, &sig_act, NULL ) == -1) goto error;
     if (sigaction( SIGBUS, &sig_act, NULL ) == -1) goto error;
     install_bpf(&sig_act);
+
+    if (profile_init())
+    {
+        sig_act.sa_sigaction = prof_handler;
+        if (sigaction( SIGPROF, &sig_act, NULL ) == -1) goto error;
+        profile_start();
+    }
     return;
 
  error:
@@ -1093,6 +1093,7 @@ static void start_thread( TEB *teb )
 
     thread_data->pthread_id = pthread_self();
     signal_init_thread( teb );
+    profile_init_thread();
     server_init_thread( thread_data->start, &suspend );
     signal_start_thread( thread_data->start, thread_data->param, suspend, teb );
 }
@@ -1399,6 +1400,8 @@ done:
 void abort_thread( int status )
 {
     pthread_sigmask( SIG_BLOCK, &server_block_set, NULL );
+    profile_exit_thread();
+    dbg_exit_thread();
     if (InterlockedDecrement( &nb_threads ) <= 0) abort_process( status );
     signal_exit_thread( status, pthread_exit_wrapper, NtCurrentTeb() );
 }
@@ -1422,6 +1425,8 @@ static DECLSPEC_NORETURN void exit_thread( int status )
     TEB *teb;
 
     pthread_sigmask( SIG_BLOCK, &server_block_set, NULL );
+    profile_exit_thread();
+    dbg_exit_thread();
 
     if ((teb = InterlockedExchangePointer( &prev_teb, NtCurrentTeb() )))
     {
@@ -1443,6 +1448,9 @@ static DECLSPEC_NORETURN void exit_thread( int status )
 void exit_process( int status )
 {
     pthread_sigmask( SIG_BLOCK, &server_block_set, NULL );
+    profile_exit_thread();
+    profile_dump();
+    virtual_save_prefetch_profiles();
     signal_exit_thread( get_unix_exit_code( status ), process_exit_wrapper, NtCurrentTeb() );
 }
 
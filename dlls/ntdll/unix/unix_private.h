@@ -64,6 +64,8 @@ struct ntdll_thread_data
     void              *param;         /* thread entry point parameter */
     void              *jmp_buf;       /* setjmp buffer for exception handling */
     void              *heap;          /* thread local heap data */
+    void              *profile_timer; /* timer for the sampling profiler */
+    void              *trace_ring;    /* binary trace ring buffer */
 };
 
 C_ASSERT( sizeof(struct ntdll_thread_data) <= sizeof(((TEB *)0)->GdiTebBatch) );
@@ -159,6 +161,8 @@ extern void *create_startup_info( const UNICODE_STRING *nt_image, const RTL_USER
                                   DWORD *info_size ) DECLSPEC_HIDDEN;
 extern char **build_envp( const WCHAR *envW ) DECLSPEC_HIDDEN;
 extern NTSTATUS exec_wineloader( char **argv, int socketfd, const pe_image_info_t *pe_info ) DECLSPEC_HIDDEN;
+extern const IMAGE_BASE_RELOCATION *process_relocation_block( void *module, const IMAGE_BASE_RELOCATION *rel,
+                                                              INT_PTR delta ) DECLSPEC_HIDDEN;
 extern NTSTATUS load_builtin( const pe_image_info_t *image_info, WCHAR *filename,
                               void **addr_ptr, SIZE_T *size_ptr ) DECLSPEC_HIDDEN;
 extern BOOL is_builtin_path( const UNICODE_STRING *path, WORD *machine ) DECLSPEC_HIDDEN;
@@ -207,6 +211,7 @@ extern void *anon_mmap_alloc( size_t size, int prot ) DECLSPEC_HIDDEN;
 extern void *steamclient_handle_fault( LPCVOID addr, DWORD err ) DECLSPEC_HIDDEN;
 
 extern void virtual_init(void) DECLSPEC_HIDDEN;
+extern void virtual_save_prefetch_profiles(void) DECLSPEC_HIDDEN;
 extern ULONG_PTR get_system_affinity_mask(void) DECLSPEC_HIDDEN;
 extern void virtual_get_system_info( SYSTEM_BASIC_INFORMATION *info, BOOL wow64 ) DECLSPEC_HIDDEN;
 extern NTSTATUS virtual_map_builtin_module( HANDLE mapping, void **module, SIZE_T *size,
@@ -291,6 +296,16 @@ extern void add_completion( HANDLE handle, ULONG_PTR value, NTSTATUS status, ULO
 extern struct cpu_topology_override *get_cpu_topology_override(void) DECLSPEC_HIDDEN;
 
 extern void dbg_init(void) DECLSPEC_HIDDEN;
+extern void dbg_exit_thread(void) DECLSPEC_HIDDEN;
+
+extern BOOL profile_init(void) DECLSPEC_HIDDEN;
+extern void profile_start(void) DECLSPEC_HIDDEN;
+extern void profile_init_thread(void) DECLSPEC_HIDDEN;
+extern void profile_exit_thread(void) DECLSPEC_HIDDEN;
+extern void profile_add_sample( const ULONG_PTR *frames, unsigned int count ) DECLSPEC_HIDDEN;
+extern void profile_dump(void) DECLSPEC_HIDDEN;
+extern void perf_map_init(void) DECLSPEC_HIDDEN;
+extern void perf_map_add_image( void *module, SIZE_T size, const WCHAR *filename ) DECLSPEC_HIDDEN;
 
 extern NTSTATUS call_user_apc_dispatcher( CONTEXT *context_ptr, ULONG_PTR arg1, ULONG_PTR arg2, ULONG_PTR arg3,
                                           PNTAPCFUNC func, NTSTATUS status ) DECLSPEC_HIDDEN;
@@ -153,10 +153,53 @@ static const BYTE VIRTUAL_Win32Flags[16] =
 
 static struct wine_rb_tree views_tree;
 static pthread_mutex_t virtual_mutex;
+/* Views and page protections are only modified with virtual_mutex held. The sequence
+ * count is odd while the mutex is held, so that queries can look them up without it and
+ * retry under the mutex if they raced with an update. */
+static unsigned int virtual_seq;
+static unsigned int virtual_lock_depth;
+
+static inline unsigned int views_read_begin(void)
+{
+    return __atomic_load_n( &virtual_seq, __ATOMIC_ACQUIRE );
+}
+
+static inline BOOL views_read_retry( unsigned int seq )
+{
+    __atomic_thread_fence( __ATOMIC_ACQUIRE );
+    return (seq & 1) || __atomic_load_n( &virtual_seq, __ATOMIC_RELAXED ) != seq;
+}
+
+static inline void begin_views_update(void)
+{
+    if (virtual_lock_depth++) return;
+    __atomic_store_n( &virtual_seq, virtual_seq + 1, __ATOMIC_RELAXED );
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+}
+
+static inline void end_views_update(void)
+{
+    if (--virtual_lock_depth) return;
+    __atomic_store_n( &virtual_seq, virtual_seq + 1, __ATOMIC_RELEASE );
+}
+
+static void virtual_lock( sigset_t *sigset )
+{
+    server_enter_uninterrupted_section( &virtual_mutex, sigset );
+    begin_views_update();
+}
+
+static void virtual_unlock( sigset_t *sigset )
+{
+    end_views_update();
+    server_leave_uninterrupted_section( &virtual_mutex, sigset );
+}
 
 static const UINT page_shift = 12;
 static const UINT_PTR page_mask = 0xfff;
 static const UINT_PTR granularity_mask = 0xffff;
+static const UINT_PTR large_page_mask = 0x1fffff;  /* matches GetLargePageMinimum() */
+static BOOL large_pages_granted;  /* set by WINE_HEAP_LARGE_PAGES */
 
 /* Note: these are Windows limits, you cannot change them. */
 #ifdef __i386__
@@ -214,6 +257,7 @@ static int pagemap_fd, pagemap_reset_fd, clear_refs_fd;
 #define PM_SOFT_DIRTY_PAGE (1ull << 57)
 
 static void reset_write_watches( void *base, SIZE_T size );
+static void remove_prefetch_image( struct file_view *view );
 
 static struct file_view *view_block_start, *view_block_end, *next_free_view;
 #ifdef _WIN64
@@ -639,7 +683,7 @@ void *get_builtin_so_handle( void *module )
     void *ret = NULL;
     struct builtin_module *builtin;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     LIST_FOR_EACH_ENTRY( builtin, &builtin_modules, struct builtin_module, entry )
     {
         if (builtin->module != module) continue;
@@ -647,7 +691,7 @@ void *get_builtin_so_handle( void *module )
         if (ret) builtin->refcount++;
         break;
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     return ret;
 }
 
@@ -662,7 +706,7 @@ static NTSTATUS get_builtin_unix_funcs( void *module, BOOL wow, void **funcs )
     NTSTATUS status = STATUS_DLL_NOT_FOUND;
     struct builtin_module *builtin;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     LIST_FOR_EACH_ENTRY( builtin, &builtin_modules, struct builtin_module, entry )
     {
         if (builtin->module != module) continue;
@@ -673,7 +717,7 @@ static NTSTATUS get_builtin_unix_funcs( void *module, BOOL wow, void **funcs )
         }
         break;
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     return status;
 }
 
@@ -689,7 +733,7 @@ NTSTATUS load_builtin_unixlib( void *module, const char *name )
     struct builtin_module *builtin;
 
     if (!(handle = dlopen( name, RTLD_NOW ))) return status;
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     LIST_FOR_EACH_ENTRY( builtin, &builtin_modules, struct builtin_module, entry )
     {
         if (builtin->module != module) continue;
@@ -701,7 +745,7 @@ NTSTATUS load_builtin_unixlib( void *module, const char *name )
         else status = STATUS_IMAGE_ALREADY_LOADED;
         break;
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     if (status) dlclose( handle );
     return status;
 }
@@ -935,6 +979,7 @@ static SIZE_T get_vprot_range_size( char *base, SIZE_T size, BYTE mask, BYTE *vp
     if (aligned_start_idx > end_idx) aligned_start_idx = end_idx;
 
 #ifdef _WIN64
+    if (!pages_vprot[curr_idx >> pages_vprot_shift]) return 0;  /* unlocked lookup raced with an update */
     vprot_ptr = pages_vprot[curr_idx >> pages_vprot_shift] + (curr_idx & pages_vprot_mask);
 #else
     vprot_ptr = pages_vprot + curr_idx;
@@ -952,7 +997,8 @@ static SIZE_T get_vprot_range_size( char *base, SIZE_T size, BYTE mask, BYTE *vp
     for (; curr_idx < end_idx; curr_idx += sizeof(UINT_PTR), vprot_ptr += sizeof(UINT_PTR))
     {
 #ifdef _WIN64
-        if (!(curr_idx & pages_vprot_mask)) vprot_ptr = pages_vprot[curr_idx >> pages_vprot_shift];
+        if (!(curr_idx & pages_vprot_mask) && !(vprot_ptr = pages_vprot[curr_idx >> pages_vprot_shift]))
+            return (curr_idx - start_idx) << page_shift;
 #endif
         if ((vprot_word ^ *(UINT_PTR *)vprot_ptr) & mask_word)
         {
@@ -1140,12 +1186,12 @@ static void VIRTUAL_Dump(void)
     struct file_view *view;
 
     TRACE( "Dump of all virtual memory views:\n" );
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     WINE_RB_FOR_EACH_ENTRY( view, &views_tree, struct file_view, entry )
     {
         dump_view( view );
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
 }
 #endif
 
@@ -1181,6 +1227,34 @@ static struct file_view *find_view( const void *addr, size_t size )
 }
 
 
+/***********************************************************************
+ *           find_view_unlocked
+ *
+ * Find the view containing a given address without holding virtual_mutex.
+ * The result is only valid if views_read_retry() returns FALSE afterwards.
+ */
+static struct file_view *find_view_unlocked( const void *addr, size_t size )
+{
+    struct wine_rb_entry *ptr = __atomic_load_n( &views_tree.root, __ATOMIC_RELAXED );
+    unsigned int depth = 0;
+
+    if ((const char *)addr + size < (const char *)addr) return NULL; /* overflow */
+
+    /* freed views stay mapped, but the tree may be inconsistent, so bound the walk */
+    while (ptr && depth++ < 128)
+    {
+        struct file_view *view = WINE_RB_ENTRY_VALUE( ptr, struct file_view, entry );
+
+        if (view->base > addr) ptr = __atomic_load_n( &ptr->left, __ATOMIC_RELAXED );
+        else if ((const char *)view->base + view->size <= (const char *)addr)
+            ptr = __atomic_load_n( &ptr->right, __ATOMIC_RELAXED );
+        else if ((const char *)view->base + view->size < (const char *)addr + size) break;  /* size too large */
+        else return view;
+    }
+    return NULL;
+}
+
+
 /***********************************************************************
  *           get_zero_bits_mask
  */
@@ -1457,6 +1531,7 @@ static void unregister_view( struct file_view *view )
 static void delete_view( struct file_view *view ) /* [in] View */
 {
     if (!(view->protect & VPROT_SYSTEM)) unmap_area( view->base, view->size );
+    if (view->protect & SEC_IMAGE) remove_prefetch_image( view );
     set_page_vprot( view->base, view->size, 0 );
     unregister_view( view );
     free_view( view );
@@ -2361,6 +2436,657 @@ static NTSTATUS map_pe_header( void *ptr, size_t size, int fd, BOOL *removable )
 }
 
 
+/* Cache of relocated image pages. When an image can't be mapped at its preferred base,
+ * the pages modified by the relocations are stored in a file keyed by the image file
+ * identity and the load address, and mapped copy-on-write from there. Processes loading
+ * the same image at the same address then share these pages through the page cache.
+ * The cache directory must belong to the user and not be writable by anybody else.
+ * Enabled with WINE_RELOC_CACHE=<cache directory>. */
+
+static char *reloc_cache_dir;
+
+struct reloc_cache_header
+{
+    char    magic[8];     /* RELOC_CACHE_MAGIC */
+    ULONG64 file_size;    /* size of the image file */
+    ULONG64 file_mtime;   /* modification time of the image file, in nanoseconds */
+    ULONG64 hash;         /* hash of the relocation blocks and of the original page contents */
+    ULONG64 base;         /* address the pages are relocated for */
+    ULONG   count;        /* number of relocated pages */
+    ULONG   data_offset;  /* file offset of the page data, page aligned */
+    /* followed by the sorted array of page RVAs, and the page data */
+};
+
+static const char RELOC_CACHE_MAGIC[8] = "WINERLC2";
+
+static void init_reloc_cache( const char *dir )
+{
+    struct stat st;
+
+    mkdir( dir, 0700 );
+    if (lstat( dir, &st ) == -1 || !S_ISDIR( st.st_mode ) || st.st_uid != getuid() || (st.st_mode & 022))
+    {
+        ERR( "not using relocation cache %s, it must be a directory owned by the user and not writable by others\n",
+             debugstr_a(dir) );
+        return;
+    }
+    reloc_cache_dir = strdup( dir );
+}
+
+static ULONG64 get_file_mtime( const struct stat *st )
+{
+    ULONG64 ret = (ULONG64)st->st_mtime * 1000000000;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    ret += st->st_mtim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    ret += st->st_mtimespec.tv_nsec;
+#endif
+    return ret;
+}
+
+static int compare_reloc_pages( const void *a, const void *b )
+{
+    ULONG page_a = *(const ULONG *)a, page_b = *(const ULONG *)b;
+    return page_a < page_b ? -1 : page_a > page_b;
+}
+
+/***********************************************************************
+ *           get_reloc_pages
+ *
+ * Validate the relocation blocks of an image and build the sorted list of the pages they modify,
+ * including the header page that receives the updated image base.
+ */
+static ULONG *get_reloc_pages( const IMAGE_BASE_RELOCATION *rel, const IMAGE_BASE_RELOCATION *end,
+                               SIZE_T total_size, ULONG *count_ret )
+{
+    const IMAGE_BASE_RELOCATION *block;
+    ULONG *pages, count = 1, i, j;
+    const USHORT *relocs;
+    BOOL cross;
+
+    for (block = rel; block < end - 1 && block->SizeOfBlock; block = (const void *)((const char *)block + block->SizeOfBlock))
+    {
+        if (block->SizeOfBlock < sizeof(*block) || (const char *)block + block->SizeOfBlock > (const char *)end) return NULL;
+        if (block->VirtualAddress & page_mask || block->VirtualAddress >= total_size) return NULL;
+        count += 2;
+    }
+    if (!(pages = malloc( count * sizeof(*pages) ))) return NULL;
+
+    pages[0] = 0;
+    count = 1;
+    for (block = rel; block < end - 1 && block->SizeOfBlock; block = (const void *)((const char *)block + block->SizeOfBlock))
+    {
+        relocs = (const USHORT *)(block + 1);
+        cross = FALSE;
+        for (i = 0; i < (block->SizeOfBlock - sizeof(*block)) / sizeof(USHORT); i++)
+        {
+            switch (relocs[i] >> 12)
+            {
+            case IMAGE_REL_BASED_ABSOLUTE:
+            case IMAGE_REL_BASED_HIGH:
+            case IMAGE_REL_BASED_LOW:
+                break;
+            case IMAGE_REL_BASED_HIGHLOW:
+                if ((relocs[i] & 0xfff) > page_mask + 1 - sizeof(int)) cross = TRUE;
+                break;
+            case IMAGE_REL_BASED_DIR64:
+                if ((relocs[i] & 0xfff) > page_mask + 1 - sizeof(INT64)) cross = TRUE;
+                break;
+            default:  /* let the loader handle the unusual cases */
+                free( pages );
+                return NULL;
+            }
+        }
+        pages[count++] = block->VirtualAddress;
+        if (cross)
+        {
+            if (block->VirtualAddress + page_size >= total_size)
+            {
+                free( pages );
+                return NULL;
+            }
+            pages[count++] = block->VirtualAddress + page_size;
+        }
+    }
+
+    qsort( pages, count, sizeof(*pages), compare_reloc_pages );
+    for (i = j = 1; i < count; i++) if (pages[i] != pages[j - 1]) pages[j++] = pages[i];
+    *count_ret = j;
+    return pages;
+}
+
+/* FNV-1a hash of the relocation blocks and of the original contents of the pages they modify */
+static ULONG64 get_reloc_hash( const void *base, const IMAGE_DATA_DIRECTORY *dir, const ULONG *pages, ULONG count )
+{
+    const unsigned char *data = (const unsigned char *)base + dir->VirtualAddress;
+    const ULONG64 *page, *page_end;
+    ULONG64 hash = 0xcbf29ce484222325ull;
+    ULONG i;
+
+    for (i = 0; i < dir->Size; i++) hash = (hash ^ data[i]) * 0x100000001b3ull;
+    for (i = 0; i < count; i++)
+    {
+        page = (const ULONG64 *)((const char *)base + pages[i]);
+        for (page_end = page + page_size / sizeof(*page); page < page_end; page++)
+            hash = (hash ^ *page) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+/***********************************************************************
+ *           open_reloc_cache
+ *
+ * Open a cache file and check that it matches the expected header and page list.
+ */
+static int open_reloc_cache( const char *name, const struct reloc_cache_header *header, const ULONG *pages )
+{
+    struct reloc_cache_header cache_header;
+    size_t pages_size = header->count * sizeof(*pages);
+    ULONG *cache_pages;
+    struct stat st;
+    BOOL ret = FALSE;
+    int fd;
+
+    if ((fd = open( name, O_RDONLY | O_CLOEXEC | O_NOFOLLOW )) == -1) return -1;
+    if (fstat( fd, &st ) == -1 || !S_ISREG( st.st_mode ) || st.st_uid != getuid() || (st.st_mode & 022) ||
+        st.st_size < header->data_offset + (off_t)header->count * page_size) goto done;
+    if (pread( fd, &cache_header, sizeof(cache_header), 0 ) != sizeof(cache_header) ||
+        memcmp( &cache_header, header, sizeof(cache_header) )) goto done;
+    if (!(cache_pages = malloc( pages_size ))) goto done;
+    ret = pread( fd, cache_pages, pages_size, sizeof(cache_header) ) == pages_size &&
+          !memcmp( cache_pages, pages, pages_size );
+    free( cache_pages );
+done:
+    if (ret) return fd;
+    close( fd );
+    return -1;
+}
+
+/***********************************************************************
+ *           write_reloc_cache
+ *
+ * Store the relocated pages of an image into a new cache file.
+ */
+static BOOL write_reloc_cache( const char *name, const struct reloc_cache_header *header,
+                               const ULONG *pages, const char *data )
+{
+    char *tmp_name;
+    BOOL ret = FALSE;
+    ULONG i;
+    int fd;
+
+    if (!(tmp_name = malloc( strlen( name ) + 16 ))) return FALSE;
+    sprintf( tmp_name, "%s.%x", name, (int)getpid() );
+    unlink( tmp_name );
+    if ((fd = open( tmp_name, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600 )) == -1)
+    {
+        WARN_(module)( "failed to create %s: %s\n", debugstr_a(tmp_name), strerror(errno) );
+        free( tmp_name );
+        return FALSE;
+    }
+
+    if (pwrite( fd, header, sizeof(*header), 0 ) != sizeof(*header)) goto done;
+    if (pwrite( fd, pages, header->count * sizeof(*pages), sizeof(*header) ) != header->count * sizeof(*pages))
+        goto done;
+    for (i = 0; i < header->count; i++)
+        if (pwrite( fd, data + pages[i], page_size,
+                    header->data_offset + (off_t)i * page_size ) != page_size) goto done;
+    ret = !rename( tmp_name, name );
+
+done:
+    close( fd );
+    if (!ret) unlink( tmp_name );
+    free( tmp_name );
+    return ret;
+}
+
+static NTSTATUS map_reloc_cache_pages( struct file_view *view, int fd, const struct reloc_cache_header *header,
+                                       const ULONG *pages, ULONG start, ULONG end )
+{
+    char *addr = (char *)view->base + pages[start];
+    SIZE_T size = pages[end - 1] - pages[start] + page_size;
+    off_t offset = header->data_offset + (off_t)start * page_size;
+    BYTE vprot = get_page_vprot( addr );
+    NTSTATUS status;
+
+    if ((status = map_file_into_view( view, fd, pages[start], size, offset,
+                                      VPROT_COMMITTED | VPROT_READ | VPROT_WRITECOPY, FALSE )))
+    {
+        WARN_(module)( "failed to map relocated pages at %p, reading them\n", addr );
+        status = map_file_into_view( view, fd, pages[start], size, offset,
+                                     VPROT_COMMITTED | VPROT_READ | VPROT_WRITECOPY, TRUE );
+    }
+    if (!status) set_vprot( view, addr, size, vprot );
+    return status;
+}
+
+/***********************************************************************
+ *           map_reloc_cache
+ *
+ * Map the relocated pages from a validated cache file into the image view. Once some pages
+ * have been replaced the relocations can't be left to the loader anymore, so a failure is
+ * returned if the pages can't be mapped or read.
+ */
+static NTSTATUS map_reloc_cache( void *base, SIZE_T size, int fd, const struct reloc_cache_header *header,
+                                 const ULONG *pages )
+{
+    struct file_view *view;
+    NTSTATUS status = STATUS_SUCCESS;
+    ULONG i, start, first_end;
+    sigset_t sigset;
+
+    virtual_lock( &sigset );
+    if (!(view = find_view( base, 0 )) || view->base != base || view->size != size ||
+        !(view->protect & SEC_IMAGE))
+    {
+        virtual_unlock( &sigset );
+        return STATUS_SUCCESS;
+    }
+
+    /* map runs of contiguous pages with the same protections at once; the run containing the header
+     * is mapped last, so that the image base is only updated once all the other pages are relocated */
+    for (i = start = 0, first_end = header->count; i < header->count && !status; i++)
+    {
+        if (i + 1 < header->count && pages[i + 1] == pages[i] + page_size &&
+            get_page_vprot( (char *)base + pages[i + 1] ) == get_page_vprot( (char *)base + pages[start] ))
+            continue;
+        if (!start) first_end = i + 1;
+        else status = map_reloc_cache_pages( view, fd, header, pages, start, i + 1 );
+        start = i + 1;
+    }
+    if (!status) status = map_reloc_cache_pages( view, fd, header, pages, 0, first_end );
+    virtual_unlock( &sigset );
+
+    if (status) ERR( "failed to map relocated pages at %p\n", base );
+    else TRACE_(module)( "mapped %u relocated pages at %p from cache\n", header->count, base );
+    return status;
+}
+
+/***********************************************************************
+ *           relocate_image_from_cache
+ *
+ * Apply the image relocations through the relocation cache. On success, the image base in the
+ * header is updated so that the loader doesn't apply them again. If the image can't be cached,
+ * it is left untouched for the loader to relocate.
+ * The cache file I/O is done without holding virtual_mutex.
+ */
+static NTSTATUS relocate_image_from_cache( void *base, SIZE_T size, const WCHAR *filename, int image_fd )
+{
+    IMAGE_DOS_HEADER *dos = base;
+    IMAGE_NT_HEADERS *nt = (IMAGE_NT_HEADERS *)((char *)base + dos->e_lfanew);
+    IMAGE_NT_HEADERS32 *nt32 = (IMAGE_NT_HEADERS32 *)nt;
+    IMAGE_NT_HEADERS64 *nt64 = (IMAGE_NT_HEADERS64 *)nt;
+    const IMAGE_DATA_DIRECTORY *dir;
+    const IMAGE_BASE_RELOCATION *rel, *end;
+    struct reloc_cache_header header;
+    NTSTATUS status = STATUS_SUCCESS;
+    ULONG *pages, count, i;
+    ULONG64 orig_base;
+    struct stat st;
+    char *name, *data;
+    int fd;
+
+    if (dos->e_lfanew < 0 || dos->e_lfanew + sizeof(IMAGE_NT_HEADERS64) > page_size) return STATUS_SUCCESS;
+    if (!(nt->FileHeader.Characteristics & IMAGE_FILE_DLL)) return STATUS_SUCCESS;
+    if (nt->FileHeader.Characteristics & IMAGE_FILE_RELOCS_STRIPPED) return STATUS_SUCCESS;
+
+    switch (nt->OptionalHeader.Magic)
+    {
+    case IMAGE_NT_OPTIONAL_HDR32_MAGIC:
+        if (nt32->OptionalHeader.SectionAlignment < page_size) return STATUS_SUCCESS;
+        orig_base = nt32->OptionalHeader.ImageBase;
+        dir = &nt32->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC];
+        break;
+    case IMAGE_NT_OPTIONAL_HDR64_MAGIC:
+        if (nt64->OptionalHeader.SectionAlignment < page_size) return STATUS_SUCCESS;
+        orig_base = nt64->OptionalHeader.ImageBase;
+        dir = &nt64->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC];
+        break;
+    default:
+        return STATUS_SUCCESS;
+    }
+    if (orig_base == (ULONG_PTR)base) return STATUS_SUCCESS;
+    if (!dir->VirtualAddress || !dir->Size || dir->VirtualAddress >= size ||
+        dir->Size > size - dir->VirtualAddress) return STATUS_SUCCESS;
+    if (fstat( image_fd, &st ) == -1) return STATUS_SUCCESS;
+
+    rel = (const IMAGE_BASE_RELOCATION *)((char *)base + dir->VirtualAddress);
+    end = (const IMAGE_BASE_RELOCATION *)((char *)base + dir->VirtualAddress + dir->Size);
+    if (!(pages = get_reloc_pages( rel, end, size, &count )))
+    {
+        TRACE_(module)( "not caching relocations for %s\n", debugstr_w(filename) );
+        return STATUS_SUCCESS;
+    }
+    if (!(name = malloc( strlen( reloc_cache_dir ) + 64 )))
+    {
+        free( pages );
+        return STATUS_SUCCESS;
+    }
+    sprintf( name, "%s/%llx-%llx-%lx", reloc_cache_dir, (unsigned long long)st.st_dev,
+             (unsigned long long)st.st_ino, (unsigned long)(ULONG_PTR)base );
+
+    memset( &header, 0, sizeof(header) );
+    memcpy( header.magic, RELOC_CACHE_MAGIC, sizeof(header.magic) );
+    header.file_size   = st.st_size;
+    header.file_mtime  = get_file_mtime( &st );
+    header.hash        = get_reloc_hash( base, dir, pages, count );
+    header.base        = (ULONG_PTR)base;
+    header.count       = count;
+    header.data_offset = ROUND_SIZE( 0, sizeof(header) + count * sizeof(*pages) );
+
+    if ((fd = open_reloc_cache( name, &header, pages )) == -1)
+    {
+        /* not in the cache, relocate a copy of the pages and store the result */
+
+        if ((data = anon_mmap_alloc( size, PROT_READ | PROT_WRITE )) == MAP_FAILED) goto done;
+        TRACE_(module)( "relocating %s from %s to %p, %u pages\n", debugstr_w(filename),
+                        wine_dbgstr_longlong(orig_base), base, count );
+        for (i = 0; i < count; i++) memcpy( data + pages[i], (char *)base + pages[i], page_size );
+        while (rel < end - 1 && rel->SizeOfBlock)
+            rel = process_relocation_block( data, rel, (char *)base - (char *)(ULONG_PTR)orig_base );
+        nt = (IMAGE_NT_HEADERS *)(data + dos->e_lfanew);
+        if (nt->OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC)
+            ((IMAGE_NT_HEADERS64 *)nt)->OptionalHeader.ImageBase = (ULONG_PTR)base;
+        else
+            ((IMAGE_NT_HEADERS32 *)nt)->OptionalHeader.ImageBase = (ULONG_PTR)base;
+
+        if (write_reloc_cache( name, &header, pages, data )) fd = open_reloc_cache( name, &header, pages );
+        munmap( data, size );
+        if (fd == -1) goto done;
+    }
+
+    status = map_reloc_cache( base, size, fd, &header, pages );
+    close( fd );
+done:
+    free( name );
+    free( pages );
+    return status;
+}
+
+
+/* Image prefetching. The file pages that are resident when the process exits are
+ * recorded for each large image, and the next time the image is mapped they are read
+ * ahead from a background thread, instead of being faulted in one by one. The page
+ * cache residency only approximates the working set, so the recording is most useful
+ * from a cold start. Enabled with WINE_PREFETCH=<profile directory>. */
+
+#define PREFETCH_MIN_SIZE (1024 * 1024)
+
+static char *prefetch_dir;
+static struct list prefetch_images = LIST_INIT( prefetch_images );
+
+struct prefetch_header
+{
+    char    magic[8];     /* PREFETCH_MAGIC */
+    ULONG64 file_size;    /* size of the image file */
+    ULONG64 file_mtime;   /* modification time of the image file, in nanoseconds */
+    ULONG   count;        /* number of ranges */
+    ULONG   reserved;
+    /* followed by the array of file ranges */
+};
+
+struct prefetch_range
+{
+    ULONG64 offset;
+    ULONG64 size;
+};
+
+/* image being recorded for the next run */
+struct prefetch_image
+{
+    struct list entry;
+    void       *base;
+    SIZE_T      size;
+    char       *name;     /* profile file name */
+    ULONG64     file_size;
+    ULONG64     file_mtime;
+};
+
+struct prefetch_request
+{
+    int                   fd;
+    ULONG                 count;
+    struct prefetch_range ranges[1];
+};
+
+static const char PREFETCH_MAGIC[8] = "WINEPFT1";
+
+static void *prefetch_thread( void *arg )
+{
+    struct prefetch_request *req = arg;
+    ULONG i;
+
+#ifdef HAVE_POSIX_FADVISE
+    for (i = 0; i < req->count; i++)
+        posix_fadvise( req->fd, req->ranges[i].offset, req->ranges[i].size, POSIX_FADV_WILLNEED );
+#endif
+    close( req->fd );
+    free( req );
+    return NULL;
+}
+
+/***********************************************************************
+ *           start_image_prefetch
+ *
+ * Start reading ahead the ranges recorded in a prefetch profile.
+ */
+static BOOL start_image_prefetch( const char *name, int fd, const struct stat *st )
+{
+    struct prefetch_header header;
+    struct prefetch_request *req;
+    pthread_attr_t attr;
+    pthread_t thread;
+    sigset_t sigset, old_sigset;
+    int profile_fd;
+    BOOL ret = FALSE;
+
+    if ((profile_fd = open( name, O_RDONLY | O_CLOEXEC )) == -1) return FALSE;
+    if (pread( profile_fd, &header, sizeof(header), 0 ) != sizeof(header) ||
+        memcmp( header.magic, PREFETCH_MAGIC, sizeof(header.magic) ) ||
+        header.file_size != st->st_size || header.file_mtime != get_file_mtime( st ) ||
+        header.count > st->st_size / page_size + 1)
+        goto done;
+    ret = TRUE;  /* the profile is valid, no need to record a new one */
+
+    if (!header.count || !(req = malloc( offsetof( struct prefetch_request, ranges[header.count] ))))
+        goto done;
+    req->count = header.count;
+    if (pread( profile_fd, req->ranges, header.count * sizeof(req->ranges[0]), sizeof(header) ) !=
+        header.count * sizeof(req->ranges[0]) || (req->fd = fcntl( fd, F_DUPFD_CLOEXEC, 0 )) == -1)
+    {
+        free( req );
+        goto done;
+    }
+
+    TRACE_(module)( "prefetching %u ranges from %s\n", header.count, debugstr_a(name) );
+    sigfillset( &sigset );
+    pthread_sigmask( SIG_BLOCK, &sigset, &old_sigset );
+    pthread_attr_init( &attr );
+    pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+    if (pthread_create( &thread, &attr, prefetch_thread, req )) prefetch_thread( req );
+    pthread_attr_destroy( &attr );
+    pthread_sigmask( SIG_SETMASK, &old_sigset, NULL );
+
+done:
+    close( profile_fd );
+    return ret;
+}
+
+/***********************************************************************
+ *           prefetch_image
+ *
+ * Prefetch a newly mapped image, or remember it to record its profile on exit.
+ * virtual_mutex must not be held by caller, since this does file I/O.
+ */
+static void prefetch_image( void *base, SIZE_T size, int fd )
+{
+    struct prefetch_image *image;
+    struct file_view *view;
+    struct stat st;
+    sigset_t sigset;
+    char *name;
+
+    if (size < PREFETCH_MIN_SIZE || fstat( fd, &st )) return;
+    if (!(name = malloc( strlen( prefetch_dir ) + 64 ))) return;
+    sprintf( name, "%s/%llx-%llx.pf", prefetch_dir, (unsigned long long)st.st_dev,
+             (unsigned long long)st.st_ino );
+
+    if (start_image_prefetch( name, fd, &st ) || !(image = malloc( sizeof(*image) )))
+    {
+        free( name );
+        return;
+    }
+    image->base = base;
+    image->size = size;
+    image->name = name;
+    image->file_size = st.st_size;
+    image->file_mtime = get_file_mtime( &st );
+
+    /* the image may have been unmapped in the meantime */
+    virtual_lock( &sigset );
+    if ((view = find_view( base, 0 )) && view->base == base && view->size == size &&
+        (view->protect & SEC_IMAGE))
+    {
+        list_add_tail( &prefetch_images, &image->entry );
+        image = NULL;
+    }
+    virtual_unlock( &sigset );
+
+    if (image)
+    {
+        free( image->name );
+        free( image );
+    }
+}
+
+/***********************************************************************
+ *           remove_prefetch_image
+ *
+ * Forget about an image that is being unmapped.
+ * virtual_mutex must be held by caller.
+ */
+static void remove_prefetch_image( struct file_view *view )
+{
+    struct prefetch_image *image;
+
+    LIST_FOR_EACH_ENTRY( image, &prefetch_images, struct prefetch_image, entry )
+    {
+        if (image->base != view->base) continue;
+        list_remove( &image->entry );
+        free( image->name );
+        free( image );
+        return;
+    }
+}
+
+/***********************************************************************
+ *           add_prefetch_range
+ */
+static void add_prefetch_range( struct prefetch_range *ranges, ULONG *count, ULONG64 offset, ULONG64 size )
+{
+    if (*count && ranges[*count - 1].offset + ranges[*count - 1].size == offset)
+        ranges[*count - 1].size += size;
+    else
+    {
+        ranges[*count].offset = offset;
+        ranges[*count].size = size;
+        ++*count;
+    }
+}
+
+/***********************************************************************
+ *           write_prefetch_profile
+ *
+ * Record the file ranges of an image that are currently resident.
+ * virtual_mutex must be held by caller.
+ */
+static void write_prefetch_profile( struct prefetch_image *image )
+{
+    struct prefetch_header header;
+    struct prefetch_range *ranges;
+    struct file_view *view;
+    const IMAGE_NT_HEADERS *nt;
+    const IMAGE_SECTION_HEADER *sec;
+    SIZE_T pages = image->size >> page_shift, page, start, end;
+    ULONG count = 0, i;
+    unsigned char *vec;
+    char *tmp_name;
+    int fd;
+
+    if (!(view = find_view( image->base, 0 )) || view->base != image->base ||
+        view->size != image->size || !(view->protect & SEC_IMAGE)) return;
+
+    vec = malloc( pages );
+    ranges = malloc( (pages + 1) * sizeof(*ranges) );
+    tmp_name = malloc( strlen( image->name ) + 16 );
+    if (!vec || !ranges || !tmp_name || mincore( image->base, image->size, (void *)vec )) goto done;
+
+    /* the headers were validated when the image was mapped, but may have been changed since */
+    nt = (const IMAGE_NT_HEADERS *)((char *)image->base + ((IMAGE_DOS_HEADER *)image->base)->e_lfanew);
+    if ((char *)(nt + 1) > (char *)image->base + page_size) goto done;
+    sec = (const IMAGE_SECTION_HEADER *)((const char *)&nt->OptionalHeader + nt->FileHeader.SizeOfOptionalHeader);
+    if ((char *)(sec + nt->FileHeader.NumberOfSections) > (char *)image->base + image->size) goto done;
+    add_prefetch_range( ranges, &count, 0, page_size );
+    for (i = 0; i < nt->FileHeader.NumberOfSections && count < pages; i++)
+    {
+        if (!sec[i].PointerToRawData || !sec[i].SizeOfRawData) continue;
+        start = sec[i].VirtualAddress >> page_shift;
+        end = min( ROUND_SIZE( 0, (SIZE_T)sec[i].VirtualAddress + sec[i].SizeOfRawData ) >> page_shift, pages );
+        for (page = start; page < end && count < pages; page++)
+        {
+            if (!(vec[page] & 1)) continue;
+            add_prefetch_range( ranges, &count, sec[i].PointerToRawData + ((page - start) << page_shift),
+                                page_size );
+        }
+    }
+
+    memcpy( header.magic, PREFETCH_MAGIC, sizeof(header.magic) );
+    header.file_size = image->file_size;
+    header.file_mtime = image->file_mtime;
+    header.count = count;
+    header.reserved = 0;
+
+    sprintf( tmp_name, "%s.%x", image->name, (int)getpid() );
+    unlink( tmp_name );
+    if ((fd = open( tmp_name, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600 )) == -1) goto done;
+    if (write( fd, &header, sizeof(header) ) != sizeof(header) ||
+        write( fd, ranges, count * sizeof(*ranges) ) != count * sizeof(*ranges) ||
+        rename( tmp_name, image->name ))
+        unlink( tmp_name );
+    else
+        TRACE_(module)( "recorded %u ranges in %s\n", count, debugstr_a(image->name) );
+    close( fd );
+
+done:
+    free( tmp_name );
+    free( ranges );
+    free( vec );
+}
+
+/***********************************************************************
+ *           virtual_save_prefetch_profiles
+ *
+ * Record the prefetch profiles of the mapped images; called on process exit.
+ */
+void virtual_save_prefetch_profiles(void)
+{
+    struct prefetch_image *image, *next;
+    sigset_t sigset;
+
+    if (list_empty( &prefetch_images )) return;
+
+    virtual_lock( &sigset );
+    LIST_FOR_EACH_ENTRY_SAFE( image, next, &prefetch_images, struct prefetch_image, entry )
+    {
+        write_prefetch_profile( image );
+        list_remove( &image->entry );
+        free( image->name );
+        free( image );
+    }
+    virtual_unlock( &sigset );
+}
+
+
 /***********************************************************************
  *           map_image_into_view
  *
@@ -2368,7 +3094,8 @@ static NTSTATUS map_pe_header( void *ptr, size_t size, int fd, BOOL *removable )
  * virtual_mutex must be held by caller.
  */
 static NTSTATUS map_image_into_view( struct file_view *view, const WCHAR *filename, int fd, void *orig_base,
-                                     SIZE_T header_size, ULONG image_flags, int shared_fd, BOOL removable )
+                                     SIZE_T header_size, ULONG image_flags, int shared_fd, BOOL removable,
+                                     BOOL *prefetch )
 {
     IMAGE_DOS_HEADER *dos;
     IMAGE_NT_HEADERS *nt;
@@ -2404,6 +3131,7 @@ static NTSTATUS map_image_into_view( struct file_view *view, const WCHAR *filena
      * copying the headers into local memory is necessary to properly load such applications. */
     memcpy(sections, header_start, sizeof(*sections) * nt->FileHeader.NumberOfSections);
     sec = sections;
+    *prefetch = prefetch_dir && !removable;
 
     imports = nt->OptionalHeader.DataDirectory + IMAGE_DIRECTORY_ENTRY_IMPORT;
     if (!imports->Size || !imports->VirtualAddress) imports = NULL;
@@ -2616,6 +3344,7 @@ static NTSTATUS virtual_map_image( HANDLE mapping, ACCESS_MASK access, void **ad
     unsigned int vprot = SEC_IMAGE | SEC_FILE | VPROT_COMMITTED | VPROT_READ | VPROT_EXEC | VPROT_WRITECOPY;
     int unix_fd = -1, needs_close;
     int shared_fd = -1, shared_needs_close = 0;
+    BOOL prefetch = FALSE;
     SIZE_T size = image_info->map_size;
     struct file_view *view;
     NTSTATUS status;
@@ -2633,7 +3362,7 @@ static NTSTATUS virtual_map_image( HANDLE mapping, ACCESS_MASK access, void **ad
     }
 
     status = STATUS_INVALID_PARAMETER;
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
 
     base = wine_server_get_ptr( image_info->base );
     if ((ULONG_PTR)base != image_info->base) base = NULL;
@@ -2645,7 +3374,7 @@ static NTSTATUS virtual_map_image( HANDLE mapping, ACCESS_MASK access, void **ad
     if (status) goto done;
 
     status = map_image_into_view( view, filename, unix_fd, base, image_info->header_size,
-                                  image_info->image_flags, shared_fd, needs_close );
+                                  image_info->image_flags, shared_fd, needs_close, &prefetch );
     if (status == STATUS_SUCCESS)
     {
         SERVER_START_REQ( map_view )
@@ -2668,9 +3397,21 @@ static NTSTATUS virtual_map_image( HANDLE mapping, ACCESS_MASK access, void **ad
     else delete_view( view );
 
 done:
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
+    if (status >= 0 && reloc_cache_dir && !needs_close && !shared_file &&
+        !(image_info->image_flags & IMAGE_FLAGS_ImageMappedFlat))
+    {
+        NTSTATUS reloc_status = relocate_image_from_cache( *addr_ptr, *size_ptr, filename, unix_fd );
+        if (reloc_status)
+        {
+            NtUnmapViewOfSection( NtCurrentProcess(), *addr_ptr );
+            status = reloc_status;
+        }
+    }
+    if (status >= 0 && prefetch) prefetch_image( *addr_ptr, *size_ptr, unix_fd );
     if (needs_close) close( unix_fd );
     if (shared_needs_close) close( shared_fd );
+    if (status >= 0) perf_map_add_image( *addr_ptr, *size_ptr, filename );
     return status;
 }
 
@@ -2762,7 +3503,7 @@ static NTSTATUS virtual_map_section( HANDLE handle, PVOID *addr_ptr, ULONG_PTR z
 
     if ((res = server_get_unix_fd( handle, 0, &unix_handle, &needs_close, NULL, NULL ))) return res;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
 
     res = map_view( &view, base, size, alloc_type & (MEM_TOP_DOWN | MEM_REPLACE_PLACEHOLDER),
                     vprot, get_zero_bits_mask( zero_bits ), 0 );
@@ -2794,7 +3535,7 @@ static NTSTATUS virtual_map_section( HANDLE handle, PVOID *addr_ptr, ULONG_PTR z
     else delete_view( view );
 
 done:
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     if (needs_close) close( unix_handle );
     TRACE("status %#x.\n", res);
     return res;
@@ -2873,6 +3614,18 @@ void virtual_init(void)
 
     mmap_init( preload_info ? *preload_info : NULL );
 
+    if ((env_var = getenv("WINE_RELOC_CACHE")) && env_var[0])
+    {
+        init_reloc_cache( env_var );
+    }
+    if ((env_var = getenv("WINE_PREFETCH")) && env_var[0])
+    {
+        mkdir( env_var, 0700 );
+        prefetch_dir = strdup( env_var );
+    }
+    if ((env_var = getenv("WINE_HEAP_LARGE_PAGES")) && env_var[0] == '1') large_pages_granted = TRUE;
+    perf_map_init();
+
     if ((preload = getenv("WINEPRELOADRESERVE")))
     {
         unsigned long start, end;
@@ -3030,7 +3783,7 @@ NTSTATUS virtual_create_builtin_view( void *module, const UNICODE_STRING *nt_nam
     void *base = wine_server_get_ptr( info->base );
     int i;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     status = create_view( &view, base, size, SEC_IMAGE | SEC_FILE | VPROT_SYSTEM |
                           VPROT_COMMITTED | VPROT_READ | VPROT_WRITECOPY | VPROT_EXEC );
     if (!status)
@@ -3069,7 +3822,7 @@ NTSTATUS virtual_create_builtin_view( void *module, const UNICODE_STRING *nt_nam
         }
         else delete_view( view );
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
 
     return status;
 }
@@ -3178,7 +3931,7 @@ NTSTATUS virtual_alloc_teb( TEB **ret_teb )
     SIZE_T block_size = signal_stack_mask + 1;
     BOOL is_wow = !!NtCurrentTeb()->WowTebOffset;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     if (next_free_teb)
     {
         ptr = next_free_teb;
@@ -3194,7 +3947,7 @@ NTSTATUS virtual_alloc_teb( TEB **ret_teb )
             if ((status = NtAllocateVirtualMemory( NtCurrentProcess(), &ptr, is_win64 && is_wow ? 0x7fffffff : 0,
                                                    &total, MEM_RESERVE, PAGE_READWRITE )))
             {
-                server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+                virtual_unlock( &sigset );
                 return status;
             }
             teb_block = ptr;
@@ -3205,14 +3958,14 @@ NTSTATUS virtual_alloc_teb( TEB **ret_teb )
                                  MEM_COMMIT, PAGE_READWRITE );
     }
     *ret_teb = teb = init_teb( ptr, is_wow );
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
 
     if ((status = signal_alloc_thread( teb )))
     {
-        server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+        virtual_lock( &sigset );
         *(void **)ptr = next_free_teb;
         next_free_teb = ptr;
-        server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+        virtual_unlock( &sigset );
     }
     return status;
 }
@@ -3246,13 +3999,13 @@ void virtual_free_teb( TEB *teb )
         NtFreeVirtualMemory( GetCurrentProcess(), &ptr, &size, MEM_RELEASE );
     }
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     list_remove( &thread_data->entry );
     ptr = teb;
     if (!is_win64) ptr = (char *)ptr - teb_offset;
     *(void **)ptr = next_free_teb;
     next_free_teb = ptr;
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
 }
 
 
@@ -3266,7 +4019,7 @@ NTSTATUS virtual_clear_tls_index( ULONG index )
 
     if (index < TLS_MINIMUM_AVAILABLE)
     {
-        server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+        virtual_lock( &sigset );
         LIST_FOR_EACH_ENTRY( thread_data, &teb_list, struct ntdll_thread_data, entry )
         {
             TEB *teb = CONTAINING_RECORD( thread_data, TEB, GdiTebBatch );
@@ -3277,14 +4030,14 @@ NTSTATUS virtual_clear_tls_index( ULONG index )
 #endif
             teb->TlsSlots[index] = 0;
         }
-        server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+        virtual_unlock( &sigset );
     }
     else
     {
         index -= TLS_MINIMUM_AVAILABLE;
         if (index >= 8 * sizeof(peb->TlsExpansionBitmapBits)) return STATUS_INVALID_PARAMETER;
 
-        server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+        virtual_lock( &sigset );
         LIST_FOR_EACH_ENTRY( thread_data, &teb_list, struct ntdll_thread_data, entry )
         {
             TEB *teb = CONTAINING_RECORD( thread_data, TEB, GdiTebBatch );
@@ -3299,7 +4052,7 @@ NTSTATUS virtual_clear_tls_index( ULONG index )
 #endif
             if (teb->TlsExpansionSlots) teb->TlsExpansionSlots[index] = 0;
         }
-        server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+        virtual_unlock( &sigset );
     }
     return STATUS_SUCCESS;
 }
@@ -3324,7 +4077,7 @@ NTSTATUS virtual_alloc_thread_stack( INITIAL_TEB *stack, ULONG_PTR zero_bits, SI
     if (size < 1024 * 1024) size = 1024 * 1024;  /* Xlib needs a large stack */
     size = (size + 0xffff) & ~0xffff;  /* round to 64K boundary */
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
 
     if ((status = map_view( &view, NULL, size + extra_size, 0,
                             VPROT_READ | VPROT_WRITE | VPROT_COMMITTED, get_zero_bits_mask( zero_bits ), 0 ))
@@ -3370,7 +4123,7 @@ NTSTATUS virtual_alloc_thread_stack( INITIAL_TEB *stack, ULONG_PTR zero_bits, SI
     stack->StackBase = (char *)view->base + view->size;
     stack->StackLimit = (char *)view->base + 2 * page_size;
 done:
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     return status;
 }
 
@@ -3489,6 +4242,7 @@ NTSTATUS virtual_handle_fault( void *addr, DWORD err, void *stack )
     BYTE vprot;
 
     mutex_lock( &virtual_mutex );  /* no need for signal masking inside signal handler */
+    begin_views_update();
     vprot = get_page_vprot( page );
     if (!is_inside_signal_stack( stack ) && (vprot & VPROT_GUARD))
     {
@@ -3530,6 +4284,7 @@ NTSTATUS virtual_handle_fault( void *addr, DWORD err, void *stack )
         else
             set_page_vprot_bits( page, page_size, 0, VPROT_READ | VPROT_EXEC );
     }
+    end_views_update();
     mutex_unlock( &virtual_mutex );
     return ret;
 }
@@ -3571,12 +4326,14 @@ void *virtual_setup_exception( void *stack_ptr, size_t size, EXCEPTION_RECORD *r
     else if (stack < stack_info.limit)
     {
         mutex_lock( &virtual_mutex );  /* no need for signal masking inside signal handler */
+        begin_views_update();
         if ((get_page_vprot( stack ) & VPROT_GUARD) &&
             grow_thread_stack( ROUND_ADDR( stack, page_mask ), &stack_info ))
         {
             rec->ExceptionCode = STATUS_STACK_OVERFLOW;
             rec->NumberParameters = 0;
         }
+        end_views_update();
         mutex_unlock( &virtual_mutex );
     }
 #if defined(VALGRIND_MAKE_MEM_UNDEFINED)
@@ -3626,14 +4383,14 @@ unsigned int virtual_locked_server_call( void *req_ptr )
 
     if (!size) return wine_server_call( req_ptr );
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     if (!(ret = check_write_access( addr, size, &has_write_watch )))
     {
         ret = server_call_unlocked( req );
         if (has_write_watch) update_write_watches( addr, size, wine_server_reply_size( req ));
     }
     else memset( &req->u.reply, 0, sizeof(req->u.reply) );
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     return ret;
 }
 
@@ -3650,14 +4407,14 @@ ssize_t virtual_locked_read( int fd, void *addr, size_t size )
     ssize_t ret = read( fd, addr, size );
     if (ret != -1 || errno != EFAULT) return ret;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     if (!check_write_access( addr, size, &has_write_watch ))
     {
         ret = read( fd, addr, size );
         err = errno;
         if (has_write_watch) update_write_watches( addr, size, max( 0, ret ));
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     errno = err;
     return ret;
 }
@@ -3675,14 +4432,14 @@ ssize_t virtual_locked_pread( int fd, void *addr, size_t size, off_t offset )
     ssize_t ret = pread( fd, addr, size, offset );
     if (ret != -1 || errno != EFAULT) return ret;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     if (!check_write_access( addr, size, &has_write_watch ))
     {
         ret = pread( fd, addr, size, offset );
         err = errno;
         if (has_write_watch) update_write_watches( addr, size, max( 0, ret ));
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     errno = err;
     return ret;
 }
@@ -3701,7 +4458,7 @@ ssize_t virtual_locked_recvmsg( int fd, struct msghdr *hdr, int flags )
     ssize_t ret = recvmsg( fd, hdr, flags );
     if (ret != -1 || errno != EFAULT) return ret;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     for (i = 0; i < hdr->msg_iovlen; i++)
         if (check_write_access( hdr->msg_iov[i].iov_base, hdr->msg_iov[i].iov_len, &has_write_watch ))
             break;
@@ -3713,7 +4470,7 @@ ssize_t virtual_locked_recvmsg( int fd, struct msghdr *hdr, int flags )
     if (has_write_watch)
         while (i--) update_write_watches( hdr->msg_iov[i].iov_base, hdr->msg_iov[i].iov_len, 0 );
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     errno = err;
     return ret;
 }
@@ -3727,11 +4484,20 @@ BOOL virtual_is_valid_code_address( const void *addr, SIZE_T size )
     struct file_view *view;
     BOOL ret = FALSE;
     sigset_t sigset;
+    unsigned int seq = views_read_begin();
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    if (!(seq & 1))
+    {
+        if ((view = find_view_unlocked( addr, size )))
+            ret = !(view->protect & VPROT_SYSTEM);
+        if (!views_read_retry( seq )) return ret;
+        ret = FALSE;
+    }
+
+    virtual_lock( &sigset );
     if ((view = find_view( addr, size )))
         ret = !(view->protect & VPROT_SYSTEM);  /* system views are not visible to the app */
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     return ret;
 }
 
@@ -3818,7 +4584,7 @@ SIZE_T virtual_uninterrupted_read_memory( const void *addr, void *buffer, SIZE_T
 
     if (!size) return 0;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     if ((view = find_view( addr, size )))
     {
         if (!(view->protect & VPROT_SYSTEM))
@@ -3834,7 +4600,7 @@ SIZE_T virtual_uninterrupted_read_memory( const void *addr, void *buffer, SIZE_T
             }
         }
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     return bytes_read;
 }
 
@@ -3854,13 +4620,13 @@ NTSTATUS virtual_uninterrupted_write_memory( void *addr, const void *buffer, SIZ
 
     if (!size) return STATUS_SUCCESS;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     if (!(ret = check_write_access( addr, size, &has_write_watch )))
     {
         memcpy( addr, buffer, size );
         if (has_write_watch) update_write_watches( addr, size, size );
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     return ret;
 }
 
@@ -3875,7 +4641,7 @@ void virtual_set_force_exec( BOOL enable )
     struct file_view *view;
     sigset_t sigset;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     if (!force_exec_prot != !enable)  /* change all existing views */
     {
         force_exec_prot = enable;
@@ -3893,7 +4659,7 @@ void virtual_set_force_exec( BOOL enable )
             mprotect_range( view->base, view->size, commit, 0 );
         }
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
 }
 
 struct free_range
@@ -3964,6 +4730,36 @@ void virtual_set_large_address_space(void)
 }
 
 
+/***********************************************************************
+ *             has_lock_memory_privilege
+ *
+ * Large page allocations require SeLockMemoryPrivilege to be enabled.
+ */
+static BOOL has_lock_memory_privilege(void)
+{
+    PRIVILEGE_SET privs;
+    BOOLEAN ret = FALSE;
+    HANDLE token;
+
+    /* WINE_HEAP_LARGE_PAGES grants large pages to the whole process, since the
+     * default token doesn't hold the privilege */
+    if (large_pages_granted) return TRUE;
+
+    if (NtOpenThreadToken( GetCurrentThread(), TOKEN_QUERY, TRUE, &token ) &&
+        NtOpenProcessToken( GetCurrentProcess(), TOKEN_QUERY, &token ))
+        return FALSE;
+
+    privs.PrivilegeCount = 1;
+    privs.Control = PRIVILEGE_SET_ALL_NECESSARY;
+    privs.Privilege[0].Luid.LowPart = SE_LOCK_MEMORY_PRIVILEGE;
+    privs.Privilege[0].Luid.HighPart = 0;
+    privs.Privilege[0].Attributes = 0;
+    if (NtPrivilegeCheck( token, &privs, &ret )) ret = FALSE;
+    NtClose( token );
+    return ret;
+}
+
+
 /***********************************************************************
  *             allocate_virtual_memory
  *
@@ -4038,9 +4834,28 @@ static NTSTATUS allocate_virtual_memory( void **ret, SIZE_T *size_ptr, ULONG typ
         WARN("Wrong protect %#x for placeholder.\n", protect);
         return STATUS_INVALID_PARAMETER;
     }
+
+    if (type & MEM_LARGE_PAGES)
+    {
+        /* large pages must be reserved and committed at once, at a large page boundary */
+        if ((type & (MEM_RESERVE | MEM_COMMIT)) != (MEM_RESERVE | MEM_COMMIT) ||
+            ((UINT_PTR)base & large_page_mask))
+        {
+            WARN("Invalid large pages allocation %p-%p type %#x\n", base, (char *)base + size, type);
+            return STATUS_INVALID_PARAMETER;
+        }
+        if (!has_lock_memory_privilege())
+        {
+            WARN("SeLockMemoryPrivilege is not held\n");
+            return STATUS_PRIVILEGE_NOT_HELD;
+        }
+        size = (size + large_page_mask) & ~large_page_mask;
+        if (align <= large_page_mask) align = large_page_mask + 1;
+    }
+
     /* Reserve the memory */
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
 
     if ((type & MEM_RESERVE) || !base)
     {
@@ -4057,6 +4872,10 @@ static NTSTATUS allocate_virtual_memory( void **ret, SIZE_T *size_ptr, ULONG typ
                                     align ? align - 1 : granularity_mask );
 
             if (status == STATUS_SUCCESS) base = view->base;
+#ifdef MADV_HUGEPAGE
+            /* this is only a hint, the kernel falls back to normal pages if it can't honor it */
+            if (status == STATUS_SUCCESS && (type & MEM_LARGE_PAGES)) madvise( base, size, MADV_HUGEPAGE );
+#endif
         }
     }
     else if (type & MEM_RESET)
@@ -4084,7 +4903,7 @@ static NTSTATUS allocate_virtual_memory( void **ret, SIZE_T *size_ptr, ULONG typ
 
     if (!status) VIRTUAL_DEBUG_DUMP_VIEW( view );
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
 
     if (status == STATUS_SUCCESS)
     {
@@ -4102,7 +4921,8 @@ static NTSTATUS allocate_virtual_memory( void **ret, SIZE_T *size_ptr, ULONG typ
 NTSTATUS WINAPI NtAllocateVirtualMemory( HANDLE process, PVOID *ret, ULONG_PTR zero_bits,
                                          SIZE_T *size_ptr, ULONG type, ULONG protect )
 {
-    static const ULONG type_mask = MEM_COMMIT | MEM_RESERVE | MEM_TOP_DOWN | MEM_WRITE_WATCH | MEM_RESET;
+    static const ULONG type_mask = MEM_COMMIT | MEM_RESERVE | MEM_TOP_DOWN | MEM_WRITE_WATCH | MEM_RESET
+                                   | MEM_LARGE_PAGES;
     ULONG_PTR limit;
 
     TRACE("%p %p %08lx %x %08x\n", process, *ret, *size_ptr, type, protect );
@@ -4163,7 +4983,8 @@ NTSTATUS WINAPI NtAllocateVirtualMemoryEx( HANDLE process, PVOID *ret, SIZE_T *s
                                            ULONG count )
 {
     static const ULONG type_mask = MEM_COMMIT | MEM_RESERVE | MEM_TOP_DOWN | MEM_WRITE_WATCH
-                                   | MEM_RESET | MEM_RESERVE_PLACEHOLDER | MEM_REPLACE_PLACEHOLDER;
+                                   | MEM_RESET | MEM_RESERVE_PLACEHOLDER | MEM_REPLACE_PLACEHOLDER
+                                   | MEM_LARGE_PAGES;
     ULONG_PTR limit = 0;
     ULONG_PTR align = 0;
 
@@ -4299,7 +5120,7 @@ NTSTATUS WINAPI NtFreeVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T *si
     if (size) size = ROUND_SIZE( addr, size );
     base = ROUND_ADDR( addr, page_mask );
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
 
     /* avoid freeing the DOS area when a broken app passes a NULL pointer */
     if (!base)
@@ -4449,7 +5270,7 @@ NTSTATUS WINAPI NtFreeVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T *si
         status = STATUS_INVALID_PARAMETER;
     }
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     TRACE( "status %#x.\n", status );
     return status;
 }
@@ -4504,7 +5325,7 @@ NTSTATUS WINAPI NtProtectVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T
     size = ROUND_SIZE( addr, size );
     base = ROUND_ADDR( addr, page_mask );
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
 
     if ((view = find_view( base, size )))
     {
@@ -4538,7 +5359,7 @@ NTSTATUS WINAPI NtProtectVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T
 
     if (!status) VIRTUAL_DEBUG_DUMP_VIEW( view );
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
 
     if (status == STATUS_SUCCESS)
     {
@@ -4594,6 +5415,43 @@ static int get_free_mem_state_callback( void *start, SIZE_T size, void *arg )
     return 1;
 }
 
+/***********************************************************************
+ *           get_basic_memory_info_unlocked
+ *
+ * Fast path of get_basic_memory_info for addresses inside a view, without holding virtual_mutex.
+ */
+static BOOL get_basic_memory_info_unlocked( char *base, MEMORY_BASIC_INFORMATION *info )
+{
+    MEMORY_BASIC_INFORMATION ret;
+    struct file_view *view;
+    unsigned int seq = views_read_begin(), protect;
+    SIZE_T size;
+    BYTE vprot;
+
+    if (seq & 1) return FALSE;
+    if (!(view = find_view_unlocked( base, 0 ))) return FALSE;
+    protect = view->protect;
+    size = view->size;
+    ret.AllocationBase = view->base;
+    if (protect & SEC_RESERVE) return FALSE;  /* needs a server call */
+    if ((char *)ret.AllocationBase + size < (char *)ret.AllocationBase ||
+        base < (char *)ret.AllocationBase || base >= (char *)ret.AllocationBase + size) return FALSE;
+
+    ret.BaseAddress = base;
+    ret.RegionSize = get_vprot_range_size( base, (char *)ret.AllocationBase + size - base,
+                                           ~VPROT_WRITEWATCH, &vprot );
+    ret.State = (vprot & VPROT_COMMITTED) ? MEM_COMMIT : MEM_RESERVE;
+    ret.Protect = (vprot & VPROT_COMMITTED) ? get_win32_prot( vprot, protect ) : 0;
+    ret.AllocationProtect = get_win32_prot( protect, protect );
+    if (protect & SEC_IMAGE) ret.Type = MEM_IMAGE;
+    else if (protect & (SEC_FILE | SEC_RESERVE | SEC_COMMIT)) ret.Type = MEM_MAPPED;
+    else ret.Type = MEM_PRIVATE;
+
+    if (views_read_retry( seq ) || !ret.RegionSize) return FALSE;
+    *info = ret;
+    return TRUE;
+}
+
 /* get basic information about a memory block */
 static NTSTATUS get_basic_memory_info( HANDLE process, LPCVOID addr,
                                        MEMORY_BASIC_INFORMATION *info,
@@ -4640,9 +5498,15 @@ static NTSTATUS get_basic_memory_info( HANDLE process, LPCVOID addr,
 
     if (is_beyond_limit( base, 1, working_set_limit )) return STATUS_INVALID_PARAMETER;
 
+    if (get_basic_memory_info_unlocked( base, info ))
+    {
+        if (res_len) *res_len = sizeof(*info);
+        return STATUS_SUCCESS;
+    }
+
     /* Find the view containing the address */
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     ptr = views_tree.root;
     while (ptr)
     {
@@ -4707,7 +5571,7 @@ static NTSTATUS get_basic_memory_info( HANDLE process, LPCVOID addr,
         else if (view->protect & (SEC_FILE | SEC_RESERVE | SEC_COMMIT)) info->Type = MEM_MAPPED;
         else info->Type = MEM_PRIVATE;
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
 
     if (res_len) *res_len = sizeof(*info);
     return STATUS_SUCCESS;
@@ -4743,7 +5607,7 @@ static NTSTATUS get_working_set_ex( HANDLE process, LPCVOID addr,
         if (vmentries == NULL)
             WARN( "couldn't get process vmmap, errno %d\n", errno );
 
-        server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+        virtual_lock( &sigset );
         for (p = info; (UINT_PTR)(p + 1) <= (UINT_PTR)info + len; p++)
         {
              int i;
@@ -4769,7 +5633,7 @@ static NTSTATUS get_working_set_ex( HANDLE process, LPCVOID addr,
                      p->VirtualAttributes.Win32Protection = get_win32_prot( vprot, view->protect );
              }
         }
-        server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+        virtual_unlock( &sigset );
 
         if (vmentries)
             procstat_freevmmap( pstat, vmentries );
@@ -4786,7 +5650,7 @@ static NTSTATUS get_working_set_ex( HANDLE process, LPCVOID addr,
         if (!once++) WARN( "unable to open /proc/self/pagemap\n" );
     }
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     for (p = info; (UINT_PTR)(p + 1) <= (UINT_PTR)info + len; p++)
     {
         BYTE vprot;
@@ -4814,7 +5678,7 @@ static NTSTATUS get_working_set_ex( HANDLE process, LPCVOID addr,
                 p->VirtualAttributes.Win32Protection = get_win32_prot( vprot, view->protect );
         }
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
 #endif
 
     if (f)
@@ -5165,7 +6029,7 @@ static NTSTATUS unmap_view_of_section( HANDLE process, PVOID addr, ULONG flags )
         return status;
     }
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     if ((view = find_view( addr, 0 )) && !is_view_valloc( view ))
     {
         if (flags & MEM_PRESERVE_PLACEHOLDER && !(view->protect & VPROT_FROMPLACEHOLDER))
@@ -5184,7 +6048,7 @@ static NTSTATUS unmap_view_of_section( HANDLE process, PVOID addr, ULONG flags )
                 {
                     TRACE( "not freeing in-use builtin %p\n", view->base );
                     builtin->refcount--;
-                    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+                    virtual_unlock( &sigset );
                     return STATUS_SUCCESS;
                 }
             }
@@ -5212,7 +6076,7 @@ static NTSTATUS unmap_view_of_section( HANDLE process, PVOID addr, ULONG flags )
         else FIXME( "failed to unmap %p %x\n", view->base, status );
     }
 done:
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     return status;
 }
 
@@ -5356,7 +6220,7 @@ NTSTATUS WINAPI NtFlushVirtualMemory( HANDLE process, LPCVOID *addr_ptr,
         return result.virtual_flush.status;
     }
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
     if (!(view = find_view( addr, *size_ptr ))) status = STATUS_INVALID_PARAMETER;
     else
     {
@@ -5366,7 +6230,7 @@ NTSTATUS WINAPI NtFlushVirtualMemory( HANDLE process, LPCVOID *addr_ptr,
         if (msync( addr, *size_ptr, MS_ASYNC )) status = STATUS_NOT_MAPPED_DATA;
 #endif
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     return status;
 }
 
@@ -5393,7 +6257,7 @@ NTSTATUS WINAPI NtGetWriteWatch( HANDLE process, ULONG flags, PVOID base, SIZE_T
     TRACE( "%p %x %p-%p %p %lu\n", process, flags, base, (char *)base + size,
            addresses, *count );
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
 
     if (is_write_watch_range( base, size ))
     {
@@ -5485,7 +6349,7 @@ NTSTATUS WINAPI NtGetWriteWatch( HANDLE process, ULONG flags, PVOID base, SIZE_T
     else status = STATUS_INVALID_PARAMETER;
 
 done:
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     return status;
 }
 
@@ -5506,14 +6370,14 @@ NTSTATUS WINAPI NtResetWriteWatch( HANDLE process, PVOID base, SIZE_T size )
 
     if (!size) return STATUS_INVALID_PARAMETER;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
 
     if (is_write_watch_range( base, size ))
         reset_write_watches( base, size );
     else
         status = STATUS_INVALID_PARAMETER;
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     return status;
 }
 
@@ -5634,7 +6498,7 @@ NTSTATUS WINAPI NtAreMappedFilesTheSame(PVOID addr1, PVOID addr2)
 
     TRACE("%p %p\n", addr1, addr2);
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_lock( &sigset );
 
     view1 = find_view( addr1, 0 );
     view2 = find_view( addr2, 0 );
@@ -5658,7 +6522,7 @@ NTSTATUS WINAPI NtAreMappedFilesTheSame(PVOID addr1, PVOID addr2)
         SERVER_END_REQ;
     }
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    virtual_unlock( &sigset );
     return status;
 }
 
@@ -38,6 +38,10 @@ static unsigned char (__cdecl *p__wine_dbg_get_channel_flags)( struct __wine_deb
 static int (__cdecl *p__wine_dbg_header)( enum __wine_debug_class cls,
                                           struct __wine_debug_channel *channel,
                                           const char *function );
+static int (__wine_dbg_cdecl *p__wine_dbg_vlog)( enum __wine_debug_class cls,
+                                                 struct __wine_debug_channel *channel,
+                                                 const char *function, const char *format,
+                                                 __wine_dbg_va_list args );
 
 static const char * const debug_classes[] = { "fixme", "err", "warn", "trace" };
 
@@ -213,6 +217,14 @@ static int __cdecl fallback__wine_dbg_header( enum __wine_debug_class cls,
     return fwrite( buffer, 1, strlen(buffer), stderr );
 }
 
+static int __wine_dbg_cdecl fallback__wine_dbg_vlog( enum __wine_debug_class cls,
+                                                     struct __wine_debug_channel *channel,
+                                                     const char *function, const char *format,
+                                                     __wine_dbg_va_list args )
+{
+    return -2;  /* no binary trace records, formatted by the caller */
+}
+
 static unsigned char __cdecl fallback__wine_dbg_get_channel_flags( struct __wine_debug_channel *channel )
 {
     int min, max, pos, res;
@@ -259,4 +271,11 @@ int __cdecl __wine_dbg_header( enum __wine_debug_class cls, struct __wine_debug_
     return p__wine_dbg_header( cls, channel, function );
 }
 
+int __wine_dbg_cdecl __wine_dbg_vlog( enum __wine_debug_class cls, struct __wine_debug_channel *channel,
+                                      const char *function, const char *format, __wine_dbg_va_list args )
+{
+    LOAD_FUNC( __wine_dbg_vlog );
+    return p__wine_dbg_vlog( cls, channel, function, format, args );
+}
+
 #endif  /* __WINE_PE_BUILD */
@@ -394,6 +394,73 @@ static const struct wined3d_allocator_ops wined3d_allocator_vk_ops =
     .allocator_destroy_chunk = wined3d_allocator_vk_destroy_chunk,
 };
 
+/* The pipeline cache is stored per adapter, keyed by the pipeline cache UUID
+ * reported by the driver. The driver validates the data itself, so a stale
+ * file is simply ignored. */
+static void wined3d_device_vk_init_pipeline_cache(struct wined3d_device_vk *device_vk,
+        const struct wined3d_adapter_vk *adapter_vk)
+{
+    const struct wined3d_vk_info *vk_info = &device_vk->vk_info;
+    VkPipelineCacheCreateInfo cache_info;
+    size_t size = 0;
+    uint64_t hash;
+    void *data;
+    VkResult vr;
+
+    hash = wined3d_hash64(adapter_vk->pipeline_cache_uuid, sizeof(adapter_vk->pipeline_cache_uuid),
+            0xcbf29ce484222325ull);
+    sprintf(device_vk->pipeline_cache_name, "vk-%08x%08x.bin", (unsigned int)(hash >> 32), (unsigned int)hash);
+    data = wined3d_shader_cache_load(device_vk->pipeline_cache_name, &size);
+
+    cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cache_info.pNext = NULL;
+    cache_info.flags = 0;
+    cache_info.initialDataSize = size;
+    cache_info.pInitialData = data;
+    if ((vr = VK_CALL(vkCreatePipelineCache(device_vk->vk_device, &cache_info, NULL,
+            &device_vk->vk_pipeline_cache))) < 0 && data)
+    {
+        WARN("Failed to create pipeline cache from %s, vr %s.\n",
+                debugstr_a(device_vk->pipeline_cache_name), wined3d_debug_vkresult(vr));
+        cache_info.initialDataSize = 0;
+        cache_info.pInitialData = NULL;
+        vr = VK_CALL(vkCreatePipelineCache(device_vk->vk_device, &cache_info, NULL, &device_vk->vk_pipeline_cache));
+    }
+    if (vr < 0)
+    {
+        WARN("Failed to create pipeline cache, vr %s.\n", wined3d_debug_vkresult(vr));
+        device_vk->vk_pipeline_cache = VK_NULL_HANDLE;
+    }
+    else
+    {
+        TRACE("Loaded %zu bytes of pipeline cache data.\n", size);
+    }
+    heap_free(data);
+}
+
+static void wined3d_device_vk_cleanup_pipeline_cache(struct wined3d_device_vk *device_vk)
+{
+    const struct wined3d_vk_info *vk_info = &device_vk->vk_info;
+    size_t size;
+    void *data;
+
+    if (!device_vk->vk_pipeline_cache)
+        return;
+
+    if (wined3d_settings.shader_cache_path
+            && VK_CALL(vkGetPipelineCacheData(device_vk->vk_device, device_vk->vk_pipeline_cache,
+            &size, NULL)) == VK_SUCCESS && size && (data = heap_alloc(size)))
+    {
+        if (VK_CALL(vkGetPipelineCacheData(device_vk->vk_device, device_vk->vk_pipeline_cache,
+                &size, data)) == VK_SUCCESS)
+            wined3d_shader_cache_store(device_vk->pipeline_cache_name, data, size, NULL, 0);
+        heap_free(data);
+    }
+
+    VK_CALL(vkDestroyPipelineCache(device_vk->vk_device, device_vk->vk_pipeline_cache, NULL));
+    device_vk->vk_pipeline_cache = VK_NULL_HANDLE;
+}
+
 static HRESULT adapter_vk_create_device(struct wined3d *wined3d, const struct wined3d_adapter *adapter,
         enum wined3d_device_type device_type, HWND focus_window, unsigned int flags, BYTE surface_alignment,
         const enum wined3d_feature_level *levels, unsigned int level_count,
@@ -510,11 +577,14 @@ static HRESULT adapter_vk_create_device(struct wined3d *wined3d, const struct wi
         goto fail;
     }
 
+    wined3d_device_vk_init_pipeline_cache(device_vk, adapter_vk);
+
     if (FAILED(hr = wined3d_device_init(&device_vk->d, wined3d, adapter->ordinal, device_type, focus_window,
             flags, surface_alignment, levels, level_count, vk_info->supported, device_parent)))
     {
         WARN("Failed to initialize device, hr %#x.\n", hr);
         wined3d_allocator_cleanup(&device_vk->allocator);
+        wined3d_device_vk_cleanup_pipeline_cache(device_vk);
         goto fail;
     }
 
@@ -544,6 +614,7 @@ static void adapter_vk_destroy_device(struct wined3d_device *device)
         device_vk->allocator_cs.DebugInfo->Spare[0] = 0;
     DeleteCriticalSection(&device_vk->allocator_cs);
 
+    wined3d_device_vk_cleanup_pipeline_cache(device_vk);
     VK_CALL(vkDestroyDevice(device_vk->vk_device, NULL));
     heap_free(device_vk);
 }
@@ -1175,8 +1246,7 @@ void adapter_vk_copy_bo_address(struct wined3d_context *context,
     if (dst_bo && (!(dst_bo->memory_type & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) || (!(map_flags & WINED3D_MAP_DISCARD)
             && dst_bo->command_buffer_id > context_vk->completed_command_buffer_id)))
     {
-        if (!(wined3d_context_vk_create_bo(context_vk, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &staging_bo)))
+        if (!(wined3d_context_vk_create_upload_bo(context_vk, size, 16, &staging_bo)))
         {
             ERR("Failed to create staging bo.\n");
             return;
@@ -1187,7 +1257,7 @@ void adapter_vk_copy_bo_address(struct wined3d_context *context,
         adapter_vk_copy_bo_address(context, &staging, src, size);
         adapter_vk_copy_bo_address(context, dst, &staging, size);
 
-        wined3d_context_vk_destroy_bo(context_vk, &staging_bo);
+        wined3d_context_vk_destroy_upload_bo(context_vk, &staging_bo);
 
         return;
     }
@@ -1473,6 +1543,7 @@ static void wined3d_view_vk_destroy_object(void *object)
         }
         else
         {
+            wined3d_context_vk_invalidate_descriptor_sets(&device_vk->context_vk, (uint64_t)*ctx->vk_buffer_view);
             VK_CALL(vkDestroyBufferView(device_vk->vk_device, *ctx->vk_buffer_view, NULL));
             TRACE("Destroyed buffer view 0x%s.\n", wine_dbgstr_longlong(*ctx->vk_buffer_view));
         }
@@ -1486,6 +1557,7 @@ static void wined3d_view_vk_destroy_object(void *object)
         }
         else
         {
+            wined3d_context_vk_invalidate_descriptor_sets(&device_vk->context_vk, (uint64_t)*ctx->vk_image_view);
             VK_CALL(vkDestroyImageView(device_vk->vk_device, *ctx->vk_image_view, NULL));
             TRACE("Destroyed image view 0x%s.\n", wine_dbgstr_longlong(*ctx->vk_image_view));
         }
@@ -1503,6 +1575,7 @@ static void wined3d_view_vk_destroy_object(void *object)
         }
         else
         {
+            wined3d_context_vk_invalidate_descriptor_sets(&device_vk->context_vk, (uint64_t)*ctx->vk_counter_view);
             VK_CALL(vkDestroyBufferView(device_vk->vk_device, *ctx->vk_counter_view, NULL));
             TRACE("Destroyed counter buffer view 0x%s.\n", wine_dbgstr_longlong(*ctx->vk_counter_view));
         }
@@ -1746,8 +1819,10 @@ static void adapter_vk_draw_primitive(struct wined3d_device *device,
     const struct wined3d_vk_info *vk_info;
     struct wined3d_context_vk *context_vk;
     VkCommandBuffer vk_command_buffer;
+    LARGE_INTEGER start, end;
     uint32_t instance_count;
     unsigned int i;
+    bool profile;
 
     TRACE("device %p, state %p, parameters %p.\n", device, state, parameters);
 
@@ -1757,13 +1832,22 @@ static void adapter_vk_draw_primitive(struct wined3d_device *device,
     if (parameters->indirect)
         indirect_vk = wined3d_buffer_vk(parameters->u.indirect.buffer);
 
+    if ((profile = TRACE_ON(d3d_perf)))
+        QueryPerformanceCounter(&start);
     if (!(vk_command_buffer = wined3d_context_vk_apply_draw_state(context_vk,
             state, indirect_vk, parameters->indexed)))
     {
-        ERR("Failed to apply draw state.\n");
+        if (!context_vk->graphics_pipeline_pending)
+            ERR("Failed to apply draw state.\n");
         context_release(&context_vk->c);
         return;
     }
+    if (profile)
+    {
+        QueryPerformanceCounter(&end);
+        ++context_vk->pipeline_stats.draws;
+        context_vk->pipeline_stats.draw_state_time += end.QuadPart - start.QuadPart;
+    }
 
     if (context_vk->c.transform_feedback_active)
     {
@@ -2475,6 +2559,8 @@ static BOOL wined3d_adapter_vk_init(struct wined3d_adapter_vk *adapter_vk,
     else
         VK_CALL(vkGetPhysicalDeviceProperties(adapter_vk->physical_device, &properties2.properties));
     adapter_vk->device_limits = properties2.properties.limits;
+    memcpy(adapter_vk->pipeline_cache_uuid, properties2.properties.pipelineCacheUUID,
+            sizeof(adapter_vk->pipeline_cache_uuid));
 
     VK_CALL(vkGetPhysicalDeviceMemoryProperties(adapter_vk->physical_device, &adapter_vk->memory_properties));
 
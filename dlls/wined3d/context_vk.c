@@ -27,6 +27,7 @@
 #include "wined3d_private.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(d3d);
+WINE_DECLARE_DEBUG_CHANNEL(d3d_perf);
 
 VkCompareOp vk_compare_op_from_wined3d(enum wined3d_cmp_func op)
 {
@@ -550,6 +551,139 @@ BOOL wined3d_context_vk_create_bo(struct wined3d_context_vk *context_vk, VkDevic
     return TRUE;
 }
 
+static bool wined3d_context_vk_init_upload_ring(struct wined3d_context_vk *context_vk)
+{
+    struct wined3d_upload_ring_vk *ring = &context_vk->upload_ring;
+    struct wined3d_bo_address addr;
+
+    if (ring->bo.vk_buffer)
+        return true;
+    if (ring->disabled)
+        return false;
+
+    if (!wined3d_context_vk_create_bo(context_vk, WINED3D_UPLOAD_RING_SIZE_VK,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &ring->bo))
+    {
+        WARN("Failed to create upload ring bo.\n");
+        ring->disabled = true;
+        return false;
+    }
+
+    addr.buffer_object = &ring->bo.b;
+    addr.addr = NULL;
+    if (!wined3d_context_map_bo_address(&context_vk->c, &addr, ring->bo.size,
+            WINED3D_MAP_WRITE | WINED3D_MAP_NOOVERWRITE))
+    {
+        ERR("Failed to map upload ring bo.\n");
+        wined3d_context_vk_destroy_bo(context_vk, &ring->bo);
+        ring->bo.vk_buffer = VK_NULL_HANDLE;
+        ring->disabled = true;
+        return false;
+    }
+
+    TRACE("Created upload ring with buffer 0x%s.\n", wine_dbgstr_longlong(ring->bo.vk_buffer));
+
+    return true;
+}
+
+static bool wined3d_upload_ring_vk_alloc(struct wined3d_upload_ring_vk *ring,
+        const struct wined3d_context_vk *context_vk, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize *offset)
+{
+    uint64_t command_buffer_id = context_vk->current_command_buffer.id;
+    struct wined3d_upload_ring_fence_vk *fence;
+    VkDeviceSize start;
+    SIZE_T i;
+
+    for (i = 0; i < ring->fence_count; ++i)
+    {
+        if (ring->fences[i].command_buffer_id > context_vk->completed_command_buffer_id)
+            break;
+        ring->tail = ring->fences[i].end;
+    }
+    if (i)
+    {
+        ring->fence_count -= i;
+        memmove(ring->fences, &ring->fences[i], ring->fence_count * sizeof(*ring->fences));
+    }
+    if (!ring->fence_count)
+        ring->head = ring->tail = 0;
+
+    /* If the ring is not empty, "head == tail" means it is full. */
+    start = (ring->head + alignment - 1) / alignment * alignment;
+    if (!ring->fence_count || ring->head > ring->tail)
+    {
+        if (start + size > ring->bo.size)
+        {
+            if (size > ring->tail)
+                return false;
+            start = 0;
+        }
+    }
+    else if (ring->head == ring->tail || start + size > ring->tail)
+    {
+        return false;
+    }
+
+    if (ring->fence_count && ring->fences[ring->fence_count - 1].command_buffer_id == command_buffer_id)
+    {
+        fence = &ring->fences[ring->fence_count - 1];
+    }
+    else
+    {
+        if (!wined3d_array_reserve((void **)&ring->fences, &ring->fences_size,
+                ring->fence_count + 1, sizeof(*ring->fences)))
+            return false;
+        fence = &ring->fences[ring->fence_count++];
+        fence->command_buffer_id = command_buffer_id;
+    }
+
+    ring->head = fence->end = start + size;
+    *offset = start;
+
+    return true;
+}
+
+/* Creates a host-visible bo for uploading data to the GPU. The bo is only
+ * valid for use in the current command buffer. */
+BOOL wined3d_context_vk_create_upload_bo(struct wined3d_context_vk *context_vk, VkDeviceSize size,
+        VkDeviceSize alignment, struct wined3d_bo_vk *bo)
+{
+    struct wined3d_upload_ring_vk *ring = &context_vk->upload_ring;
+    VkDeviceSize offset;
+
+    if (wined3d_map_persistent() && size <= WINED3D_UPLOAD_RING_SIZE_VK / 2
+            && wined3d_context_vk_init_upload_ring(context_vk)
+            && wined3d_upload_ring_vk_alloc(ring, context_vk, size, alignment, &offset))
+    {
+        *bo = ring->bo;
+        bo->memory = NULL;
+        bo->b.buffer_offset += offset;
+        bo->b.memory_offset += offset;
+        bo->size = size;
+        list_init(&bo->b.users);
+        bo->command_buffer_id = 0;
+
+        ++ring->allocation_count;
+        ring->allocated_size += size;
+
+        TRACE("Using upload ring offset 0x%s for bo %p.\n", wine_dbgstr_longlong(offset), bo);
+        return TRUE;
+    }
+
+    ++ring->fallback_count;
+    return wined3d_context_vk_create_bo(context_vk, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, bo);
+}
+
+void wined3d_context_vk_destroy_upload_bo(struct wined3d_context_vk *context_vk, struct wined3d_bo_vk *bo)
+{
+    /* Upload ring space is reclaimed once the command buffer completes. */
+    if (bo->vk_buffer == context_vk->upload_ring.bo.vk_buffer)
+        return;
+
+    wined3d_context_vk_destroy_bo(context_vk, bo);
+}
+
 BOOL wined3d_context_vk_create_image(struct wined3d_context_vk *context_vk, VkImageType vk_image_type,
         VkImageUsageFlags usage, VkFormat vk_format, unsigned int width, unsigned int height, unsigned int depth,
         unsigned int sample_count, unsigned int mip_levels, unsigned int layer_count, unsigned int flags,
@@ -677,6 +811,46 @@ void wined3d_context_vk_destroy_vk_framebuffer(struct wined3d_context_vk *contex
     o->command_buffer_id = command_buffer_id;
 }
 
+/* Cached descriptor sets may reference any buffer, view or sampler; once one
+ * of those is destroyed its handle may be reused by a new object, so the
+ * sets that reference it are dropped. The key is compared as a whole, so a
+ * matching offset or range may drop a set that didn't need to be. */
+void wined3d_context_vk_invalidate_descriptor_sets(struct wined3d_context_vk *context_vk, uint64_t handle)
+{
+    struct wined3d_descriptor_set_cache_vk *cache = &context_vk->descriptor_sets;
+    struct wined3d_descriptor_set_cache_entry_vk *entry;
+    SIZE_T i, j;
+
+    for (i = 0; i < ARRAY_SIZE(cache->entries); ++i)
+    {
+        entry = &cache->entries[i];
+        if (!entry->vk_descriptor_set)
+            continue;
+        /* The first key value is the set layout. */
+        for (j = 1; j < entry->key_count; ++j)
+        {
+            if (entry->key[j] == handle)
+            {
+                entry->vk_descriptor_set = VK_NULL_HANDLE;
+                break;
+            }
+        }
+    }
+}
+
+static void wined3d_context_vk_invalidate_descriptor_pool(struct wined3d_context_vk *context_vk,
+        VkDescriptorPool vk_descriptor_pool)
+{
+    struct wined3d_descriptor_set_cache_vk *cache = &context_vk->descriptor_sets;
+    SIZE_T i;
+
+    for (i = 0; i < ARRAY_SIZE(cache->entries); ++i)
+    {
+        if (cache->entries[i].vk_descriptor_pool == vk_descriptor_pool)
+            cache->entries[i].vk_descriptor_set = VK_NULL_HANDLE;
+    }
+}
+
 static void wined3d_context_vk_destroy_vk_descriptor_pool(struct wined3d_context_vk *context_vk,
         VkDescriptorPool vk_descriptor_pool, uint64_t command_buffer_id)
 {
@@ -684,6 +858,8 @@ static void wined3d_context_vk_destroy_vk_descriptor_pool(struct wined3d_context
     const struct wined3d_vk_info *vk_info = context_vk->vk_info;
     struct wined3d_retired_object_vk *o;
 
+    wined3d_context_vk_invalidate_descriptor_pool(context_vk, vk_descriptor_pool);
+
     if (context_vk->completed_command_buffer_id > command_buffer_id)
     {
         VK_CALL(vkDestroyDescriptorPool(device_vk->vk_device, vk_descriptor_pool, NULL));
@@ -812,6 +988,8 @@ static void wined3d_context_vk_destroy_vk_buffer(struct wined3d_context_vk *cont
     const struct wined3d_vk_info *vk_info = context_vk->vk_info;
     struct wined3d_retired_object_vk *o;
 
+    wined3d_context_vk_invalidate_descriptor_sets(context_vk, (uint64_t)vk_buffer);
+
     if (context_vk->completed_command_buffer_id > command_buffer_id)
     {
         VK_CALL(vkDestroyBuffer(device_vk->vk_device, vk_buffer, NULL));
@@ -862,6 +1040,8 @@ void wined3d_context_vk_destroy_vk_buffer_view(struct wined3d_context_vk *contex
     const struct wined3d_vk_info *vk_info = context_vk->vk_info;
     struct wined3d_retired_object_vk *o;
 
+    wined3d_context_vk_invalidate_descriptor_sets(context_vk, (uint64_t)vk_view);
+
     if (context_vk->completed_command_buffer_id > command_buffer_id)
     {
         VK_CALL(vkDestroyBufferView(device_vk->vk_device, vk_view, NULL));
@@ -887,6 +1067,8 @@ void wined3d_context_vk_destroy_vk_image_view(struct wined3d_context_vk *context
     const struct wined3d_vk_info *vk_info = context_vk->vk_info;
     struct wined3d_retired_object_vk *o;
 
+    wined3d_context_vk_invalidate_descriptor_sets(context_vk, (uint64_t)vk_view);
+
     if (context_vk->completed_command_buffer_id > command_buffer_id)
     {
         VK_CALL(vkDestroyImageView(device_vk->vk_device, vk_view, NULL));
@@ -912,6 +1094,8 @@ void wined3d_context_vk_destroy_vk_sampler(struct wined3d_context_vk *context_vk
     const struct wined3d_vk_info *vk_info = context_vk->vk_info;
     struct wined3d_retired_object_vk *o;
 
+    wined3d_context_vk_invalidate_descriptor_sets(context_vk, (uint64_t)vk_sampler);
+
     if (context_vk->completed_command_buffer_id > command_buffer_id)
     {
         VK_CALL(vkDestroySampler(device_vk->vk_device, vk_sampler, NULL));
@@ -1115,19 +1299,22 @@ static void wined3d_context_vk_destroy_bo_slab(struct wine_rb_entry *entry, void
     }
 }
 
-static void wined3d_context_vk_destroy_graphics_pipeline(struct wine_rb_entry *entry, void *ctx)
+static void wined3d_context_vk_destroy_graphics_pipelines(struct wined3d_context_vk *context_vk)
 {
-    struct wined3d_graphics_pipeline_vk *pipeline_vk = WINE_RB_ENTRY_VALUE(entry,
-            struct wined3d_graphics_pipeline_vk, entry);
-    struct wined3d_context_vk *context_vk = ctx;
-    const struct wined3d_vk_info *vk_info;
-    struct wined3d_device_vk *device_vk;
-
-    vk_info = context_vk->vk_info;
-    device_vk = wined3d_device_vk(context_vk->c.device);
+    struct wined3d_graphics_pipeline_table_vk *table = &context_vk->graphics_pipelines;
+    struct wined3d_device_vk *device_vk = wined3d_device_vk(context_vk->c.device);
+    const struct wined3d_vk_info *vk_info = context_vk->vk_info;
+    struct wined3d_graphics_pipeline_vk *pipeline_vk;
+    size_t i;
 
-    VK_CALL(vkDestroyPipeline(device_vk->vk_device, pipeline_vk->vk_pipeline, NULL));
-    heap_free(pipeline_vk);
+    for (i = 0; i < table->size; ++i)
+    {
+        if (!(pipeline_vk = table->entries[i]))
+            continue;
+        VK_CALL(vkDestroyPipeline(device_vk->vk_device, pipeline_vk->vk_pipeline, NULL));
+        heap_free(pipeline_vk);
+    }
+    heap_free(table->entries);
 }
 
 static void wined3d_context_vk_destroy_pipeline_layout(struct wine_rb_entry *entry, void *ctx)
@@ -1394,6 +1581,16 @@ static void wined3d_shader_descriptor_writes_vk_cleanup(struct wined3d_shader_de
     heap_free(writes->writes);
 }
 
+static void wined3d_descriptor_set_cache_vk_cleanup(struct wined3d_descriptor_set_cache_vk *cache)
+{
+    size_t i;
+
+    for (i = 0; i < ARRAY_SIZE(cache->entries); ++i)
+        heap_free(cache->entries[i].key);
+    heap_free(cache->key);
+    memset(cache, 0, sizeof(*cache));
+}
+
 static void wined3d_context_vk_destroy_query_pools(struct wined3d_context_vk *context_vk, struct list *free_pools)
 {
     struct wined3d_query_pool_vk *pool_vk, *entry;
@@ -1487,6 +1684,11 @@ void wined3d_context_vk_cleanup(struct wined3d_context_vk *context_vk)
     struct wined3d_device_vk *device_vk = wined3d_device_vk(context_vk->c.device);
     const struct wined3d_vk_info *vk_info = context_vk->vk_info;
 
+    wined3d_context_vk_wait_pipeline_compiles(context_vk);
+    if (context_vk->pipeline_compile_cs.DebugInfo != (RTL_CRITICAL_SECTION_DEBUG *)-1)
+        context_vk->pipeline_compile_cs.DebugInfo->Spare[0] = 0;
+    DeleteCriticalSection(&context_vk->pipeline_compile_cs);
+
     if (buffer->vk_command_buffer)
     {
         VK_CALL(vkFreeCommandBuffers(device_vk->vk_device,
@@ -1506,6 +1708,9 @@ void wined3d_context_vk_cleanup(struct wined3d_context_vk *context_vk)
     VK_CALL(vkDestroyCommandPool(device_vk->vk_device, context_vk->vk_command_pool, NULL));
     if (context_vk->vk_so_counter_bo.vk_buffer)
         wined3d_context_vk_destroy_bo(context_vk, &context_vk->vk_so_counter_bo);
+    if (context_vk->upload_ring.bo.vk_buffer)
+        wined3d_context_vk_destroy_bo(context_vk, &context_vk->upload_ring.bo);
+    heap_free(context_vk->upload_ring.fences);
     wined3d_context_vk_cleanup_resources(context_vk);
     wined3d_context_vk_destroy_query_pools(context_vk, &context_vk->free_occlusion_query_pools);
     wined3d_context_vk_destroy_query_pools(context_vk, &context_vk->free_timestamp_query_pools);
@@ -1517,7 +1722,8 @@ void wined3d_context_vk_cleanup(struct wined3d_context_vk *context_vk)
     heap_free(context_vk->retired.objects);
 
     wined3d_shader_descriptor_writes_vk_cleanup(&context_vk->descriptor_writes);
-    wine_rb_destroy(&context_vk->graphics_pipelines, wined3d_context_vk_destroy_graphics_pipeline, context_vk);
+    wined3d_descriptor_set_cache_vk_cleanup(&context_vk->descriptor_sets);
+    wined3d_context_vk_destroy_graphics_pipelines(context_vk);
     wine_rb_destroy(&context_vk->pipeline_layouts, wined3d_context_vk_destroy_pipeline_layout, context_vk);
     wine_rb_destroy(&context_vk->render_passes, wined3d_context_vk_destroy_render_pass, context_vk);
 
@@ -1803,11 +2009,9 @@ static int wined3d_pipeline_layout_vk_compare(const void *key, const struct wine
     return memcmp(a->bindings, b->bindings, a->binding_count * sizeof(*a->bindings));
 }
 
-static int wined3d_graphics_pipeline_vk_compare(const void *key, const struct wine_rb_entry *entry)
+static int wined3d_graphics_pipeline_key_vk_compare(const struct wined3d_graphics_pipeline_key_vk *a,
+        const struct wined3d_graphics_pipeline_key_vk *b)
 {
-    const struct wined3d_graphics_pipeline_key_vk *a = key;
-    const struct wined3d_graphics_pipeline_key_vk *b = &WINE_RB_ENTRY_VALUE(entry,
-            const struct wined3d_graphics_pipeline_vk, entry)->key;
     unsigned int i;
     int ret;
 
@@ -1878,6 +2082,115 @@ static int wined3d_graphics_pipeline_vk_compare(const void *key, const struct wi
     return 0;
 }
 
+static uint64_t wined3d_hash_uint32(const void *data, size_t size, uint64_t hash)
+{
+    const uint32_t *ptr = data;
+    size_t i;
+
+    for (i = 0; i < size / sizeof(*ptr); ++i)
+        hash = (hash ^ ptr[i]) * 0x100000001b3ull;
+    return hash;
+}
+
+/* Covers the same fields as wined3d_graphics_pipeline_key_vk_compare(). */
+static uint64_t wined3d_graphics_pipeline_key_vk_hash(const struct wined3d_graphics_pipeline_key_vk *key)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    unsigned int i;
+
+    for (i = 0; i < key->pipeline_desc.stageCount; ++i)
+        hash = wined3d_hash_uint32(&key->stages[i].module, sizeof(key->stages[i].module), hash);
+
+    hash = wined3d_hash_uint32(key->divisors, key->divisor_desc.vertexBindingDivisorCount * sizeof(*key->divisors),
+            hash);
+    hash = wined3d_hash_uint32(key->attributes,
+            key->input_desc.vertexAttributeDescriptionCount * sizeof(*key->attributes), hash);
+    hash = wined3d_hash_uint32(key->bindings, key->input_desc.vertexBindingDescriptionCount * sizeof(*key->bindings),
+            hash);
+    hash = (hash ^ key->ia_desc.topology) * 0x100000001b3ull;
+    hash = (hash ^ key->ia_desc.primitiveRestartEnable) * 0x100000001b3ull;
+    hash = (hash ^ key->ts_desc.patchControlPoints) * 0x100000001b3ull;
+    hash = wined3d_hash_uint32(&key->viewport, sizeof(key->viewport), hash);
+    hash = wined3d_hash_uint32(&key->scissor, sizeof(key->scissor), hash);
+    hash = wined3d_hash_uint32(&key->rs_desc, sizeof(key->rs_desc), hash);
+    hash = (hash ^ key->ms_desc.rasterizationSamples) * 0x100000001b3ull;
+    hash = (hash ^ key->ms_desc.alphaToCoverageEnable) * 0x100000001b3ull;
+    hash = (hash ^ key->sample_mask) * 0x100000001b3ull;
+    hash = wined3d_hash_uint32(&key->ds_desc, sizeof(key->ds_desc), hash);
+    hash = wined3d_hash_uint32(key->blend_attachments,
+            key->blend_desc.attachmentCount * sizeof(*key->blend_attachments), hash);
+    hash = wined3d_hash_uint32(&key->pipeline_desc.layout, sizeof(key->pipeline_desc.layout), hash);
+    hash = wined3d_hash_uint32(&key->pipeline_desc.renderPass, sizeof(key->pipeline_desc.renderPass), hash);
+
+    /* Mix the high bits into the low bits used for the table index. */
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    return hash ^ (hash >> 33);
+}
+
+static struct wined3d_graphics_pipeline_vk *wined3d_context_vk_find_graphics_pipeline(
+        const struct wined3d_context_vk *context_vk, const struct wined3d_graphics_pipeline_key_vk *key)
+{
+    const struct wined3d_graphics_pipeline_table_vk *table = &context_vk->graphics_pipelines;
+    struct wined3d_graphics_pipeline_vk *pipeline_vk;
+    size_t i;
+
+    if (!table->size)
+        return NULL;
+
+    for (i = key->hash & (table->size - 1); (pipeline_vk = table->entries[i]); i = (i + 1) & (table->size - 1))
+    {
+        if (pipeline_vk->key.hash == key->hash && !wined3d_graphics_pipeline_key_vk_compare(&pipeline_vk->key, key))
+            return pipeline_vk;
+    }
+
+    return NULL;
+}
+
+static void wined3d_graphics_pipeline_table_vk_insert(struct wined3d_graphics_pipeline_vk **entries,
+        size_t size, struct wined3d_graphics_pipeline_vk *pipeline_vk)
+{
+    size_t i;
+
+    for (i = pipeline_vk->key.hash & (size - 1); entries[i]; i = (i + 1) & (size - 1));
+    entries[i] = pipeline_vk;
+}
+
+/* Makes sure that one more pipeline can be added without exceeding a load
+ * factor of 3/4. */
+static bool wined3d_context_vk_reserve_graphics_pipeline(struct wined3d_context_vk *context_vk)
+{
+    struct wined3d_graphics_pipeline_table_vk *table = &context_vk->graphics_pipelines;
+    struct wined3d_graphics_pipeline_vk **entries;
+    size_t i, size;
+
+    if ((table->count + 1) * 4 <= table->size * 3)
+        return true;
+
+    size = table->size ? table->size * 2 : 64;
+    if (!(entries = heap_calloc(size, sizeof(*entries))))
+        return false;
+    for (i = 0; i < table->size; ++i)
+    {
+        if (table->entries[i])
+            wined3d_graphics_pipeline_table_vk_insert(entries, size, table->entries[i]);
+    }
+    heap_free(table->entries);
+    table->entries = entries;
+    table->size = size;
+
+    return true;
+}
+
+static void wined3d_context_vk_add_graphics_pipeline(struct wined3d_context_vk *context_vk,
+        struct wined3d_graphics_pipeline_vk *pipeline_vk)
+{
+    struct wined3d_graphics_pipeline_table_vk *table = &context_vk->graphics_pipelines;
+
+    wined3d_graphics_pipeline_table_vk_insert(table->entries, table->size, pipeline_vk);
+    ++table->count;
+}
+
 static int wined3d_bo_slab_vk_compare(const void *key, const struct wine_rb_entry *entry)
 {
     const struct wined3d_bo_slab_vk *slab = WINE_RB_ENTRY_VALUE(entry, const struct wined3d_bo_slab_vk, entry);
@@ -1962,6 +2275,8 @@ static void wined3d_context_vk_init_graphics_pipeline_key(struct wined3d_context
     key->pipeline_desc.pColorBlendState = &key->blend_desc;
     key->pipeline_desc.pDynamicState = &key->dynamic_desc;
     key->pipeline_desc.basePipelineIndex = -1;
+
+    key->hash = wined3d_graphics_pipeline_key_vk_hash(key);
 }
 
 static void wined3d_context_vk_update_rasterisation_state(const struct wined3d_context_vk *context_vk,
@@ -2394,6 +2709,9 @@ static bool wined3d_context_vk_update_graphics_pipeline_key(struct wined3d_conte
         update = true;
     }
 
+    if (update)
+        key->hash = wined3d_graphics_pipeline_key_vk_hash(key);
+
     return update;
 }
 
@@ -2655,7 +2973,7 @@ VkResult wined3d_context_vk_create_vk_descriptor_set(struct wined3d_context_vk *
 }
 
 static bool wined3d_shader_descriptor_writes_vk_add_write(struct wined3d_shader_descriptor_writes_vk *writes,
-        VkDescriptorSet vk_descriptor_set, size_t binding_idx, VkDescriptorType type,
+        size_t binding_idx, VkDescriptorType type,
         const VkDescriptorBufferInfo *buffer_info, const VkDescriptorImageInfo *image_info,
         const VkBufferView *buffer_view)
 {
@@ -2669,7 +2987,7 @@ static bool wined3d_shader_descriptor_writes_vk_add_write(struct wined3d_shader_
     write = &writes->writes[write_count];
     write->sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     write->pNext = NULL;
-    write->dstSet = vk_descriptor_set;
+    write->dstSet = VK_NULL_HANDLE;
     write->dstBinding = binding_idx;
     write->dstArrayElement = 0;
     write->descriptorCount = 1;
@@ -2684,7 +3002,7 @@ static bool wined3d_shader_descriptor_writes_vk_add_write(struct wined3d_shader_
 }
 
 static bool wined3d_shader_resource_bindings_add_null_srv_binding(struct wined3d_shader_descriptor_writes_vk *writes,
-        VkDescriptorSet vk_descriptor_set, size_t binding_idx, enum wined3d_shader_resource_type type,
+        size_t binding_idx, enum wined3d_shader_resource_type type,
         enum wined3d_data_type data_type, struct wined3d_context_vk *context_vk)
 {
     const struct wined3d_null_views_vk *v = &wined3d_device_vk(context_vk->c.device)->null_views_vk;
@@ -2693,45 +3011,45 @@ static bool wined3d_shader_resource_bindings_add_null_srv_binding(struct wined3d
     {
         case WINED3D_SHADER_RESOURCE_BUFFER:
             if (data_type == WINED3D_DATA_FLOAT)
-                return wined3d_shader_descriptor_writes_vk_add_write(writes, vk_descriptor_set, binding_idx,
+                return wined3d_shader_descriptor_writes_vk_add_write(writes, binding_idx,
                         VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, NULL, NULL, &v->vk_view_buffer_float);
-            return wined3d_shader_descriptor_writes_vk_add_write(writes, vk_descriptor_set, binding_idx,
+            return wined3d_shader_descriptor_writes_vk_add_write(writes, binding_idx,
                     VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, NULL, NULL, &v->vk_view_buffer_uint);
 
         case WINED3D_SHADER_RESOURCE_TEXTURE_1D:
-            return wined3d_shader_descriptor_writes_vk_add_write(writes, vk_descriptor_set,
+            return wined3d_shader_descriptor_writes_vk_add_write(writes,
                     binding_idx, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, NULL, &v->vk_info_1d, NULL);
 
         case WINED3D_SHADER_RESOURCE_TEXTURE_2D:
-            return wined3d_shader_descriptor_writes_vk_add_write(writes, vk_descriptor_set,
+            return wined3d_shader_descriptor_writes_vk_add_write(writes,
                     binding_idx, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, NULL, &v->vk_info_2d, NULL);
 
         case WINED3D_SHADER_RESOURCE_TEXTURE_2DMS:
-            return wined3d_shader_descriptor_writes_vk_add_write(writes, vk_descriptor_set,
+            return wined3d_shader_descriptor_writes_vk_add_write(writes,
                     binding_idx, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, NULL, &v->vk_info_2dms, NULL);
 
         case WINED3D_SHADER_RESOURCE_TEXTURE_3D:
-            return wined3d_shader_descriptor_writes_vk_add_write(writes, vk_descriptor_set,
+            return wined3d_shader_descriptor_writes_vk_add_write(writes,
                     binding_idx, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, NULL, &v->vk_info_3d, NULL);
 
         case WINED3D_SHADER_RESOURCE_TEXTURE_CUBE:
-            return wined3d_shader_descriptor_writes_vk_add_write(writes, vk_descriptor_set,
+            return wined3d_shader_descriptor_writes_vk_add_write(writes,
                     binding_idx, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, NULL, &v->vk_info_cube, NULL);
 
         case WINED3D_SHADER_RESOURCE_TEXTURE_1DARRAY:
-            return wined3d_shader_descriptor_writes_vk_add_write(writes, vk_descriptor_set,
+            return wined3d_shader_descriptor_writes_vk_add_write(writes,
                     binding_idx, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, NULL, &v->vk_info_1d_array, NULL);
 
         case WINED3D_SHADER_RESOURCE_TEXTURE_2DARRAY:
-            return wined3d_shader_descriptor_writes_vk_add_write(writes, vk_descriptor_set,
+            return wined3d_shader_descriptor_writes_vk_add_write(writes,
                     binding_idx, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, NULL, &v->vk_info_2d_array, NULL);
 
         case WINED3D_SHADER_RESOURCE_TEXTURE_2DMSARRAY:
-            return wined3d_shader_descriptor_writes_vk_add_write(writes, vk_descriptor_set,
+            return wined3d_shader_descriptor_writes_vk_add_write(writes,
                     binding_idx, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, NULL, &v->vk_info_2dms_array, NULL);
 
         case WINED3D_SHADER_RESOURCE_TEXTURE_CUBEARRAY:
-            return wined3d_shader_descriptor_writes_vk_add_write(writes, vk_descriptor_set,
+            return wined3d_shader_descriptor_writes_vk_add_write(writes,
                     binding_idx, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, NULL, &v->vk_info_cube_array, NULL);
 
         default:
@@ -2741,7 +3059,7 @@ static bool wined3d_shader_resource_bindings_add_null_srv_binding(struct wined3d
 }
 
 static bool wined3d_shader_descriptor_writes_vk_add_cbv_write(struct wined3d_shader_descriptor_writes_vk *writes,
-        struct wined3d_context_vk *context_vk, VkDescriptorSet vk_descriptor_set, const struct wined3d_state *state,
+        struct wined3d_context_vk *context_vk, const struct wined3d_state *state,
         const struct wined3d_shader_resource_binding *binding, VkDescriptorBufferInfo *buffer_info)
 {
     const struct wined3d_constant_buffer_state *cb_state = &state->cb[binding->shader_type][binding->resource_idx];
@@ -2750,14 +3068,14 @@ static bool wined3d_shader_descriptor_writes_vk_add_cbv_write(struct wined3d_sha
     struct wined3d_buffer *buffer;
 
     if (!(buffer = cb_state->buffer))
-        return wined3d_shader_descriptor_writes_vk_add_write(writes, vk_descriptor_set, binding->binding_idx,
+        return wined3d_shader_descriptor_writes_vk_add_write(writes, binding->binding_idx,
                 VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, &device_vk->null_resources_vk.buffer_info, NULL, NULL);
 
     buffer_vk = wined3d_buffer_vk(buffer);
     *buffer_info = *wined3d_buffer_vk_get_buffer_info(buffer_vk);
     buffer_info->offset += cb_state->offset;
     buffer_info->range = min(cb_state->size, buffer_info->range);
-    if (!wined3d_shader_descriptor_writes_vk_add_write(writes, vk_descriptor_set,
+    if (!wined3d_shader_descriptor_writes_vk_add_write(writes,
             binding->binding_idx, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, buffer_info, NULL, NULL))
         return false;
     wined3d_context_vk_reference_bo(context_vk, wined3d_bo_vk(buffer->buffer_object));
@@ -2765,7 +3083,7 @@ static bool wined3d_shader_descriptor_writes_vk_add_cbv_write(struct wined3d_sha
 }
 
 static bool wined3d_shader_descriptor_writes_vk_add_srv_write(struct wined3d_shader_descriptor_writes_vk *writes,
-        struct wined3d_context_vk *context_vk, VkDescriptorSet vk_descriptor_set, const struct wined3d_state *state,
+        struct wined3d_context_vk *context_vk, const struct wined3d_state *state,
         const struct wined3d_shader_resource_binding *binding)
 {
     struct wined3d_shader_resource_view_vk *srv_vk;
@@ -2777,7 +3095,7 @@ static bool wined3d_shader_descriptor_writes_vk_add_srv_write(struct wined3d_sha
     VkDescriptorType type;
 
     if (!(srv = state->shader_resource_view[binding->shader_type][binding->resource_idx]))
-        return wined3d_shader_resource_bindings_add_null_srv_binding(writes, vk_descriptor_set,
+        return wined3d_shader_resource_bindings_add_null_srv_binding(writes,
                 binding->binding_idx, binding->resource_type, binding->resource_data_type, context_vk);
 
     resource = srv->resource;
@@ -2801,7 +3119,7 @@ static bool wined3d_shader_descriptor_writes_vk_add_srv_write(struct wined3d_sha
         type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
     }
 
-    if (!wined3d_shader_descriptor_writes_vk_add_write(writes, vk_descriptor_set,
+    if (!wined3d_shader_descriptor_writes_vk_add_write(writes,
             binding->binding_idx, type, NULL, image_info, buffer_view))
         return false;
     wined3d_context_vk_reference_shader_resource_view(context_vk, srv_vk);
@@ -2809,7 +3127,7 @@ static bool wined3d_shader_descriptor_writes_vk_add_srv_write(struct wined3d_sha
 }
 
 static bool wined3d_shader_descriptor_writes_vk_add_uav_write(struct wined3d_shader_descriptor_writes_vk *writes,
-        struct wined3d_context_vk *context_vk, enum wined3d_pipeline pipeline, VkDescriptorSet vk_descriptor_set,
+        struct wined3d_context_vk *context_vk, enum wined3d_pipeline pipeline,
         const struct wined3d_state *state, const struct wined3d_shader_resource_binding *binding)
 {
     struct wined3d_unordered_access_view_vk *uav_vk;
@@ -2847,7 +3165,7 @@ static bool wined3d_shader_descriptor_writes_vk_add_uav_write(struct wined3d_sha
         type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
     }
 
-    if (!wined3d_shader_descriptor_writes_vk_add_write(writes, vk_descriptor_set,
+    if (!wined3d_shader_descriptor_writes_vk_add_write(writes,
             binding->binding_idx, type, NULL, image_info, buffer_view))
         return false;
     wined3d_context_vk_reference_unordered_access_view(context_vk, uav_vk);
@@ -2856,8 +3174,8 @@ static bool wined3d_shader_descriptor_writes_vk_add_uav_write(struct wined3d_sha
 
 static bool wined3d_shader_descriptor_writes_vk_add_uav_counter_write(
         struct wined3d_shader_descriptor_writes_vk *writes, struct wined3d_context_vk *context_vk,
-        enum wined3d_pipeline pipeline, VkDescriptorSet vk_descriptor_set,
-        const struct wined3d_state *state, const struct wined3d_shader_resource_binding *binding)
+        enum wined3d_pipeline pipeline, const struct wined3d_state *state,
+        const struct wined3d_shader_resource_binding *binding)
 {
     struct wined3d_unordered_access_view_vk *uav_vk;
     struct wined3d_unordered_access_view *uav;
@@ -2872,25 +3190,106 @@ static bool wined3d_shader_descriptor_writes_vk_add_uav_counter_write(
     if (!uav_vk->vk_counter_view)
         return false;
 
-    return wined3d_shader_descriptor_writes_vk_add_write(writes, vk_descriptor_set, binding->binding_idx,
+    return wined3d_shader_descriptor_writes_vk_add_write(writes, binding->binding_idx,
             VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, NULL, NULL, &uav_vk->vk_counter_view);
 }
 
 static bool wined3d_shader_descriptor_writes_vk_add_sampler_write(struct wined3d_shader_descriptor_writes_vk *writes,
-        struct wined3d_context_vk *context_vk, VkDescriptorSet vk_descriptor_set, const struct wined3d_state *state,
+        struct wined3d_context_vk *context_vk, const struct wined3d_state *state,
         const struct wined3d_shader_resource_binding *binding)
 {
     struct wined3d_sampler *sampler;
 
     if (!(sampler = state->sampler[binding->shader_type][binding->resource_idx]))
         sampler = context_vk->c.device->null_sampler;
-    if (!wined3d_shader_descriptor_writes_vk_add_write(writes, vk_descriptor_set, binding->binding_idx,
+    if (!wined3d_shader_descriptor_writes_vk_add_write(writes, binding->binding_idx,
             VK_DESCRIPTOR_TYPE_SAMPLER, NULL, &wined3d_sampler_vk(sampler)->vk_image_info, NULL))
         return false;
     wined3d_context_vk_reference_sampler(context_vk, wined3d_sampler_vk(sampler));
     return true;
 }
 
+/* Descriptor sets are never modified once written, so a set written earlier
+ * for the same layout and descriptors can be bound again instead of
+ * allocating and writing a new one. The cache key is built from the pending
+ * descriptor writes, which have no destination set yet. */
+static VkDescriptorSet wined3d_context_vk_find_descriptor_set(struct wined3d_context_vk *context_vk,
+        VkDescriptorSetLayout vk_set_layout, uint64_t *hash)
+{
+    const struct wined3d_shader_descriptor_writes_vk *writes = &context_vk->descriptor_writes;
+    struct wined3d_descriptor_set_cache_vk *cache = &context_vk->descriptor_sets;
+    const struct wined3d_descriptor_set_cache_entry_vk *entry;
+    const VkWriteDescriptorSet *write;
+    uint64_t *key;
+    SIZE_T i;
+
+    *hash = 0;
+    if (!wined3d_array_reserve((void **)&cache->key, &cache->key_size,
+            1 + writes->count * 4, sizeof(*cache->key)))
+        return VK_NULL_HANDLE;
+
+    key = cache->key;
+    *key++ = (uint64_t)vk_set_layout;
+    for (i = 0; i < writes->count; ++i)
+    {
+        write = &writes->writes[i];
+        *key++ = (uint64_t)write->dstBinding << 32 | write->descriptorType;
+        if (write->pBufferInfo)
+        {
+            *key++ = (uint64_t)write->pBufferInfo->buffer;
+            *key++ = write->pBufferInfo->offset;
+            *key++ = write->pBufferInfo->range;
+        }
+        else if (write->pImageInfo)
+        {
+            *key++ = (uint64_t)write->pImageInfo->sampler;
+            *key++ = (uint64_t)write->pImageInfo->imageView;
+            *key++ = write->pImageInfo->imageLayout;
+        }
+        else
+        {
+            *key++ = (uint64_t)*write->pTexelBufferView;
+        }
+    }
+    cache->key_count = key - cache->key;
+
+    *hash = 0xcbf29ce484222325ull;
+    for (i = 0; i < cache->key_count; ++i)
+        *hash = (*hash ^ cache->key[i]) * 0x100000001b3ull;
+    *hash ^= *hash >> 33;
+
+    entry = &cache->entries[*hash & (ARRAY_SIZE(cache->entries) - 1)];
+    if (!entry->vk_descriptor_set || entry->hash != *hash || entry->key_count != cache->key_count
+            || memcmp(entry->key, cache->key, cache->key_count * sizeof(*cache->key)))
+        return VK_NULL_HANDLE;
+
+    return entry->vk_descriptor_set;
+}
+
+static void wined3d_context_vk_add_descriptor_set(struct wined3d_context_vk *context_vk,
+        VkDescriptorSet vk_descriptor_set, uint64_t hash)
+{
+    struct wined3d_descriptor_set_cache_vk *cache = &context_vk->descriptor_sets;
+    struct wined3d_descriptor_set_cache_entry_vk *entry;
+
+    /* The key is only valid if the lookup got far enough to build it. */
+    if (!hash)
+        return;
+
+    entry = &cache->entries[hash & (ARRAY_SIZE(cache->entries) - 1)];
+    if (!wined3d_array_reserve((void **)&entry->key, &entry->key_size, cache->key_count, sizeof(*entry->key)))
+    {
+        entry->vk_descriptor_set = VK_NULL_HANDLE;
+        return;
+    }
+
+    memcpy(entry->key, cache->key, cache->key_count * sizeof(*entry->key));
+    entry->key_count = cache->key_count;
+    entry->hash = hash;
+    entry->vk_descriptor_set = vk_descriptor_set;
+    entry->vk_descriptor_pool = context_vk->vk_descriptor_pool;
+}
+
 static bool wined3d_context_vk_update_descriptors(struct wined3d_context_vk *context_vk,
         VkCommandBuffer vk_command_buffer, const struct wined3d_state *state, enum wined3d_pipeline pipeline)
 {
@@ -2904,6 +3303,7 @@ static bool wined3d_context_vk_update_descriptors(struct wined3d_context_vk *con
     VkPipelineLayout vk_pipeline_layout;
     VkPipelineBindPoint vk_bind_point;
     VkDescriptorSet vk_descriptor_set;
+    uint64_t hash;
     VkResult vr;
     size_t i;
 
@@ -2928,12 +3328,6 @@ static bool wined3d_context_vk_update_descriptors(struct wined3d_context_vk *con
             return false;
     }
 
-    if ((vr = wined3d_context_vk_create_vk_descriptor_set(context_vk, vk_set_layout, &vk_descriptor_set)))
-    {
-        WARN("Failed to create descriptor set, vr %s.\n", wined3d_debug_vkresult(vr));
-        return false;
-    }
-
     writes->count = 0;
     for (i = 0; i < bindings->count; ++i)
     {
@@ -2942,32 +3336,32 @@ static bool wined3d_context_vk_update_descriptors(struct wined3d_context_vk *con
         switch (binding->shader_descriptor_type)
         {
             case WINED3D_SHADER_DESCRIPTOR_TYPE_CBV:
-                if (!wined3d_shader_descriptor_writes_vk_add_cbv_write(writes, context_vk, vk_descriptor_set,
+                if (!wined3d_shader_descriptor_writes_vk_add_cbv_write(writes, context_vk,
                         state, binding, &buffers[binding->shader_type][binding->resource_idx]))
                     return false;
                 break;
 
             case WINED3D_SHADER_DESCRIPTOR_TYPE_SRV:
                 if (!wined3d_shader_descriptor_writes_vk_add_srv_write(writes,
-                        context_vk, vk_descriptor_set, state, binding))
+                        context_vk, state, binding))
                     return false;
                 break;
 
             case WINED3D_SHADER_DESCRIPTOR_TYPE_UAV:
                 if (!wined3d_shader_descriptor_writes_vk_add_uav_write(writes,
-                        context_vk, pipeline, vk_descriptor_set, state, binding))
+                        context_vk, pipeline, state, binding))
                     return false;
                 break;
 
             case WINED3D_SHADER_DESCRIPTOR_TYPE_UAV_COUNTER:
                 if (!wined3d_shader_descriptor_writes_vk_add_uav_counter_write(writes,
-                        context_vk, pipeline, vk_descriptor_set, state, binding))
+                        context_vk, pipeline, state, binding))
                     return false;
                 break;
 
             case WINED3D_SHADER_DESCRIPTOR_TYPE_SAMPLER:
                 if (!wined3d_shader_descriptor_writes_vk_add_sampler_write(writes,
-                        context_vk, vk_descriptor_set, state, binding))
+                        context_vk, state, binding))
                     return false;
                 break;
 
@@ -2977,7 +3371,25 @@ static bool wined3d_context_vk_update_descriptors(struct wined3d_context_vk *con
         }
     }
 
-    VK_CALL(vkUpdateDescriptorSets(device_vk->vk_device, writes->count, writes->writes, 0, NULL));
+    if ((vk_descriptor_set = wined3d_context_vk_find_descriptor_set(context_vk, vk_set_layout, &hash)))
+    {
+        ++context_vk->pipeline_stats.descriptor_sets_reused;
+    }
+    else
+    {
+        if ((vr = wined3d_context_vk_create_vk_descriptor_set(context_vk, vk_set_layout, &vk_descriptor_set)))
+        {
+            WARN("Failed to create descriptor set, vr %s.\n", wined3d_debug_vkresult(vr));
+            return false;
+        }
+
+        for (i = 0; i < writes->count; ++i)
+            writes->writes[i].dstSet = vk_descriptor_set;
+        VK_CALL(vkUpdateDescriptorSets(device_vk->vk_device, writes->count, writes->writes, 0, NULL));
+        wined3d_context_vk_add_descriptor_set(context_vk, vk_descriptor_set, hash);
+        ++context_vk->pipeline_stats.descriptor_sets_written;
+    }
+
     VK_CALL(vkCmdBindDescriptorSets(vk_command_buffer, vk_bind_point,
             vk_pipeline_layout, 0, 1, &vk_descriptor_set, 0, NULL));
 
@@ -3068,33 +3480,292 @@ fail:
     return NULL;
 }
 
-static VkPipeline wined3d_context_vk_get_graphics_pipeline(struct wined3d_context_vk *context_vk)
+/* The pipeline description points into the key itself, so it needs to be
+ * fixed up after the key is copied. */
+static void wined3d_graphics_pipeline_key_vk_relocate(struct wined3d_graphics_pipeline_key_vk *key)
 {
+    key->input_desc.pVertexBindingDescriptions = key->bindings;
+    key->input_desc.pVertexAttributeDescriptions = key->attributes;
+    if (key->input_desc.pNext)
+        key->input_desc.pNext = &key->divisor_desc;
+    key->divisor_desc.pVertexBindingDivisors = key->divisors;
+    key->vp_desc.pViewports = &key->viewport;
+    key->vp_desc.pScissors = &key->scissor;
+    key->ms_desc.pSampleMask = &key->sample_mask;
+    key->blend_desc.pAttachments = key->blend_attachments;
+
+    key->pipeline_desc.pStages = key->stages;
+    key->pipeline_desc.pVertexInputState = &key->input_desc;
+    key->pipeline_desc.pInputAssemblyState = &key->ia_desc;
+    key->pipeline_desc.pTessellationState = &key->ts_desc;
+    key->pipeline_desc.pViewportState = &key->vp_desc;
+    key->pipeline_desc.pRasterizationState = &key->rs_desc;
+    key->pipeline_desc.pMultisampleState = &key->ms_desc;
+    key->pipeline_desc.pDepthStencilState = &key->ds_desc;
+    key->pipeline_desc.pColorBlendState = &key->blend_desc;
+    key->pipeline_desc.pDynamicState = &key->dynamic_desc;
+}
+
+/* Returns whether the pipeline for "b" can stand in for the pipeline for "a".
+ * Shaders, interfaces, vertex input and viewport need to match; blend,
+ * depth/stencil and rasteriser state may differ. */
+static bool wined3d_graphics_pipeline_key_vk_is_compatible(const struct wined3d_graphics_pipeline_key_vk *a,
+        const struct wined3d_graphics_pipeline_key_vk *b)
+{
+    unsigned int i;
+
+    if (a->pipeline_desc.layout != b->pipeline_desc.layout
+            || a->pipeline_desc.renderPass != b->pipeline_desc.renderPass
+            || a->pipeline_desc.stageCount != b->pipeline_desc.stageCount
+            || a->ia_desc.topology != b->ia_desc.topology
+            || a->ts_desc.patchControlPoints != b->ts_desc.patchControlPoints
+            || a->ms_desc.rasterizationSamples != b->ms_desc.rasterizationSamples
+            || a->input_desc.vertexBindingDescriptionCount != b->input_desc.vertexBindingDescriptionCount
+            || a->input_desc.vertexAttributeDescriptionCount != b->input_desc.vertexAttributeDescriptionCount
+            || !a->input_desc.pNext != !b->input_desc.pNext)
+        return false;
+
+    for (i = 0; i < a->pipeline_desc.stageCount; ++i)
+    {
+        if (a->stages[i].stage != b->stages[i].stage || a->stages[i].module != b->stages[i].module)
+            return false;
+    }
+
+    if (memcmp(a->bindings, b->bindings, a->input_desc.vertexBindingDescriptionCount * sizeof(*a->bindings))
+            || memcmp(a->attributes, b->attributes,
+            a->input_desc.vertexAttributeDescriptionCount * sizeof(*a->attributes)))
+        return false;
+    if (a->input_desc.pNext && (a->divisor_desc.vertexBindingDivisorCount != b->divisor_desc.vertexBindingDivisorCount
+            || memcmp(a->divisors, b->divisors, a->divisor_desc.vertexBindingDivisorCount * sizeof(*a->divisors))))
+        return false;
+
+    return !memcmp(&a->viewport, &b->viewport, sizeof(a->viewport))
+            && !memcmp(&a->scissor, &b->scissor, sizeof(a->scissor));
+}
+
+static void CALLBACK wined3d_graphics_pipeline_vk_compile(TP_CALLBACK_INSTANCE *instance, void *ctx)
+{
+    struct wined3d_graphics_pipeline_vk *pipeline_vk = ctx;
+    struct wined3d_context_vk *context_vk = pipeline_vk->context_vk;
     struct wined3d_device_vk *device_vk = wined3d_device_vk(context_vk->c.device);
     const struct wined3d_vk_info *vk_info = context_vk->vk_info;
+    VkPipeline vk_pipeline;
+    VkResult vr;
+
+    if ((vr = VK_CALL(vkCreateGraphicsPipelines(device_vk->vk_device, device_vk->vk_pipeline_cache,
+            1, &pipeline_vk->key.pipeline_desc, NULL, &vk_pipeline))) < 0)
+    {
+        WARN("Failed to create graphics pipeline, vr %s.\n", wined3d_debug_vkresult(vr));
+        vk_pipeline = VK_NULL_HANDLE;
+    }
+
+    pipeline_vk->vk_pipeline = vk_pipeline;
+    InterlockedExchange(&pipeline_vk->compiling, FALSE);
+
+    EnterCriticalSection(&context_vk->pipeline_compile_cs);
+    if (!--context_vk->pipeline_compile_count)
+        WakeAllConditionVariable(&context_vk->pipeline_compile_cv);
+    LeaveCriticalSection(&context_vk->pipeline_compile_cs);
+}
+
+static bool wined3d_context_vk_compile_graphics_pipeline_async(struct wined3d_context_vk *context_vk,
+        struct wined3d_graphics_pipeline_vk *pipeline_vk)
+{
+    pipeline_vk->compiling = TRUE;
+
+    EnterCriticalSection(&context_vk->pipeline_compile_cs);
+    ++context_vk->pipeline_compile_count;
+    LeaveCriticalSection(&context_vk->pipeline_compile_cs);
+
+    if (TrySubmitThreadpoolCallback(wined3d_graphics_pipeline_vk_compile, pipeline_vk, NULL))
+        return true;
+
+    WARN("Failed to submit pipeline compilation, error %u.\n", GetLastError());
+    pipeline_vk->compiling = FALSE;
+    EnterCriticalSection(&context_vk->pipeline_compile_cs);
+    --context_vk->pipeline_compile_count;
+    LeaveCriticalSection(&context_vk->pipeline_compile_cs);
+    return false;
+}
+
+void wined3d_context_vk_wait_pipeline_compiles(struct wined3d_context_vk *context_vk)
+{
+    EnterCriticalSection(&context_vk->pipeline_compile_cs);
+    while (context_vk->pipeline_compile_count)
+        SleepConditionVariableCS(&context_vk->pipeline_compile_cv, &context_vk->pipeline_compile_cs, INFINITE);
+    LeaveCriticalSection(&context_vk->pipeline_compile_cs);
+}
+
+void wined3d_context_vk_report_pipeline_stats(struct wined3d_context_vk *context_vk)
+{
+    LARGE_INTEGER freq;
+
+    if (TRACE_ON(d3d_perf) && (context_vk->pipeline_stats.stalled || context_vk->pipeline_stats.async
+            || context_vk->pipeline_stats.skipped || context_vk->pipeline_stats.fallback))
+        TRACE_(d3d_perf)("Pipelines: %u compiled synchronously, %u compiled asynchronously, "
+                "%u draws skipped, %u draws with a fallback pipeline.\n",
+                context_vk->pipeline_stats.stalled, context_vk->pipeline_stats.async,
+                context_vk->pipeline_stats.skipped, context_vk->pipeline_stats.fallback);
+    if (TRACE_ON(d3d_perf) && context_vk->pipeline_stats.draws)
+    {
+        uint64_t time = context_vk->pipeline_stats.draw_state_time;
+
+        QueryPerformanceFrequency(&freq);
+        /* Split the conversion to nanoseconds so that it can't overflow. */
+        time = time / freq.QuadPart * 1000000000 + time % freq.QuadPart * 1000000000 / freq.QuadPart;
+        TRACE_(d3d_perf)("%u draws, %I64u ns per draw to apply state.\n", context_vk->pipeline_stats.draws,
+                time / context_vk->pipeline_stats.draws);
+    }
+    if (TRACE_ON(d3d_perf) && (context_vk->pipeline_stats.descriptor_sets_written
+            || context_vk->pipeline_stats.descriptor_sets_reused))
+        TRACE_(d3d_perf)("Descriptor sets: %u written, %u reused.\n",
+                context_vk->pipeline_stats.descriptor_sets_written, context_vk->pipeline_stats.descriptor_sets_reused);
+    if (TRACE_ON(d3d_perf) && (context_vk->upload_ring.allocation_count || context_vk->upload_ring.fallback_count))
+        TRACE_(d3d_perf)("Uploads: %u from the upload ring (%s bytes), %u separate staging bos.\n",
+                context_vk->upload_ring.allocation_count,
+                wine_dbgstr_longlong(context_vk->upload_ring.allocated_size), context_vk->upload_ring.fallback_count);
+    context_vk->upload_ring.allocation_count = 0;
+    context_vk->upload_ring.fallback_count = 0;
+    context_vk->upload_ring.allocated_size = 0;
+
+    memset(&context_vk->pipeline_stats, 0, sizeof(context_vk->pipeline_stats));
+}
+
+/* Removes the pipelines that finished compiling from the pending list. A
+ * failed compile leaves the pipeline without a VkPipeline, and the next draw
+ * that needs it compiles it synchronously. */
+static void wined3d_context_vk_poll_graphics_pipelines(struct wined3d_context_vk *context_vk)
+{
+    struct wined3d_graphics_pipeline_vk *pipeline_vk, *next;
+    bool compiled = false;
+
+    LIST_FOR_EACH_ENTRY_SAFE(pipeline_vk, next, &context_vk->pending_graphics_pipelines,
+            struct wined3d_graphics_pipeline_vk, pending_entry)
+    {
+        if (InterlockedCompareExchange(&pipeline_vk->compiling, FALSE, FALSE))
+            continue;
+        list_remove(&pipeline_vk->pending_entry);
+        if (pipeline_vk->vk_pipeline)
+            compiled = true;
+    }
+
+    /* The new pipelines may be better fallbacks. */
+    if (compiled)
+    {
+        LIST_FOR_EACH_ENTRY(pipeline_vk, &context_vk->pending_graphics_pipelines,
+                struct wined3d_graphics_pipeline_vk, pending_entry)
+        {
+            if (!pipeline_vk->fallback)
+                pipeline_vk->fallback_searched = false;
+        }
+    }
+}
+
+static VkPipeline wined3d_context_vk_get_pending_graphics_pipeline(struct wined3d_context_vk *context_vk,
+        struct wined3d_graphics_pipeline_vk *pipeline_vk)
+{
+    struct wined3d_graphics_pipeline_vk *fallback_vk;
+    size_t i;
+
+    context_vk->graphics_pipeline_pending = 1;
+
+    if (wined3d_settings.pipeline_compile_mode == WINED3D_PIPELINE_COMPILE_FALLBACK
+            && !pipeline_vk->fallback_searched)
+    {
+        pipeline_vk->fallback_searched = true;
+        for (i = 0; i < context_vk->graphics_pipelines.size; ++i)
+        {
+            if (!(fallback_vk = context_vk->graphics_pipelines.entries[i]) || fallback_vk == pipeline_vk
+                    || InterlockedCompareExchange(&fallback_vk->compiling, FALSE, FALSE) || !fallback_vk->vk_pipeline)
+                continue;
+            if (wined3d_graphics_pipeline_key_vk_is_compatible(&pipeline_vk->key, &fallback_vk->key))
+            {
+                pipeline_vk->fallback = fallback_vk;
+                break;
+            }
+        }
+    }
+
+    if (pipeline_vk->fallback)
+    {
+        ++context_vk->pipeline_stats.fallback;
+        return pipeline_vk->fallback->vk_pipeline;
+    }
+
+    ++context_vk->pipeline_stats.skipped;
+    return VK_NULL_HANDLE;
+}
+
+static bool wined3d_context_vk_compile_graphics_pipeline(struct wined3d_context_vk *context_vk,
+        struct wined3d_graphics_pipeline_vk *pipeline_vk)
+{
+    struct wined3d_device_vk *device_vk = wined3d_device_vk(context_vk->c.device);
+    const struct wined3d_vk_info *vk_info = context_vk->vk_info;
+    VkResult vr;
+
+    ++context_vk->pipeline_stats.stalled;
+    if ((vr = VK_CALL(vkCreateGraphicsPipelines(device_vk->vk_device,
+            device_vk->vk_pipeline_cache, 1, &pipeline_vk->key.pipeline_desc, NULL, &pipeline_vk->vk_pipeline))) < 0)
+    {
+        WARN("Failed to create graphics pipeline, vr %s.\n", wined3d_debug_vkresult(vr));
+        pipeline_vk->vk_pipeline = VK_NULL_HANDLE;
+        return false;
+    }
+
+    return true;
+}
+
+static VkPipeline wined3d_context_vk_get_graphics_pipeline(struct wined3d_context_vk *context_vk)
+{
     struct wined3d_graphics_pipeline_vk *pipeline_vk;
     struct wined3d_graphics_pipeline_key_vk *key;
-    struct wine_rb_entry *entry;
-    VkResult vr;
+
+    if (!list_empty(&context_vk->pending_graphics_pipelines))
+        wined3d_context_vk_poll_graphics_pipelines(context_vk);
 
     key = &context_vk->graphics.pipeline_key_vk;
-    if ((entry = wine_rb_get(&context_vk->graphics_pipelines, key)))
-        return WINE_RB_ENTRY_VALUE(entry, struct wined3d_graphics_pipeline_vk, entry)->vk_pipeline;
+    if ((pipeline_vk = wined3d_context_vk_find_graphics_pipeline(context_vk, key)))
+    {
+        if (InterlockedCompareExchange(&pipeline_vk->compiling, FALSE, FALSE))
+            return wined3d_context_vk_get_pending_graphics_pipeline(context_vk, pipeline_vk);
+        /* The asynchronous compile failed. */
+        if (!pipeline_vk->vk_pipeline)
+            wined3d_context_vk_compile_graphics_pipeline(context_vk, pipeline_vk);
+        return pipeline_vk->vk_pipeline;
+    }
+
+    if (!wined3d_context_vk_reserve_graphics_pipeline(context_vk))
+    {
+        ERR("Failed to reserve pipeline table space.\n");
+        return VK_NULL_HANDLE;
+    }
 
     if (!(pipeline_vk = heap_alloc(sizeof(*pipeline_vk))))
         return VK_NULL_HANDLE;
     pipeline_vk->key = *key;
+    wined3d_graphics_pipeline_key_vk_relocate(&pipeline_vk->key);
+    pipeline_vk->vk_pipeline = VK_NULL_HANDLE;
+    pipeline_vk->context_vk = context_vk;
+    pipeline_vk->compiling = FALSE;
+    pipeline_vk->fallback = NULL;
+    pipeline_vk->fallback_searched = false;
 
-    if ((vr = VK_CALL(vkCreateGraphicsPipelines(device_vk->vk_device,
-            VK_NULL_HANDLE, 1, &key->pipeline_desc, NULL, &pipeline_vk->vk_pipeline))) < 0)
+    if (wined3d_settings.pipeline_compile_mode != WINED3D_PIPELINE_COMPILE_WAIT
+            && wined3d_context_vk_compile_graphics_pipeline_async(context_vk, pipeline_vk))
+    {
+        wined3d_context_vk_add_graphics_pipeline(context_vk, pipeline_vk);
+        list_add_tail(&context_vk->pending_graphics_pipelines, &pipeline_vk->pending_entry);
+        ++context_vk->pipeline_stats.async;
+        return wined3d_context_vk_get_pending_graphics_pipeline(context_vk, pipeline_vk);
+    }
+
+    if (!wined3d_context_vk_compile_graphics_pipeline(context_vk, pipeline_vk))
     {
-        WARN("Failed to create graphics pipeline, vr %s.\n", wined3d_debug_vkresult(vr));
         heap_free(pipeline_vk);
         return VK_NULL_HANDLE;
     }
 
-    if (wine_rb_put(&context_vk->graphics_pipelines, &pipeline_vk->key, &pipeline_vk->entry) == -1)
-        ERR("Failed to insert pipeline.\n");
+    wined3d_context_vk_add_graphics_pipeline(context_vk, pipeline_vk);
 
     return pipeline_vk->vk_pipeline;
 }
@@ -3359,11 +4030,13 @@ VkCommandBuffer wined3d_context_vk_apply_draw_state(struct wined3d_context_vk *c
     }
 
     if (wined3d_context_vk_update_graphics_pipeline_key(context_vk, state, context_vk->graphics.vk_pipeline_layout,
-            &null_buffer_binding) || !context_vk->graphics.vk_pipeline)
+            &null_buffer_binding) || !context_vk->graphics.vk_pipeline || context_vk->graphics_pipeline_pending)
     {
+        context_vk->graphics_pipeline_pending = 0;
         if (!(context_vk->graphics.vk_pipeline = wined3d_context_vk_get_graphics_pipeline(context_vk)))
         {
-            ERR("Failed to get graphics pipeline.\n");
+            if (!context_vk->graphics_pipeline_pending)
+                ERR("Failed to get graphics pipeline.\n");
             return VK_NULL_HANDLE;
         }
 
@@ -3560,8 +4233,17 @@ HRESULT wined3d_context_vk_init(struct wined3d_context_vk *context_vk, struct wi
 
     wine_rb_init(&context_vk->render_passes, wined3d_render_pass_vk_compare);
     wine_rb_init(&context_vk->pipeline_layouts, wined3d_pipeline_layout_vk_compare);
-    wine_rb_init(&context_vk->graphics_pipelines, wined3d_graphics_pipeline_vk_compare);
+    memset(&context_vk->graphics_pipelines, 0, sizeof(context_vk->graphics_pipelines));
+    list_init(&context_vk->pending_graphics_pipelines);
+    memset(&context_vk->descriptor_sets, 0, sizeof(context_vk->descriptor_sets));
+    memset(&context_vk->upload_ring, 0, sizeof(context_vk->upload_ring));
     wine_rb_init(&context_vk->bo_slab_available, wined3d_bo_slab_vk_compare);
 
+    InitializeCriticalSection(&context_vk->pipeline_compile_cs);
+    if (context_vk->pipeline_compile_cs.DebugInfo != (RTL_CRITICAL_SECTION_DEBUG *)-1)
+        context_vk->pipeline_compile_cs.DebugInfo->Spare[0]
+                = (DWORD_PTR)(__FILE__ ": wined3d_context_vk.pipeline_compile_cs");
+    InitializeConditionVariable(&context_vk->pipeline_compile_cv);
+
     return WINED3D_OK;
 }
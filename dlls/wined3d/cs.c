@@ -20,6 +20,7 @@
 #include "wined3d_private.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(d3d);
+WINE_DECLARE_DEBUG_CHANNEL(d3d_perf);
 WINE_DECLARE_DEBUG_CHANNEL(d3d_sync);
 WINE_DECLARE_DEBUG_CHANNEL(fps);
 
@@ -72,6 +73,11 @@ struct wined3d_command_list
 
     SIZE_T depth_stencil_state_count;
     struct wined3d_depth_stencil_state **depth_stencil_states;
+
+    /* Offsets of the packets that need to be executed, computed when the list
+     * is recorded. If this is NULL, all packets are executed. */
+    SIZE_T packet_count;
+    SIZE_T *packet_offsets;
 };
 
 static void invalidate_client_address(struct wined3d_resource *resource)
@@ -639,6 +645,195 @@ static struct wined3d_cs_packet *wined3d_next_cs_packet(const uint8_t *data, SIZ
     return packet;
 }
 
+/* Optional command stream statistics, enabled by the "CSProfile" setting.
+ * Only the multi-threaded command stream is profiled. One line is written per
+ * presented frame, which should make it possible to tell whether a title is
+ * bound by the application thread (CS mostly idle, no producer stalls), by
+ * the command stream (CS busy for most of the frame, producer stalls) or by
+ * the GPU (most of the frame spent in the present op). */
+struct wined3d_cs_profile
+{
+    HANDLE file;
+    LARGE_INTEGER frequency;
+    unsigned int frame;
+
+    /* Accessed by the CS thread only. */
+    struct
+    {
+        uint64_t count;
+        LONGLONG time;
+    } ops[WINED3D_CS_OP_STOP];
+    LONGLONG frame_start;
+    LONGLONG busy_time;
+    LONGLONG idle_time;
+    LONGLONG present_time;
+    unsigned int packet_count;
+    uint64_t queue_used;
+    unsigned int queue_max;
+
+    /* Updated by the application thread, in microseconds. */
+    LONG stall_count;
+    LONGLONG stall_time;
+    LONG sync_count;
+    LONGLONG sync_time;
+};
+
+static LONGLONG wined3d_cs_profile_time(void)
+{
+    LARGE_INTEGER counter;
+
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart;
+}
+
+/* Converts a performance counter interval to "units" per second, without
+ * overflowing for long running totals. */
+static UINT64 wined3d_cs_profile_convert(const struct wined3d_cs_profile *profile, LONGLONG time, UINT64 units)
+{
+    LONGLONG frequency = profile->frequency.QuadPart;
+
+    return (time / frequency) * units + (time % frequency) * units / frequency;
+}
+
+static UINT64 wined3d_cs_profile_us(const struct wined3d_cs_profile *profile, LONGLONG time)
+{
+    return wined3d_cs_profile_convert(profile, time, 1000000);
+}
+
+static void wined3d_cs_profile_add(LONGLONG volatile *dest, LONGLONG value)
+{
+    LONGLONG old;
+
+    do
+    {
+        old = *dest;
+    } while (InterlockedCompareExchange64(dest, old + value, old) != old);
+}
+
+static LONGLONG wined3d_cs_profile_reset(LONGLONG volatile *dest)
+{
+    LONGLONG old;
+
+    do
+    {
+        old = *dest;
+    } while (InterlockedCompareExchange64(dest, 0, old) != old);
+
+    return old;
+}
+
+static void wined3d_cs_profile_printf(struct wined3d_cs_profile *profile, const char *format, ...)
+{
+    char buffer[256];
+    DWORD written;
+    va_list args;
+    int len;
+
+    va_start(args, format);
+    len = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+
+    if (len < 0)
+        return;
+    len = min(len, sizeof(buffer) - 1);
+    if (!WriteFile(profile->file, buffer, len, &written, NULL) || written != len)
+        WARN("Failed to write command stream statistics, error %u.\n", GetLastError());
+}
+
+static struct wined3d_cs_profile *wined3d_cs_profile_create(void)
+{
+    struct wined3d_cs_profile *profile;
+
+    if (!(profile = heap_alloc_zero(sizeof(*profile))))
+        return NULL;
+
+    if ((profile->file = CreateFileA(wined3d_settings.cs_profile_path, FILE_APPEND_DATA,
+            FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_ALWAYS, 0, NULL)) == INVALID_HANDLE_VALUE)
+    {
+        ERR("Failed to open %s, error %u.\n", debugstr_a(wined3d_settings.cs_profile_path), GetLastError());
+        heap_free(profile);
+        return NULL;
+    }
+
+    QueryPerformanceFrequency(&profile->frequency);
+    wined3d_cs_profile_printf(profile, "# cs,frame,frame_us,busy_us,idle_us,present_us,packets,"
+            "queue_avg,queue_max,stalls,stall_us,syncs,sync_us\n");
+
+    return profile;
+}
+
+static void wined3d_cs_profile_destroy(struct wined3d_cs *cs)
+{
+    struct wined3d_cs_profile *profile = cs->profile;
+    unsigned int i;
+
+    wined3d_cs_profile_printf(profile, "# cs,op,count,total_us,avg_ns\n");
+    for (i = 0; i < ARRAY_SIZE(profile->ops); ++i)
+    {
+        if (!profile->ops[i].count)
+            continue;
+        wined3d_cs_profile_printf(profile, "%p,%s,%I64u,%I64u,%I64u\n", cs, debug_cs_op(i),
+                profile->ops[i].count, wined3d_cs_profile_us(profile, profile->ops[i].time),
+                wined3d_cs_profile_convert(profile, profile->ops[i].time, 1000000000) / profile->ops[i].count);
+    }
+
+    CloseHandle(profile->file);
+    heap_free(profile);
+    cs->profile = NULL;
+}
+
+/* Called by the application thread after waiting for "start" on the command
+ * stream, either for queue space or for the queue to drain. */
+static void wined3d_cs_profile_wait(struct wined3d_cs_profile *profile, LONG *count, LONGLONG *time, LONGLONG start)
+{
+    InterlockedIncrement(count);
+    wined3d_cs_profile_add(time, wined3d_cs_profile_us(profile, wined3d_cs_profile_time() - start));
+}
+
+static void wined3d_cs_profile_packet(struct wined3d_cs *cs, const struct wined3d_cs_queue *queue,
+        SIZE_T tail, enum wined3d_cs_op opcode, LONGLONG start)
+{
+    struct wined3d_cs_profile *profile = cs->profile;
+    LONGLONG end = wined3d_cs_profile_time();
+    unsigned int used;
+
+    used = (*(volatile LONG *)&queue->head - tail) & (WINED3D_CS_QUEUE_SIZE - 1);
+    profile->queue_used += used;
+    profile->queue_max = max(profile->queue_max, used);
+    ++profile->packet_count;
+
+    ++profile->ops[opcode].count;
+    profile->ops[opcode].time += end - start;
+    profile->busy_time += end - start;
+    if (opcode != WINED3D_CS_OP_PRESENT)
+        return;
+    profile->present_time += end - start;
+
+    if (profile->frame_start)
+    {
+        wined3d_cs_profile_printf(profile, "%p,%u,%I64u,%I64u,%I64u,%I64u,%u,%u,%u,%u,%I64u,%u,%I64u\n",
+                cs, profile->frame,
+                wined3d_cs_profile_us(profile, end - profile->frame_start),
+                wined3d_cs_profile_us(profile, profile->busy_time),
+                wined3d_cs_profile_us(profile, profile->idle_time),
+                wined3d_cs_profile_us(profile, profile->present_time),
+                profile->packet_count, (unsigned int)(profile->queue_used / profile->packet_count),
+                profile->queue_max, InterlockedExchange(&profile->stall_count, 0),
+                (UINT64)wined3d_cs_profile_reset(&profile->stall_time),
+                InterlockedExchange(&profile->sync_count, 0),
+                (UINT64)wined3d_cs_profile_reset(&profile->sync_time));
+    }
+
+    ++profile->frame;
+    profile->frame_start = end;
+    profile->busy_time = 0;
+    profile->idle_time = 0;
+    profile->present_time = 0;
+    profile->packet_count = 0;
+    profile->queue_used = 0;
+    profile->queue_max = 0;
+}
+
 static void wined3d_cs_exec_nop(struct wined3d_cs *cs, const void *data)
 {
 }
@@ -3021,25 +3216,36 @@ static void (* const wined3d_cs_op_handlers[])(struct wined3d_cs *cs, const void
     /* WINED3D_CS_OP_EXECUTE_COMMAND_LIST        */ wined3d_cs_exec_execute_command_list,
 };
 
+static void wined3d_cs_execute_command_list_packet(struct wined3d_cs *cs, const struct wined3d_cs_packet *packet)
+{
+    enum wined3d_cs_op opcode = *(const enum wined3d_cs_op *)packet->data;
+
+    if (opcode >= WINED3D_CS_OP_STOP)
+        ERR("Invalid opcode %#x.\n", opcode);
+    else
+        wined3d_cs_op_handlers[opcode](cs, packet->data);
+    TRACE("%s executed.\n", debug_cs_op(opcode));
+}
+
 static void wined3d_cs_exec_execute_command_list(struct wined3d_cs *cs, const void *data)
 {
     const struct wined3d_cs_execute_command_list *op = data;
     SIZE_T start = 0, end = op->list->data_size;
     const BYTE *cs_data = op->list->data;
+    SIZE_T i;
 
     TRACE("Executing command list %p.\n", op->list);
 
-    while (start < end)
+    if (op->list->packet_offsets)
     {
-        const struct wined3d_cs_packet *packet = wined3d_next_cs_packet(cs_data, &start);
-        enum wined3d_cs_op opcode = *(const enum wined3d_cs_op *)packet->data;
-
-        if (opcode >= WINED3D_CS_OP_STOP)
-            ERR("Invalid opcode %#x.\n", opcode);
-        else
-            wined3d_cs_op_handlers[opcode](cs, packet->data);
-        TRACE("%s executed.\n", debug_cs_op(opcode));
+        for (i = 0; i < op->list->packet_count; ++i)
+            wined3d_cs_execute_command_list_packet(cs,
+                    (const struct wined3d_cs_packet *)&cs_data[op->list->packet_offsets[i]]);
+        return;
     }
+
+    while (start < end)
+        wined3d_cs_execute_command_list_packet(cs, wined3d_next_cs_packet(cs_data, &start));
 }
 
 void wined3d_device_context_emit_execute_command_list(struct wined3d_device_context *context,
@@ -3243,6 +3449,7 @@ static void *wined3d_cs_queue_require_space(struct wined3d_cs_queue *queue, size
     size_t queue_size = ARRAY_SIZE(queue->data);
     size_t header_size, packet_size, remaining;
     struct wined3d_cs_packet *packet;
+    LONGLONG stall_start = 0;
 
     header_size = FIELD_OFFSET(struct wined3d_cs_packet, data[0]);
     packet_size = FIELD_OFFSET(struct wined3d_cs_packet, data[size]);
@@ -3291,10 +3498,16 @@ static void *wined3d_cs_queue_require_space(struct wined3d_cs_queue *queue, size
         if (new_pos < tail && new_pos)
             break;
 
+        if (cs->profile && !stall_start)
+            stall_start = wined3d_cs_profile_time();
+
         TRACE("Waiting for free space. Head %u, tail %u, packet size %lu.\n",
                 head, tail, (unsigned long)packet_size);
     }
 
+    if (stall_start)
+        wined3d_cs_profile_wait(cs->profile, &cs->profile->stall_count, &cs->profile->stall_time, stall_start);
+
     packet = (struct wined3d_cs_packet *)&queue->data[queue->head];
     packet->size = size;
     return packet->data;
@@ -3314,12 +3527,21 @@ static void *wined3d_cs_mt_require_space(struct wined3d_device_context *context,
 static void wined3d_cs_mt_finish(struct wined3d_device_context *context, enum wined3d_cs_queue_id queue_id)
 {
     struct wined3d_cs *cs = wined3d_cs_from_context(context);
+    struct wined3d_cs_queue *queue;
+    LONGLONG start = 0;
 
     if (cs->thread_id == GetCurrentThreadId())
         return wined3d_cs_st_finish(context, queue_id);
 
-    while (cs->queue[queue_id].head != *(volatile LONG *)&cs->queue[queue_id].tail)
+    queue = &cs->queue[queue_id];
+    if (cs->profile && queue->head != *(volatile LONG *)&queue->tail)
+        start = wined3d_cs_profile_time();
+
+    while (queue->head != *(volatile LONG *)&queue->tail)
         YieldProcessor();
+
+    if (start)
+        wined3d_cs_profile_wait(cs->profile, &cs->profile->sync_count, &cs->profile->sync_time, start);
 }
 
 static const struct wined3d_device_context_ops wined3d_cs_mt_ops =
@@ -3394,6 +3616,7 @@ static DWORD WINAPI wined3d_cs_run(void *ctx)
     enum wined3d_cs_op opcode;
     HMODULE wined3d_module;
     unsigned int poll = 0;
+    LONGLONG start = 0;
     SIZE_T tail;
 
     TRACE("Started.\n");
@@ -3421,7 +3644,18 @@ static DWORD WINAPI wined3d_cs_run(void *ctx)
             if (wined3d_cs_queue_is_empty(cs, queue))
             {
                 if (++spin_count >= WINED3D_CS_SPIN_COUNT && list_empty(&cs->query_poll_list))
-                    wined3d_cs_wait_event(cs);
+                {
+                    if (cs->profile)
+                    {
+                        start = wined3d_cs_profile_time();
+                        wined3d_cs_wait_event(cs);
+                        cs->profile->idle_time += wined3d_cs_profile_time() - start;
+                    }
+                    else
+                    {
+                        wined3d_cs_wait_event(cs);
+                    }
+                }
                 continue;
             }
         }
@@ -3441,9 +3675,13 @@ static DWORD WINAPI wined3d_cs_run(void *ctx)
                 break;
             }
 
+            if (cs->profile)
+                start = wined3d_cs_profile_time();
             wined3d_cs_command_lock(cs);
             wined3d_cs_op_handlers[opcode](cs, packet->data);
             wined3d_cs_command_unlock(cs);
+            if (cs->profile)
+                wined3d_cs_profile_packet(cs, queue, tail, opcode, start);
             TRACE("%s at %p executed.\n", debug_cs_op(opcode), packet);
         }
 
@@ -3506,9 +3744,14 @@ struct wined3d_cs *wined3d_cs_create(struct wined3d_device *device,
             goto fail;
         }
 
+        if (wined3d_settings.cs_profile_path)
+            cs->profile = wined3d_cs_profile_create();
+
         if (!(cs->thread = CreateThread(NULL, 0, wined3d_cs_run, cs, 0, NULL)))
         {
             ERR("Failed to create wined3d command stream thread.\n");
+            if (cs->profile)
+                wined3d_cs_profile_destroy(cs);
             FreeLibrary(cs->wined3d_module);
             CloseHandle(cs->event);
             heap_free(cs->data);
@@ -3530,6 +3773,8 @@ void wined3d_cs_destroy(struct wined3d_cs *cs)
     if (cs->thread)
     {
         wined3d_cs_emit_stop(cs);
+        if (cs->profile)
+            wined3d_cs_profile_destroy(cs);
         CloseHandle(cs->thread);
         if (!CloseHandle(cs->event))
             ERR("Closing event failed.\n");
@@ -3969,6 +4214,133 @@ void CDECL wined3d_deferred_context_destroy(struct wined3d_device_context *conte
     heap_free(deferred);
 }
 
+enum wined3d_command_list_slot
+{
+    WINED3D_CL_SLOT_VIEWPORTS,
+    WINED3D_CL_SLOT_SCISSOR_RECTS,
+    WINED3D_CL_SLOT_VERTEX_DECLARATION,
+    WINED3D_CL_SLOT_INDEX_BUFFER,
+    WINED3D_CL_SLOT_PREDICATION,
+    WINED3D_CL_SLOT_BLEND_STATE,
+    WINED3D_CL_SLOT_DEPTH_STENCIL_STATE,
+    WINED3D_CL_SLOT_RASTERIZER_STATE,
+    WINED3D_CL_SLOT_SHADER,
+    WINED3D_CL_SLOT_RENDER_STATE = WINED3D_CL_SLOT_SHADER + WINED3D_SHADER_TYPE_COUNT,
+    WINED3D_CL_SLOT_COUNT = WINED3D_CL_SLOT_RENDER_STATE + WINEHIGHEST_RENDER_STATE + 1,
+    /* Packets that only set state unrelated to the slots above. */
+    WINED3D_CL_SLOT_NONE = WINED3D_CL_SLOT_COUNT,
+    /* Packets that may consume state. */
+    WINED3D_CL_SLOT_BARRIER,
+};
+
+static unsigned int wined3d_command_list_get_packet_slot(const struct wined3d_cs_packet *packet)
+{
+    enum wined3d_cs_op opcode = *(const enum wined3d_cs_op *)packet->data;
+
+    switch (opcode)
+    {
+        case WINED3D_CS_OP_SET_VIEWPORTS:
+            return WINED3D_CL_SLOT_VIEWPORTS;
+        case WINED3D_CS_OP_SET_SCISSOR_RECTS:
+            return WINED3D_CL_SLOT_SCISSOR_RECTS;
+        case WINED3D_CS_OP_SET_VERTEX_DECLARATION:
+            return WINED3D_CL_SLOT_VERTEX_DECLARATION;
+        case WINED3D_CS_OP_SET_INDEX_BUFFER:
+            return WINED3D_CL_SLOT_INDEX_BUFFER;
+        case WINED3D_CS_OP_SET_PREDICATION:
+            return WINED3D_CL_SLOT_PREDICATION;
+        case WINED3D_CS_OP_SET_BLEND_STATE:
+            return WINED3D_CL_SLOT_BLEND_STATE;
+        case WINED3D_CS_OP_SET_DEPTH_STENCIL_STATE:
+            return WINED3D_CL_SLOT_DEPTH_STENCIL_STATE;
+        case WINED3D_CS_OP_SET_RASTERIZER_STATE:
+            return WINED3D_CL_SLOT_RASTERIZER_STATE;
+        case WINED3D_CS_OP_SET_SHADER:
+            return WINED3D_CL_SLOT_SHADER + ((const struct wined3d_cs_set_shader *)packet->data)->type;
+        case WINED3D_CS_OP_SET_RENDER_STATE:
+            return WINED3D_CL_SLOT_RENDER_STATE + ((const struct wined3d_cs_set_render_state *)packet->data)->state;
+
+        case WINED3D_CS_OP_NOP:
+        case WINED3D_CS_OP_SET_STREAM_SOURCES:
+        case WINED3D_CS_OP_SET_CONSTANT_BUFFERS:
+        case WINED3D_CS_OP_SET_SHADER_RESOURCE_VIEWS:
+        case WINED3D_CS_OP_SET_UNORDERED_ACCESS_VIEWS:
+        case WINED3D_CS_OP_SET_SAMPLERS:
+            return WINED3D_CL_SLOT_NONE;
+
+        default:
+            return WINED3D_CL_SLOT_BARRIER;
+    }
+}
+
+/* Finds state packets that are overwritten by a later packet for the same
+ * state before anything uses the state, and builds the list of the remaining
+ * packets. None of the packets involved have side effects beyond the state
+ * they set, so the resulting state is unaffected. */
+static void wined3d_command_list_analyse(struct wined3d_command_list *list)
+{
+    struct
+    {
+        unsigned int generation;
+        SIZE_T idx;
+    } *slots;
+    LARGE_INTEGER start, end, freq;
+    SIZE_T offset, count, i, *offsets;
+    unsigned int generation, slot;
+    bool *redundant;
+
+    QueryPerformanceCounter(&start);
+
+    for (offset = 0, count = 0; offset < list->data_size; ++count)
+        wined3d_next_cs_packet(list->data, &offset);
+
+    offsets = heap_calloc(count, sizeof(*offsets));
+    redundant = heap_calloc(count, sizeof(*redundant));
+    slots = heap_calloc(WINED3D_CL_SLOT_COUNT, sizeof(*slots));
+    if (!offsets || !redundant || !slots)
+    {
+        heap_free(offsets);
+        offsets = NULL;
+        goto done;
+    }
+
+    generation = 1;
+    for (offset = 0, i = 0; i < count; ++i)
+    {
+        offsets[i] = offset;
+        slot = wined3d_command_list_get_packet_slot(wined3d_next_cs_packet(list->data, &offset));
+
+        if (slot == WINED3D_CL_SLOT_BARRIER)
+        {
+            ++generation;
+        }
+        else if (slot < WINED3D_CL_SLOT_COUNT)
+        {
+            if (slots[slot].generation == generation)
+                redundant[slots[slot].idx] = true;
+            slots[slot].generation = generation;
+            slots[slot].idx = i;
+        }
+    }
+
+    for (i = 0, list->packet_count = 0; i < count; ++i)
+    {
+        if (!redundant[i])
+            offsets[list->packet_count++] = offsets[i];
+    }
+
+    QueryPerformanceCounter(&end);
+    QueryPerformanceFrequency(&freq);
+    TRACE_(d3d_perf)("Command list %p: %zu of %zu packets are redundant, analysed in %I64d us.\n",
+            list, (size_t)(count - list->packet_count), (size_t)count,
+            (end.QuadPart - start.QuadPart) * 1000000 / freq.QuadPart);
+
+done:
+    heap_free(slots);
+    heap_free(redundant);
+    list->packet_offsets = offsets;
+}
+
 HRESULT CDECL wined3d_deferred_context_record_command_list(struct wined3d_device_context *context,
         bool restore, struct wined3d_command_list **list)
 {
@@ -4064,6 +4436,8 @@ HRESULT CDECL wined3d_deferred_context_record_command_list(struct wined3d_device
     else
         wined3d_device_context_reset_state(&deferred->c);
 
+    wined3d_command_list_analyse(object);
+
     TRACE("Created command list %p.\n", object);
     *list = object;
     wined3d_device_context_unlock(context);
@@ -4081,6 +4455,7 @@ static void wined3d_command_list_destroy_object(void *object)
     for (i = 0; i < list->upload_count; ++i)
         heap_free(list->uploads[i].sysmem);
 
+    heap_free(list->packet_offsets);
     heap_free(list);
 }
 
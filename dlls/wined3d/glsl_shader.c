@@ -38,6 +38,7 @@
 
 WINE_DEFAULT_DEBUG_CHANNEL(d3d_shader);
 WINE_DECLARE_DEBUG_CHANNEL(d3d);
+WINE_DECLARE_DEBUG_CHANNEL(d3d_perf);
 WINE_DECLARE_DEBUG_CHANNEL(winediag);
 
 #define WINED3D_GLSL_SAMPLE_PROJECTED   0x01
@@ -140,6 +141,34 @@ struct shader_glsl_priv
     struct wine_rb_tree ffp_fragment_shaders;
     BOOL ffp_proj_control;
     BOOL legacy_lighting;
+
+    /* Program binary cache. */
+    uint64_t driver_hash;
+    unsigned int program_cache_hits;
+    unsigned int program_cache_misses;
+    LONGLONG link_time;
+};
+
+#define GLSL_PROGRAM_CACHE_MAGIC 0x42505747 /* "GWPB" */
+#define GLSL_PROGRAM_CACHE_VERSION 1
+
+struct glsl_program_cache_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t driver_hash;
+    uint64_t key_hash;
+    uint64_t check_hash;
+    uint32_t format;
+    uint32_t size;
+};
+
+/* State baked into a program at link time that is not part of the shader sources. */
+struct glsl_program_link_args
+{
+    uint32_t attribs_map;
+    uint32_t sm4_inputs;
+    uint32_t dual_source;
 };
 
 struct glsl_vs_program
@@ -638,6 +667,145 @@ void shader_glsl_validate_link(const struct wined3d_gl_info *gl_info, GLuint pro
     print_glsl_info_log(gl_info, program, TRUE);
 }
 
+static uint64_t shader_glsl_get_driver_hash(const struct wined3d_gl_info *gl_info, struct shader_glsl_priv *priv)
+{
+    static const GLenum strings[] = {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION_ARB};
+    const char *str;
+    unsigned int i;
+    uint64_t hash;
+
+    if (priv->driver_hash)
+        return priv->driver_hash;
+
+    hash = 0xcbf29ce484222325ull;
+    for (i = 0; i < ARRAY_SIZE(strings); ++i)
+    {
+        if ((str = (const char *)gl_info->gl_ops.gl.p_glGetString(strings[i])))
+            hash = wined3d_hash64(str, strlen(str) + 1, hash);
+    }
+    return priv->driver_hash = hash;
+}
+
+/* Hash the sources of the shaders attached to a program. The attachment order
+ * is not defined, so the per-shader hashes are combined in an order
+ * independent way. */
+static BOOL shader_glsl_hash_program_sources(const struct wined3d_gl_info *gl_info,
+        GLuint program, uint64_t *key_hash, uint64_t *check_hash)
+{
+    GLint count, length, i;
+    uint64_t key = 0, check = 0;
+    GLuint *shaders;
+    char *source;
+
+    GL_EXTCALL(glGetProgramiv(program, GL_ATTACHED_SHADERS, &count));
+    if (!count || !(shaders = heap_calloc(count, sizeof(*shaders))))
+        return FALSE;
+    GL_EXTCALL(glGetAttachedShaders(program, count, &count, shaders));
+
+    for (i = 0; i < count; ++i)
+    {
+        GL_EXTCALL(glGetShaderiv(shaders[i], GL_SHADER_SOURCE_LENGTH, &length));
+        if (!length || !(source = heap_alloc(length)))
+        {
+            heap_free(shaders);
+            return FALSE;
+        }
+        GL_EXTCALL(glGetShaderSource(shaders[i], length, &length, source));
+        key += wined3d_hash64(source, length, 0xcbf29ce484222325ull);
+        check ^= wined3d_hash64(source, length, 0x84222325cbf29ce4ull) + length;
+        heap_free(source);
+    }
+    heap_free(shaders);
+
+    *key_hash = key;
+    *check_hash = check;
+    return TRUE;
+}
+
+/* Link a program, using a binary from the shader cache if possible.
+ * Context activation is done by the caller. */
+static void shader_glsl_link_program(const struct wined3d_gl_info *gl_info, struct shader_glsl_priv *priv,
+        GLuint program, const struct glsl_program_link_args *args)
+{
+    struct glsl_program_cache_header header, *cached;
+    LARGE_INTEGER start, end;
+    uint64_t key_hash, check_hash;
+    size_t cached_size;
+    GLint status, size;
+    GLenum format;
+    char name[32];
+    void *binary;
+
+    QueryPerformanceCounter(&start);
+
+    if (!wined3d_settings.shader_cache_path || !args || !gl_info->supported[ARB_GET_PROGRAM_BINARY]
+            || !shader_glsl_hash_program_sources(gl_info, program, &key_hash, &check_hash))
+    {
+        GL_EXTCALL(glLinkProgram(program));
+        shader_glsl_validate_link(gl_info, program);
+        QueryPerformanceCounter(&end);
+        priv->link_time += end.QuadPart - start.QuadPart;
+        return;
+    }
+
+    key_hash = wined3d_hash64(args, sizeof(*args), key_hash);
+    check_hash = wined3d_hash64(args, sizeof(*args), check_hash);
+    sprintf(name, "glsl-%08x%08x.bin", (unsigned int)(key_hash >> 32), (unsigned int)key_hash);
+
+    if ((cached = wined3d_shader_cache_load(name, &cached_size)))
+    {
+        if (cached_size >= sizeof(*cached) && cached->magic == GLSL_PROGRAM_CACHE_MAGIC
+                && cached->version == GLSL_PROGRAM_CACHE_VERSION
+                && cached->driver_hash == shader_glsl_get_driver_hash(gl_info, priv)
+                && cached->key_hash == key_hash && cached->check_hash == check_hash
+                && cached->size == cached_size - sizeof(*cached))
+        {
+            GL_EXTCALL(glProgramBinary(program, cached->format, cached + 1, cached->size));
+            GL_EXTCALL(glGetProgramiv(program, GL_LINK_STATUS, &status));
+            heap_free(cached);
+            if (status)
+            {
+                ++priv->program_cache_hits;
+                TRACE("Loaded program %u from the shader cache.\n", program);
+                return;
+            }
+            WARN("Driver rejected cached program binary %s.\n", debugstr_a(name));
+        }
+        else
+        {
+            heap_free(cached);
+        }
+    }
+
+    ++priv->program_cache_misses;
+    GL_EXTCALL(glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+    GL_EXTCALL(glLinkProgram(program));
+    shader_glsl_validate_link(gl_info, program);
+
+    QueryPerformanceCounter(&end);
+    priv->link_time += end.QuadPart - start.QuadPart;
+
+    GL_EXTCALL(glGetProgramiv(program, GL_LINK_STATUS, &status));
+    GL_EXTCALL(glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size));
+    checkGLcall("get program binary length");
+    if (!status || size <= 0 || !(binary = heap_alloc(size)))
+        return;
+
+    GL_EXTCALL(glGetProgramBinary(program, size, &size, &format, binary));
+    if (!gl_info->gl_ops.gl.p_glGetError())
+    {
+        header.magic = GLSL_PROGRAM_CACHE_MAGIC;
+        header.version = GLSL_PROGRAM_CACHE_VERSION;
+        header.driver_hash = shader_glsl_get_driver_hash(gl_info, priv);
+        header.key_hash = key_hash;
+        header.check_hash = check_hash;
+        header.format = format;
+        header.size = size;
+        wined3d_shader_cache_store(name, &header, sizeof(header), binary, size);
+    }
+    heap_free(binary);
+}
+
 static BOOL shader_glsl_use_layout_qualifier(const struct wined3d_gl_info *gl_info)
 {
     /* Layout qualifiers were introduced in GLSL 1.40. The Nvidia Legacy GPU
@@ -10101,6 +10269,7 @@ static HRESULT shader_glsl_compile_compute_shader(struct shader_glsl_priv *priv,
     struct wined3d_string_buffer *buffer = &priv->shader_buffer;
     struct glsl_cs_compiled_shader *gl_shaders;
     struct glsl_shader_private *shader_data;
+    struct glsl_program_link_args link_args;
     struct glsl_shader_prog_link *entry;
     GLuint shader_id, program_id;
 
@@ -10157,8 +10326,8 @@ static HRESULT shader_glsl_compile_compute_shader(struct shader_glsl_priv *priv,
     list_add_head(&shader->linked_programs, &entry->cs.shader_entry);
 
     TRACE("Linking GLSL shader program %u.\n", program_id);
-    GL_EXTCALL(glLinkProgram(program_id));
-    shader_glsl_validate_link(gl_info, program_id);
+    memset(&link_args, 0, sizeof(link_args));
+    shader_glsl_link_program(gl_info, priv, program_id, &link_args);
 
     GL_EXTCALL(glUseProgram(program_id));
     checkGLcall("glUseProgram");
@@ -10241,6 +10410,7 @@ static void set_glsl_shader_program(const struct wined3d_context_gl *context_gl,
     struct list *ps_list, *vs_list;
     WORD attribs_map;
     struct wined3d_string_buffer *tmp_name;
+    struct glsl_program_link_args link_args;
 
     if (!(context_gl->c.shader_update_mask & (1u << WINED3D_SHADER_TYPE_VERTEX)) && ctx_data->glsl_program)
     {
@@ -10404,6 +10574,7 @@ static void set_glsl_shader_program(const struct wined3d_context_gl *context_gl,
     {
         attribs_map = (1u << WINED3D_FFP_ATTRIBS_COUNT) - 1;
     }
+    link_args.attribs_map = shader_glsl_use_explicit_attrib_location(gl_info) ? 0 : attribs_map;
 
     if (!shader_glsl_use_explicit_attrib_location(gl_info))
     {
@@ -10490,8 +10661,11 @@ static void set_glsl_shader_program(const struct wined3d_context_gl *context_gl,
 
     /* Link the program */
     TRACE("Linking GLSL shader program %u.\n", program_id);
-    GL_EXTCALL(glLinkProgram(program_id));
-    shader_glsl_validate_link(gl_info, program_id);
+    link_args.sm4_inputs = vshader && vshader->reg_maps.shader_version.major >= 4;
+    link_args.dual_source = state->blend_state && state->blend_state->dual_source;
+    /* Transform feedback varyings are not part of the cache key. */
+    shader_glsl_link_program(gl_info, priv, program_id,
+            gshader && gshader->u.gs.so_desc ? NULL : &link_args);
 
     shader_glsl_init_vs_uniform_locations(gl_info, priv, program_id, &entry->vs,
             vshader ? vshader->limits->constant_float : 0);
@@ -11110,6 +11284,15 @@ fail:
 static void shader_glsl_free(struct wined3d_device *device, struct wined3d_context *context)
 {
     struct shader_glsl_priv *priv = device->shader_priv;
+    LARGE_INTEGER freq;
+
+    if (priv->link_time)
+    {
+        QueryPerformanceFrequency(&freq);
+        TRACE_(d3d_perf)("Program cache: %u hits, %u misses, %s ms spent linking.\n",
+                priv->program_cache_hits, priv->program_cache_misses,
+                wine_dbgstr_longlong(priv->link_time * 1000 / freq.QuadPart));
+    }
 
     wine_rb_destroy(&priv->program_lookup, NULL, NULL);
     constant_heap_free(&priv->pconst_heap);
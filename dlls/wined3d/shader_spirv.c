@@ -118,6 +118,18 @@ struct wined3d_shader_spirv_shader_interface
     struct vkd3d_shader_transform_feedback_info xfb_info;
 };
 
+#define SHADER_SPIRV_CACHE_MAGIC 0x56505357 /* "WSPV" */
+#define SHADER_SPIRV_CACHE_VERSION 1
+
+struct shader_spirv_cache_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key_hash;
+    uint64_t check_hash;
+    uint64_t size;
+};
+
 static bool wined3d_load_vkd3d_shader_functions(void *vkd3d_shader_handle)
 {
 #define LOAD_FUNCPTR(f) if (!(f = dlsym(vkd3d_shader_handle, #f))) return false;
@@ -303,23 +315,87 @@ static void shader_spirv_init_shader_interface_vk(struct wined3d_shader_spirv_sh
     iface->vkd3d_interface.uav_counter_count = b->uav_counter_count;
 }
 
+static uint64_t shader_spirv_hash_compile_state(const struct wined3d_shader_desc *shader_desc,
+        enum wined3d_shader_type shader_type, const struct shader_spirv_compile_arguments *args,
+        const struct shader_spirv_resource_bindings *bindings, uint64_t hash)
+{
+    const char *version = vkd3d_shader_get_version(NULL, NULL);
+
+    hash = wined3d_hash64(version, strlen(version), hash);
+    hash = wined3d_hash64(&shader_type, sizeof(shader_type), hash);
+    hash = wined3d_hash64(shader_desc->byte_code, shader_desc->byte_code_size, hash);
+    if (args)
+        hash = wined3d_hash64(args, sizeof(*args), hash);
+    hash = wined3d_hash64(bindings->bindings, bindings->binding_count * sizeof(*bindings->bindings), hash);
+    return wined3d_hash64(bindings->uav_counters,
+            bindings->uav_counter_count * sizeof(*bindings->uav_counters), hash);
+}
+
+static VkShaderModule shader_spirv_create_module(struct wined3d_device_vk *device_vk, const void *code, size_t size)
+{
+    const struct wined3d_vk_info *vk_info = &device_vk->vk_info;
+    VkShaderModuleCreateInfo shader_create_info;
+    VkShaderModule module;
+    VkResult vr;
+
+    shader_create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shader_create_info.pNext = NULL;
+    shader_create_info.flags = 0;
+    shader_create_info.codeSize = size;
+    shader_create_info.pCode = code;
+    if ((vr = VK_CALL(vkCreateShaderModule(device_vk->vk_device, &shader_create_info, NULL, &module))) < 0)
+    {
+        WARN("Failed to create Vulkan shader module, vr %s.\n", wined3d_debug_vkresult(vr));
+        return VK_NULL_HANDLE;
+    }
+
+    return module;
+}
+
 static VkShaderModule shader_spirv_compile_shader(struct wined3d_context_vk *context_vk,
         const struct wined3d_shader_desc *shader_desc, enum wined3d_shader_type shader_type,
         const struct shader_spirv_compile_arguments *args, const struct shader_spirv_resource_bindings *bindings,
         const struct wined3d_stream_output_desc *so_desc)
 {
+    struct wined3d_device_vk *device_vk = wined3d_device_vk(context_vk->c.device);
     struct wined3d_shader_spirv_compile_args compile_args;
     struct wined3d_shader_spirv_shader_interface iface;
-    VkShaderModuleCreateInfo shader_create_info;
+    const struct shader_spirv_cache_header *cached;
+    struct shader_spirv_cache_header header;
     struct vkd3d_shader_compile_info info;
-    const struct wined3d_vk_info *vk_info;
-    struct wined3d_device_vk *device_vk;
+    uint64_t key_hash = 0, check_hash = 0;
     struct vkd3d_shader_code spirv;
+    size_t cached_size;
     VkShaderModule module;
+    char name[32];
     char *messages;
-    VkResult vr;
     int ret;
 
+    /* Stream output descriptions reference semantic names, and aren't worth
+     * hashing for the few shaders that use them. */
+    if (wined3d_settings.shader_cache_path && !so_desc)
+    {
+        key_hash = shader_spirv_hash_compile_state(shader_desc, shader_type, args, bindings, 0xcbf29ce484222325ull);
+        check_hash = shader_spirv_hash_compile_state(shader_desc, shader_type, args, bindings, 0x84222325cbf29ce4ull);
+        sprintf(name, "spirv-%08x%08x.bin", (unsigned int)(key_hash >> 32), (unsigned int)key_hash);
+
+        if ((cached = wined3d_shader_cache_load(name, &cached_size)))
+        {
+            module = VK_NULL_HANDLE;
+            if (cached_size > sizeof(*cached) && cached->magic == SHADER_SPIRV_CACHE_MAGIC
+                    && cached->version == SHADER_SPIRV_CACHE_VERSION && cached->key_hash == key_hash
+                    && cached->check_hash == check_hash && cached->size == cached_size - sizeof(*cached))
+                module = shader_spirv_create_module(device_vk, cached + 1, cached->size);
+            heap_free((void *)cached);
+            if (module)
+            {
+                TRACE("Loaded shader module from %s.\n", debugstr_a(name));
+                return module;
+            }
+            WARN("Ignoring invalid shader cache file %s.\n", debugstr_a(name));
+        }
+    }
+
     shader_spirv_init_shader_interface_vk(&iface, bindings, so_desc);
     shader_spirv_init_compile_args(&compile_args, &iface.vkd3d_interface,
             VKD3D_SHADER_SPIRV_ENVIRONMENT_VULKAN_1_0, shader_type, args);
@@ -356,19 +432,14 @@ static VkShaderModule shader_spirv_compile_shader(struct wined3d_context_vk *con
         return VK_NULL_HANDLE;
     }
 
-    device_vk = wined3d_device_vk(context_vk->c.device);
-    vk_info = &device_vk->vk_info;
-
-    shader_create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    shader_create_info.pNext = NULL;
-    shader_create_info.flags = 0;
-    shader_create_info.codeSize = spirv.size;
-    shader_create_info.pCode = spirv.code;
-    if ((vr = VK_CALL(vkCreateShaderModule(device_vk->vk_device, &shader_create_info, NULL, &module))) < 0)
+    if ((module = shader_spirv_create_module(device_vk, spirv.code, spirv.size)) && key_hash)
     {
-        vkd3d_shader_free_shader_code(&spirv);
-        WARN("Failed to create Vulkan shader module, vr %s.\n", wined3d_debug_vkresult(vr));
-        return VK_NULL_HANDLE;
+        header.magic = SHADER_SPIRV_CACHE_MAGIC;
+        header.version = SHADER_SPIRV_CACHE_VERSION;
+        header.key_hash = key_hash;
+        header.check_hash = check_hash;
+        header.size = spirv.size;
+        wined3d_shader_cache_store(name, &header, sizeof(header), spirv.code, spirv.size);
     }
 
     vkd3d_shader_free_shader_code(&spirv);
@@ -473,7 +544,7 @@ static struct shader_spirv_compute_program_vk *shader_spirv_find_compute_program
     pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
     pipeline_info.basePipelineIndex = -1;
     if ((vr = VK_CALL(vkCreateComputePipelines(device_vk->vk_device,
-            VK_NULL_HANDLE, 1, &pipeline_info, NULL, &program->vk_pipeline))) < 0)
+            device_vk->vk_pipeline_cache, 1, &pipeline_info, NULL, &program->vk_pipeline))) < 0)
     {
         ERR("Failed to create Vulkan compute pipeline, vr %s.\n", wined3d_debug_vkresult(vr));
         VK_CALL(vkDestroyShaderModule(device_vk->vk_device, program->vk_module, NULL));
@@ -969,6 +1040,9 @@ static void shader_spirv_invalidate_graphics_program_variant(struct wined3d_cont
 {
     enum wined3d_shader_type shader_type;
 
+    /* Pipelines may still be compiling against the module. */
+    wined3d_context_vk_wait_pipeline_compiles(context_vk);
+
     for (shader_type = 0; shader_type < WINED3D_SHADER_TYPE_GRAPHICS_COUNT; ++shader_type)
     {
         if (context_vk->graphics.vk_modules[shader_type] != variant->vk_module)
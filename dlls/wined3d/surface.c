@@ -28,6 +28,9 @@
 
 #include "config.h"
 #include "wined3d_private.h"
+#ifdef WINED3D_HAVE_SSE2
+#include <emmintrin.h>
+#endif
 
 WINE_DEFAULT_DEBUG_CHANNEL(d3d);
 WINE_DECLARE_DEBUG_CHANNEL(d3d_perf);
@@ -125,6 +128,49 @@ static void convert_r32_float_r16_float(const BYTE *src, BYTE *dst,
     }
 }
 
+#ifdef WINED3D_HAVE_SSE2
+/* Expands 5 and 6 bit channels with the same rounding as the tables in
+ * convert_r5g6b5_x8r8g8b8(): (v * 527 + 23) >> 6 and (v * 259 + 33) >> 6. */
+static unsigned int WINED3D_SSE2_FUNC convert_r5g6b5_x8r8g8b8_row_sse2(const WORD *src, DWORD *dst, unsigned int w)
+{
+    const __m128i mask_5 = _mm_set1_epi16(0x1f);
+    const __m128i mask_6 = _mm_set1_epi16(0x3f);
+    const __m128i alpha = _mm_set1_epi16((short)0xff00);
+    __m128i pixel, r, g, b, bg, ra;
+    unsigned int x;
+
+    for (x = 0; x + 8 <= w; x += 8)
+    {
+        pixel = _mm_loadu_si128((const __m128i *)&src[x]);
+        r = _mm_srli_epi16(pixel, 11);
+        g = _mm_and_si128(_mm_srli_epi16(pixel, 5), mask_6);
+        b = _mm_and_si128(pixel, mask_5);
+
+        r = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(527)), _mm_set1_epi16(23)), 6);
+        g = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(g, _mm_set1_epi16(259)), _mm_set1_epi16(33)), 6);
+        b = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(527)), _mm_set1_epi16(23)), 6);
+
+        bg = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+        ra = _mm_or_si128(r, alpha);
+        _mm_storeu_si128((__m128i *)&dst[x], _mm_unpacklo_epi16(bg, ra));
+        _mm_storeu_si128((__m128i *)&dst[x + 4], _mm_unpackhi_epi16(bg, ra));
+    }
+
+    return x;
+}
+
+static unsigned int WINED3D_SSE2_FUNC convert_a8r8g8b8_x8r8g8b8_row_sse2(const DWORD *src, DWORD *dst, unsigned int w)
+{
+    const __m128i alpha = _mm_set1_epi32(0xff000000);
+    unsigned int x;
+
+    for (x = 0; x + 4 <= w; x += 4)
+        _mm_storeu_si128((__m128i *)&dst[x], _mm_or_si128(_mm_loadu_si128((const __m128i *)&src[x]), alpha));
+
+    return x;
+}
+#endif
+
 static void convert_r5g6b5_x8r8g8b8(const BYTE *src, BYTE *dst,
         DWORD pitch_in, DWORD pitch_out, unsigned int w, unsigned int h)
 {
@@ -154,7 +200,13 @@ static void convert_r5g6b5_x8r8g8b8(const BYTE *src, BYTE *dst,
     {
         const WORD *src_line = (const WORD *)(src + y * pitch_in);
         DWORD *dst_line = (DWORD *)(dst + y * pitch_out);
-        for (x = 0; x < w; ++x)
+
+        x = 0;
+#ifdef WINED3D_HAVE_SSE2
+        if (wined3d_cpu_has_sse2())
+            x = convert_r5g6b5_x8r8g8b8_row_sse2(src_line, dst_line, w);
+#endif
+        for (; x < w; ++x)
         {
             WORD pixel = src_line[x];
             dst_line[x] = 0xff000000u
@@ -179,7 +231,12 @@ static void convert_a8r8g8b8_x8r8g8b8(const BYTE *src, BYTE *dst,
         const DWORD *src_line = (const DWORD *)(src + y * pitch_in);
         DWORD *dst_line = (DWORD *)(dst + y * pitch_out);
 
-        for (x = 0; x < w; ++x)
+        x = 0;
+#ifdef WINED3D_HAVE_SSE2
+        if (wined3d_cpu_has_sse2())
+            x = convert_a8r8g8b8_x8r8g8b8_row_sse2(src_line, dst_line, w);
+#endif
+        for (; x < w; ++x)
         {
             dst_line[x] = 0xff000000 | (src_line[x] & 0xffffff);
         }
@@ -360,6 +417,7 @@ static struct wined3d_texture *surface_convert_format(struct wined3d_texture *sr
     {
         unsigned int dst_row_pitch, dst_slice_pitch;
         struct wined3d_bo_address dst_data;
+        LARGE_INTEGER start, end, freq;
         struct wined3d_range range;
         const BYTE *src;
         BYTE *dst;
@@ -375,7 +433,17 @@ static struct wined3d_texture *surface_convert_format(struct wined3d_texture *sr
         dst = wined3d_context_map_bo_address(context, &dst_data,
                 dst_texture->sub_resources[0].size, WINED3D_MAP_WRITE);
 
+        if (TRACE_ON(d3d_perf))
+            QueryPerformanceCounter(&start);
         conv->convert(src, dst, src_row_pitch, dst_row_pitch, desc.width, desc.height);
+        if (TRACE_ON(d3d_perf))
+        {
+            QueryPerformanceCounter(&end);
+            QueryPerformanceFrequency(&freq);
+            TRACE_(d3d_perf)("Converted %ux%u pixels from %s to %s in %I64d us.\n", desc.width, desc.height,
+                    debug_d3dformat(src_format->id), debug_d3dformat(dst_format->id),
+                    (end.QuadPart - start.QuadPart) * 1000000 / freq.QuadPart);
+        }
 
         range.offset = 0;
         range.size = dst_texture->sub_resources[0].size;
@@ -1258,6 +1258,7 @@ static void swapchain_vk_present(struct wined3d_swapchain *swapchain, const RECT
     }
 
     wined3d_swapchain_vk_rotate(swapchain, context_vk);
+    wined3d_context_vk_report_pipeline_stats(context_vk);
 
     wined3d_texture_validate_location(swapchain->front_buffer, 0, WINED3D_LOCATION_DRAWABLE);
     wined3d_texture_invalidate_location(swapchain->front_buffer, 0, ~WINED3D_LOCATION_DRAWABLE);
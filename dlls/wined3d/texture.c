@@ -3093,6 +3093,7 @@ static BOOL wined3d_texture_gl_load_texture(struct wined3d_texture_gl *texture_g
     struct wined3d_texture_sub_resource *sub_resource;
     const struct wined3d_format *format;
     struct wined3d_bo_address data;
+    LARGE_INTEGER start, end, freq;
     BYTE *src_mem, *dst_mem = NULL;
     struct wined3d_box src_box;
     DWORD dst_location;
@@ -3214,8 +3215,18 @@ static BOOL wined3d_texture_gl_load_texture(struct wined3d_texture_gl *texture_g
             ERR("Out of memory (%u).\n", dst_slice_pitch);
             return FALSE;
         }
+        if (TRACE_ON(d3d_perf))
+            QueryPerformanceCounter(&start);
         conversion->convert(src_mem, src_row_pitch, dst_mem, dst_row_pitch,
                 width, height, &texture_gl->t.async.gl_color_key);
+        if (TRACE_ON(d3d_perf))
+        {
+            QueryPerformanceCounter(&end);
+            QueryPerformanceFrequency(&freq);
+            TRACE_(d3d_perf)("Colour key converted %ux%u pixels to %s in %I64d us.\n", width, height,
+                    debug_d3dformat(conversion->dst_format),
+                    (end.QuadPart - start.QuadPart) * 1000000 / freq.QuadPart);
+        }
         src_row_pitch = dst_row_pitch;
         src_slice_pitch = dst_slice_pitch;
         wined3d_context_gl_unmap_bo_address(context_gl, &data, 0, NULL);
@@ -4751,8 +4762,10 @@ static void wined3d_texture_vk_upload_data(struct wined3d_context *context,
 
     if (!src_bo_addr->buffer_object)
     {
-        if (!wined3d_context_vk_create_bo(context_vk, sub_resource->size,
-                VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &staging_bo))
+        /* vkCmdCopyBufferToImage() requires the buffer offset to be a
+         * multiple of both 4 and the format's block size. */
+        if (!wined3d_context_vk_create_upload_bo(context_vk, sub_resource->size,
+                4 * src_format->block_byte_count, &staging_bo))
         {
             ERR("Failed to create staging bo.\n");
             return;
@@ -4764,7 +4777,7 @@ static void wined3d_texture_vk_upload_data(struct wined3d_context *context,
                 sub_resource->size, WINED3D_MAP_DISCARD | WINED3D_MAP_WRITE)))
         {
             ERR("Failed to map staging bo.\n");
-            wined3d_context_vk_destroy_bo(context_vk, &staging_bo);
+            wined3d_context_vk_destroy_upload_bo(context_vk, &staging_bo);
             return;
         }
 
@@ -4848,7 +4861,7 @@ static void wined3d_texture_vk_upload_data(struct wined3d_context *context,
 
     if (src_bo == &staging_bo)
     {
-        wined3d_context_vk_destroy_bo(context_vk, &staging_bo);
+        wined3d_context_vk_destroy_upload_bo(context_vk, &staging_bo);
     }
     else if (vk_barrier.srcAccessMask)
     {
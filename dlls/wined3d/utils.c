@@ -29,6 +29,9 @@
 #include <stdio.h>
 
 #include "wined3d_private.h"
+#ifdef WINED3D_HAVE_SSE2
+#include <emmintrin.h>
+#endif
 
 WINE_DEFAULT_DEBUG_CHANNEL(d3d);
 
@@ -1169,6 +1172,78 @@ static BOOL color_in_range(const struct wined3d_color_key *color_key, DWORD colo
             && color <= color_key->color_space_high_value;
 }
 
+#ifdef WINED3D_HAVE_SSE2
+bool wined3d_cpu_has_sse2(void)
+{
+#ifdef __x86_64__
+    return true;
+#else
+    static int sse2 = -1;
+
+    if (sse2 == -1)
+        sse2 = IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE);
+    return sse2;
+#endif
+}
+
+/* Returns all ones for colours inside the colour key range, using the same
+ * unsigned comparison as color_in_range(). "low" and "high" are biased by
+ * 0x80000000, since SSE2 only has signed comparisons. */
+static inline __m128i WINED3D_SSE2_FUNC color_key_mask_sse2(__m128i color, __m128i low, __m128i high)
+{
+    color = _mm_xor_si128(color, _mm_set1_epi32(0x80000000));
+    return _mm_xor_si128(_mm_or_si128(_mm_cmplt_epi32(color, low), _mm_cmpgt_epi32(color, high)),
+            _mm_set1_epi32(-1));
+}
+
+/* Colours inside the range get "alpha_bits" cleared, colours outside the
+ * range get "set_bits" set. Returns the number of pixels converted. */
+static unsigned int WINED3D_SSE2_FUNC convert_color_key_row_32_sse2(const DWORD *src, DWORD *dst,
+        unsigned int width, const struct wined3d_color_key *color_key, DWORD alpha_bits, DWORD set_bits)
+{
+    const __m128i low = _mm_set1_epi32(color_key->color_space_low_value ^ 0x80000000);
+    const __m128i high = _mm_set1_epi32(color_key->color_space_high_value ^ 0x80000000);
+    const __m128i alpha = _mm_set1_epi32(alpha_bits);
+    const __m128i set = _mm_set1_epi32(set_bits);
+    __m128i color, mask;
+    unsigned int x;
+
+    for (x = 0; x + 4 <= width; x += 4)
+    {
+        color = _mm_loadu_si128((const __m128i *)&src[x]);
+        mask = _mm_and_si128(color_key_mask_sse2(color, low, high), alpha);
+        _mm_storeu_si128((__m128i *)&dst[x], _mm_andnot_si128(mask, _mm_or_si128(color, set)));
+    }
+
+    return x;
+}
+
+static unsigned int WINED3D_SSE2_FUNC convert_color_key_row_16_sse2(const WORD *src, WORD *dst,
+        unsigned int width, const struct wined3d_color_key *color_key, bool b5g6r5)
+{
+    const __m128i low = _mm_set1_epi32(color_key->color_space_low_value ^ 0x80000000);
+    const __m128i high = _mm_set1_epi32(color_key->color_space_high_value ^ 0x80000000);
+    const __m128i alpha = _mm_set1_epi16((short)0x8000);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i color, mask;
+    unsigned int x;
+
+    for (x = 0; x + 8 <= width; x += 8)
+    {
+        color = _mm_loadu_si128((const __m128i *)&src[x]);
+        mask = _mm_packs_epi32(color_key_mask_sse2(_mm_unpacklo_epi16(color, zero), low, high),
+                color_key_mask_sse2(_mm_unpackhi_epi16(color, zero), low, high));
+        if (b5g6r5)
+            color = _mm_or_si128(_mm_srli_epi16(_mm_and_si128(color, _mm_set1_epi16((short)0xffc0)), 1),
+                    _mm_and_si128(color, _mm_set1_epi16(0x1f)));
+        _mm_storeu_si128((__m128i *)&dst[x], _mm_andnot_si128(_mm_and_si128(mask, alpha),
+                _mm_or_si128(color, alpha)));
+    }
+
+    return x;
+}
+#endif
+
 static void convert_b5g6r5_unorm_b5g5r5a1_unorm_color_key(const BYTE *src, unsigned int src_pitch,
         BYTE *dst, unsigned int dst_pitch, unsigned int width, unsigned int height,
         const struct wined3d_color_key *color_key)
@@ -1181,7 +1256,12 @@ static void convert_b5g6r5_unorm_b5g5r5a1_unorm_color_key(const BYTE *src, unsig
     {
         src_row = (WORD *)&src[src_pitch * y];
         dst_row = (WORD *)&dst[dst_pitch * y];
-        for (x = 0; x < width; ++x)
+        x = 0;
+#ifdef WINED3D_HAVE_SSE2
+        if (wined3d_cpu_has_sse2())
+            x = convert_color_key_row_16_sse2(src_row, dst_row, width, color_key, true);
+#endif
+        for (; x < width; ++x)
         {
             WORD src_color = src_row[x];
             if (!color_in_range(color_key, src_color))
@@ -1204,7 +1284,12 @@ static void convert_b5g5r5x1_unorm_b5g5r5a1_unorm_color_key(const BYTE *src, uns
     {
         src_row = (WORD *)&src[src_pitch * y];
         dst_row = (WORD *)&dst[dst_pitch * y];
-        for (x = 0; x < width; ++x)
+        x = 0;
+#ifdef WINED3D_HAVE_SSE2
+        if (wined3d_cpu_has_sse2())
+            x = convert_color_key_row_16_sse2(src_row, dst_row, width, color_key, false);
+#endif
+        for (; x < width; ++x)
         {
             WORD src_color = src_row[x];
             if (color_in_range(color_key, src_color))
@@ -1248,7 +1333,12 @@ static void convert_b8g8r8x8_unorm_b8g8r8a8_unorm_color_key(const BYTE *src, uns
     {
         src_row = (DWORD *)&src[src_pitch * y];
         dst_row = (DWORD *)&dst[dst_pitch * y];
-        for (x = 0; x < width; ++x)
+        x = 0;
+#ifdef WINED3D_HAVE_SSE2
+        if (wined3d_cpu_has_sse2())
+            x = convert_color_key_row_32_sse2(src_row, dst_row, width, color_key, 0xff000000, 0xff000000);
+#endif
+        for (; x < width; ++x)
         {
             DWORD src_color = src_row[x];
             if (color_in_range(color_key, src_color))
@@ -1271,7 +1361,12 @@ static void convert_b8g8r8a8_unorm_b8g8r8a8_unorm_color_key(const BYTE *src, uns
     {
         src_row = (DWORD *)&src[src_pitch * y];
         dst_row = (DWORD *)&dst[dst_pitch * y];
-        for (x = 0; x < width; ++x)
+        x = 0;
+#ifdef WINED3D_HAVE_SSE2
+        if (wined3d_cpu_has_sse2())
+            x = convert_color_key_row_32_sse2(src_row, dst_row, width, color_key, 0xff000000, 0);
+#endif
+        for (; x < width; ++x)
         {
             DWORD src_color = src_row[x];
             if (color_in_range(color_key, src_color))
@@ -7537,3 +7632,230 @@ bool wined3d_allocator_init(struct wined3d_allocator *allocator,
 
     return true;
 }
+
+uint64_t wined3d_hash64(const void *data, size_t size, uint64_t hash)
+{
+    const BYTE *ptr = data;
+    size_t i;
+
+    /* FNV-1a */
+    for (i = 0; i < size; ++i)
+        hash = (hash ^ ptr[i]) * 0x100000001b3ull;
+    return hash;
+}
+
+/* The shader cache is bounded by the "ShaderCacheSize" setting. When a store
+ * takes it over the limit, the least recently used files are deleted until it
+ * is back under 3/4 of the limit. Loads update the file times, so that files
+ * that are still in use are kept. */
+static CRITICAL_SECTION wined3d_shader_cache_cs;
+static CRITICAL_SECTION_DEBUG wined3d_shader_cache_cs_debug =
+{
+    0, 0, &wined3d_shader_cache_cs,
+    {&wined3d_shader_cache_cs_debug.ProcessLocksList,
+    &wined3d_shader_cache_cs_debug.ProcessLocksList},
+    0, 0, {(DWORD_PTR)(__FILE__ ": wined3d_shader_cache_cs")}
+};
+static CRITICAL_SECTION wined3d_shader_cache_cs = {&wined3d_shader_cache_cs_debug, -1, 0, 0, 0, 0};
+
+/* Approximate size of the shader cache directory, or ~0 if it still needs to
+ * be computed. Files written by other processes are only accounted for when
+ * the directory is scanned again. */
+static uint64_t wined3d_shader_cache_size = ~(uint64_t)0;
+
+struct wined3d_shader_cache_file
+{
+    char name[MAX_PATH];
+    uint64_t size;
+    uint64_t time;
+};
+
+static int wined3d_shader_cache_file_compare(const void *a, const void *b)
+{
+    const struct wined3d_shader_cache_file *f1 = a, *f2 = b;
+
+    return f1->time < f2->time ? -1 : f1->time > f2->time;
+}
+
+/* Scans the shader cache directory and deletes the least recently used files
+ * when its size is above "target". Returns the resulting size of the directory.
+ * The caller must hold wined3d_shader_cache_cs. */
+static uint64_t wined3d_shader_cache_trim(uint64_t target)
+{
+    struct wined3d_shader_cache_file *files = NULL, *new_files;
+    SIZE_T count = 0, capacity = 0, i;
+    WIN32_FIND_DATAA data;
+    uint64_t total = 0;
+    char path[MAX_PATH];
+    HANDLE find;
+
+    if (snprintf(path, sizeof(path), "%s\\*", wined3d_settings.shader_cache_path) >= sizeof(path))
+        return 0;
+    if ((find = FindFirstFileA(path, &data)) == INVALID_HANDLE_VALUE)
+        return 0;
+    do
+    {
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            continue;
+        if (count == capacity)
+        {
+            capacity = max(capacity * 2, 64);
+            if (!(new_files = heap_realloc(files, capacity * sizeof(*files))))
+                break;
+            files = new_files;
+        }
+        lstrcpynA(files[count].name, data.cFileName, sizeof(files[count].name));
+        files[count].size = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+        files[count].time = ((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32)
+                | data.ftLastWriteTime.dwLowDateTime;
+        total += files[count].size;
+        ++count;
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+
+    if (total > target)
+    {
+        qsort(files, count, sizeof(*files), wined3d_shader_cache_file_compare);
+        for (i = 0; i < count && total > target; ++i)
+        {
+            if (snprintf(path, sizeof(path), "%s\\%s", wined3d_settings.shader_cache_path,
+                    files[i].name) >= sizeof(path))
+                continue;
+            if (DeleteFileA(path))
+                total -= files[i].size;
+        }
+        TRACE("Shader cache trimmed to %s bytes.\n", wine_dbgstr_longlong(total));
+    }
+
+    heap_free(files);
+    return total;
+}
+
+/* Called once at process attach, when the "ShaderCachePath" setting is set. */
+void wined3d_shader_cache_init(void)
+{
+    if (!CreateDirectoryA(wined3d_settings.shader_cache_path, NULL) && GetLastError() != ERROR_ALREADY_EXISTS)
+        WARN("Failed to create shader cache directory %s, error %u.\n",
+                debugstr_a(wined3d_settings.shader_cache_path), GetLastError());
+}
+
+static void wined3d_shader_cache_add_size(size_t size)
+{
+    uint64_t limit = (uint64_t)wined3d_settings.shader_cache_size << 20;
+
+    if (!limit)
+        return;
+
+    EnterCriticalSection(&wined3d_shader_cache_cs);
+    if (wined3d_shader_cache_size == ~(uint64_t)0)
+        wined3d_shader_cache_size = wined3d_shader_cache_trim(limit);
+    wined3d_shader_cache_size += size;
+    if (wined3d_shader_cache_size > limit)
+        wined3d_shader_cache_size = wined3d_shader_cache_trim(limit / 4 * 3);
+    LeaveCriticalSection(&wined3d_shader_cache_cs);
+}
+
+static char *wined3d_shader_cache_get_path(const char *name)
+{
+    size_t len;
+    char *path;
+
+    if (!wined3d_settings.shader_cache_path)
+        return NULL;
+    len = strlen(wined3d_settings.shader_cache_path);
+    if (!(path = heap_alloc(len + strlen(name) + 2)))
+        return NULL;
+    sprintf(path, "%s\\%s", wined3d_settings.shader_cache_path, name);
+    return path;
+}
+
+/* Returns the contents of a file in the shader cache directory, or NULL if it
+ * doesn't exist. The caller is responsible for validating the contents. */
+void *wined3d_shader_cache_load(const char *name, size_t *size)
+{
+    LARGE_INTEGER file_size;
+    void *data = NULL;
+    HANDLE file;
+    DWORD read;
+    char *path;
+
+    if (!(path = wined3d_shader_cache_get_path(name)))
+        return NULL;
+
+    if ((file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+            NULL, OPEN_EXISTING, 0, NULL)) == INVALID_HANDLE_VALUE)
+    {
+        heap_free(path);
+        return NULL;
+    }
+
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart && file_size.QuadPart < 256 * 1024 * 1024
+            && (data = heap_alloc(file_size.QuadPart)))
+    {
+        if (ReadFile(file, data, file_size.QuadPart, &read, NULL) && read == file_size.QuadPart)
+        {
+            *size = read;
+        }
+        else
+        {
+            heap_free(data);
+            data = NULL;
+        }
+    }
+    CloseHandle(file);
+
+    if (data)
+    {
+        FILETIME now;
+
+        /* Mark the file as recently used, for wined3d_shader_cache_trim(). This
+         * may fail, e.g. on a read-only cache directory, which is fine. */
+        if ((file = CreateFileA(path, FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                NULL, OPEN_EXISTING, 0, NULL)) != INVALID_HANDLE_VALUE)
+        {
+            GetSystemTimeAsFileTime(&now);
+            SetFileTime(file, NULL, NULL, &now);
+            CloseHandle(file);
+        }
+    }
+    heap_free(path);
+    return data;
+}
+
+/* Atomically replaces a file in the shader cache directory. */
+bool wined3d_shader_cache_store(const char *name, const void *header, size_t header_size,
+        const void *data, size_t size)
+{
+    char *path, *tmp_path;
+    bool ret = false;
+    DWORD written;
+    HANDLE file;
+
+    if (!(path = wined3d_shader_cache_get_path(name)))
+        return false;
+    if (!(tmp_path = heap_alloc(strlen(path) + 16)))
+    {
+        heap_free(path);
+        return false;
+    }
+    sprintf(tmp_path, "%s.%x", path, GetCurrentThreadId());
+
+    if ((file = CreateFileA(tmp_path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, NULL)) != INVALID_HANDLE_VALUE)
+    {
+        ret = WriteFile(file, header, header_size, &written, NULL) && written == header_size
+                && (!size || (WriteFile(file, data, size, &written, NULL) && written == size));
+        CloseHandle(file);
+        if (ret)
+            ret = MoveFileExA(tmp_path, path, MOVEFILE_REPLACE_EXISTING);
+        if (!ret)
+            DeleteFileA(tmp_path);
+    }
+    if (ret)
+        wined3d_shader_cache_add_size(header_size + size);
+    else
+        WARN("Failed to write shader cache file %s.\n", debugstr_a(path));
+
+    heap_free(tmp_path);
+    heap_free(path);
+    return ret;
+}
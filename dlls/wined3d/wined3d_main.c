@@ -126,6 +126,7 @@ struct wined3d_settings wined3d_settings =
     .max_sm_cs = UINT_MAX,
     .renderer = WINED3D_RENDERER_AUTO,
     .shader_backend = WINED3D_SHADER_BACKEND_AUTO,
+    .shader_cache_size = 256,
 };
 
 struct wined3d * CDECL wined3d_create(DWORD flags)
@@ -352,6 +353,18 @@ static BOOL wined3d_dll_init(HINSTANCE hInstDLL)
             else
                 memcpy(wined3d_settings.logo, buffer, len);
         }
+        if (!get_config_key(hkey, appkey, "ShaderCachePath", buffer, size) && buffer[0])
+        {
+            size_t len = strlen(buffer) + 1;
+
+            if (!(wined3d_settings.shader_cache_path = heap_alloc(len)))
+                ERR("Failed to allocate shader cache path memory.\n");
+            else
+                memcpy(wined3d_settings.shader_cache_path, buffer, len);
+            TRACE("Using shader cache directory %s.\n", debugstr_a(buffer));
+        }
+        if (!get_config_key_dword(hkey, appkey, "ShaderCacheSize", &wined3d_settings.shader_cache_size))
+            TRACE("Limiting the shader cache to %u MiB.\n", wined3d_settings.shader_cache_size);
         if (!get_config_key_dword(hkey, appkey, "MultisampleTextures", &wined3d_settings.multisample_textures))
             ERR_(winediag)("Setting multisample textures to %#x.\n", wined3d_settings.multisample_textures);
         if (!get_config_key_dword(hkey, appkey, "SampleCount", &wined3d_settings.sample_count))
@@ -395,6 +408,34 @@ static BOOL wined3d_dll_init(HINSTANCE hInstDLL)
                 wined3d_settings.renderer = WINED3D_RENDERER_NO3D;
             }
         }
+        if (!get_config_key(hkey, appkey, "AsyncPipelineCompile", buffer, size))
+        {
+            if (!strcmp(buffer, "skip"))
+            {
+                ERR_(winediag)("Skipping draws while their pipeline is being compiled.\n");
+                wined3d_settings.pipeline_compile_mode = WINED3D_PIPELINE_COMPILE_SKIP;
+            }
+            else if (!strcmp(buffer, "fallback"))
+            {
+                ERR_(winediag)("Using fallback pipelines while pipelines are being compiled.\n");
+                wined3d_settings.pipeline_compile_mode = WINED3D_PIPELINE_COMPILE_FALLBACK;
+            }
+            else if (!strcmp(buffer, "wait"))
+            {
+                TRACE("Compiling pipelines synchronously.\n");
+                wined3d_settings.pipeline_compile_mode = WINED3D_PIPELINE_COMPILE_WAIT;
+            }
+        }
+        if (!get_config_key(hkey, appkey, "CSProfile", buffer, size) && buffer[0])
+        {
+            size_t len = strlen(buffer) + 1;
+
+            if (!(wined3d_settings.cs_profile_path = heap_alloc(len)))
+                ERR("Failed to allocate command stream profile path memory.\n");
+            else
+                memcpy(wined3d_settings.cs_profile_path, buffer, len);
+            ERR_(winediag)("Writing command stream statistics to %s.\n", debugstr_a(buffer));
+        }
         if (!get_config_key_dword(hkey, appkey, "cb_access_map_w", &tmpvalue) && tmpvalue)
         {
             TRACE("Forcing all constant buffers to be write-mappable.\n");
@@ -405,6 +446,9 @@ static BOOL wined3d_dll_init(HINSTANCE hInstDLL)
     if (appkey) RegCloseKey( appkey );
     if (hkey) RegCloseKey( hkey );
 
+    if (wined3d_settings.shader_cache_path)
+        wined3d_shader_cache_init();
+
     return TRUE;
 }
 
@@ -442,6 +486,8 @@ static BOOL wined3d_dll_destroy(HINSTANCE hInstDLL)
     heap_free(swapchain_state_table.hooks);
 
     heap_free(wined3d_settings.logo);
+    heap_free(wined3d_settings.shader_cache_path);
+    heap_free(wined3d_settings.cs_profile_path);
     UnregisterClassA(WINED3D_OPENGL_WINDOW_CLASS_NAME, hInstDLL);
 
     DeleteCriticalSection(&wined3d_command_cs);
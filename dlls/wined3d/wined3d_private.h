@@ -469,6 +469,13 @@ enum wined3d_shader_backend
     WINED3D_SHADER_BACKEND_NONE,
 };
 
+enum wined3d_pipeline_compile_mode
+{
+    WINED3D_PIPELINE_COMPILE_WAIT,
+    WINED3D_PIPELINE_COMPILE_SKIP,
+    WINED3D_PIPELINE_COMPILE_FALLBACK,
+};
+
 #define WINED3D_CSMT_ENABLE    0x00000001
 #define WINED3D_CSMT_SERIALIZE 0x00000002
 
@@ -497,10 +504,20 @@ struct wined3d_settings
     enum wined3d_renderer renderer;
     enum wined3d_shader_backend shader_backend;
     BOOL cb_access_map_w;
+    char *shader_cache_path;
+    unsigned int shader_cache_size;
+    enum wined3d_pipeline_compile_mode pipeline_compile_mode;
+    char *cs_profile_path;
 };
 
 extern struct wined3d_settings wined3d_settings DECLSPEC_HIDDEN;
 
+uint64_t wined3d_hash64(const void *data, size_t size, uint64_t hash) DECLSPEC_HIDDEN;
+void wined3d_shader_cache_init(void) DECLSPEC_HIDDEN;
+void *wined3d_shader_cache_load(const char *name, size_t *size) DECLSPEC_HIDDEN;
+bool wined3d_shader_cache_store(const char *name, const void *header, size_t header_size,
+        const void *data, size_t size) DECLSPEC_HIDDEN;
+
 enum wined3d_shader_byte_code_format
 {
     WINED3D_SHADER_BYTE_CODE_FORMAT_SM1,
@@ -2517,13 +2534,31 @@ struct wined3d_graphics_pipeline_key_vk
     VkPipelineDynamicStateCreateInfo dynamic_desc;
 
     VkGraphicsPipelineCreateInfo pipeline_desc;
+
+    uint64_t hash;
 };
 
 struct wined3d_graphics_pipeline_vk
 {
-    struct wine_rb_entry entry;
     struct wined3d_graphics_pipeline_key_vk key;
     VkPipeline vk_pipeline;
+    struct wined3d_context_vk *context_vk;
+    LONG compiling;
+    /* Asynchronously compiled pipelines stay in the context's pending list
+     * until the CS thread notices that the compile is done. */
+    struct list pending_entry;
+    /* Compatible pipeline to use while this one is compiling, found once per
+     * completed compile instead of on every draw. */
+    struct wined3d_graphics_pipeline_vk *fallback;
+    bool fallback_searched;
+};
+
+/* Open addressing with linear probing; "size" is a power of two. */
+struct wined3d_graphics_pipeline_table_vk
+{
+    struct wined3d_graphics_pipeline_vk **entries;
+    size_t size;
+    size_t count;
 };
 
 enum wined3d_shader_descriptor_type
@@ -2557,6 +2592,46 @@ struct wined3d_shader_descriptor_writes_vk
     SIZE_T size, count;
 };
 
+#define WINED3D_UPLOAD_RING_SIZE_VK (8 * 1024 * 1024)
+
+/* A persistently mapped buffer that staging uploads are sub-allocated from.
+ * Each fence records the ring position reached by the allocations made for a
+ * command buffer; that part of the ring can be reused once the command
+ * buffer has completed. */
+struct wined3d_upload_ring_vk
+{
+    struct wined3d_bo_vk bo;
+    bool disabled;
+    VkDeviceSize head, tail;
+
+    struct wined3d_upload_ring_fence_vk
+    {
+        uint64_t command_buffer_id;
+        VkDeviceSize end;
+    } *fences;
+    SIZE_T fences_size, fence_count;
+
+    unsigned int allocation_count;
+    unsigned int fallback_count;
+    uint64_t allocated_size;
+};
+
+struct wined3d_descriptor_set_cache_entry_vk
+{
+    uint64_t hash;
+    VkDescriptorSet vk_descriptor_set;  /* VK_NULL_HANDLE if the entry is unused */
+    VkDescriptorPool vk_descriptor_pool;
+    uint64_t *key;
+    SIZE_T key_size, key_count;
+};
+
+struct wined3d_descriptor_set_cache_vk
+{
+    struct wined3d_descriptor_set_cache_entry_vk entries[256];
+    uint64_t *key;
+    SIZE_T key_size, key_count;
+};
+
 struct wined3d_pending_query_vk
 {
     struct wined3d_query_vk *query_vk;
@@ -2579,7 +2654,8 @@ struct wined3d_context_vk
 
     uint32_t update_compute_pipeline : 1;
     uint32_t update_stream_output : 1;
-    uint32_t padding : 30;
+    uint32_t graphics_pipeline_pending : 1;
+    uint32_t padding : 29;
 
     struct
     {
@@ -2612,6 +2688,8 @@ struct wined3d_context_vk
     } submitted;
 
     struct wined3d_shader_descriptor_writes_vk descriptor_writes;
+    struct wined3d_descriptor_set_cache_vk descriptor_sets;
+    struct wined3d_upload_ring_vk upload_ring;
 
     VkFramebuffer vk_framebuffer;
     VkRenderPass vk_render_pass;
@@ -2636,8 +2714,24 @@ struct wined3d_context_vk
     struct wined3d_retired_objects_vk retired;
     struct wine_rb_tree render_passes;
     struct wine_rb_tree pipeline_layouts;
-    struct wine_rb_tree graphics_pipelines;
+    struct wined3d_graphics_pipeline_table_vk graphics_pipelines;
+    struct list pending_graphics_pipelines;
     struct wine_rb_tree bo_slab_available;
+
+    CRITICAL_SECTION pipeline_compile_cs;
+    CONDITION_VARIABLE pipeline_compile_cv;
+    unsigned int pipeline_compile_count;
+    struct
+    {
+        unsigned int stalled;
+        unsigned int async;
+        unsigned int skipped;
+        unsigned int fallback;
+        unsigned int draws;
+        uint64_t draw_state_time;
+        unsigned int descriptor_sets_written;
+        unsigned int descriptor_sets_reused;
+    } pipeline_stats;
 };
 
 static inline struct wined3d_context_vk *wined3d_context_vk(struct wined3d_context *context)
@@ -2659,6 +2753,8 @@ VkCommandBuffer wined3d_context_vk_apply_draw_state(struct wined3d_context_vk *c
 void wined3d_context_vk_cleanup(struct wined3d_context_vk *context_vk) DECLSPEC_HIDDEN;
 BOOL wined3d_context_vk_create_bo(struct wined3d_context_vk *context_vk, VkDeviceSize size,
         VkBufferUsageFlags usage, VkMemoryPropertyFlags memory_type, struct wined3d_bo_vk *bo) DECLSPEC_HIDDEN;
+BOOL wined3d_context_vk_create_upload_bo(struct wined3d_context_vk *context_vk, VkDeviceSize size,
+        VkDeviceSize alignment, struct wined3d_bo_vk *bo) DECLSPEC_HIDDEN;
 BOOL wined3d_context_vk_create_image(struct wined3d_context_vk *context_vk, VkImageType vk_image_type,
         VkImageUsageFlags usage, VkFormat vk_format, unsigned int width, unsigned int height, unsigned int depth,
         unsigned int sample_count, unsigned int mip_levels, unsigned int layer_count, unsigned int flags,
@@ -2669,6 +2765,8 @@ void wined3d_context_vk_destroy_bo(struct wined3d_context_vk *context_vk,
         const struct wined3d_bo_vk *bo) DECLSPEC_HIDDEN;
 void wined3d_context_vk_destroy_image(struct wined3d_context_vk *context_vk,
         struct wined3d_image_vk *image_vk) DECLSPEC_HIDDEN;
+void wined3d_context_vk_destroy_upload_bo(struct wined3d_context_vk *context_vk,
+        struct wined3d_bo_vk *bo) DECLSPEC_HIDDEN;
 void wined3d_context_vk_destroy_vk_buffer_view(struct wined3d_context_vk *context_vk,
         VkBufferView vk_view, uint64_t command_buffer_id) DECLSPEC_HIDDEN;
 void wined3d_context_vk_destroy_vk_framebuffer(struct wined3d_context_vk *context_vk,
@@ -2694,13 +2792,17 @@ void wined3d_context_vk_image_barrier(struct wined3d_context_vk *context_vk,
         VkImageLayout new_layout, VkImage image, const VkImageSubresourceRange *range) DECLSPEC_HIDDEN;
 HRESULT wined3d_context_vk_init(struct wined3d_context_vk *context_vk,
         struct wined3d_swapchain *swapchain) DECLSPEC_HIDDEN;
+void wined3d_context_vk_invalidate_descriptor_sets(struct wined3d_context_vk *context_vk,
+        uint64_t handle) DECLSPEC_HIDDEN;
 void wined3d_context_vk_poll_command_buffers(struct wined3d_context_vk *context_vk) DECLSPEC_HIDDEN;
+void wined3d_context_vk_report_pipeline_stats(struct wined3d_context_vk *context_vk) DECLSPEC_HIDDEN;
 void wined3d_context_vk_remove_pending_queries(struct wined3d_context_vk *context_vk,
         struct wined3d_query_vk *query_vk) DECLSPEC_HIDDEN;
 void wined3d_context_vk_submit_command_buffer(struct wined3d_context_vk *context_vk,
         unsigned int wait_semaphore_count, const VkSemaphore *wait_semaphores, const VkPipelineStageFlags *wait_stages,
         unsigned int signal_semaphore_count, const VkSemaphore *signal_semaphores) DECLSPEC_HIDDEN;
 void wined3d_context_vk_wait_command_buffer(struct wined3d_context_vk *context_vk, uint64_t id) DECLSPEC_HIDDEN;
+void wined3d_context_vk_wait_pipeline_compiles(struct wined3d_context_vk *context_vk) DECLSPEC_HIDDEN;
 VkResult wined3d_context_vk_create_vk_descriptor_set(struct wined3d_context_vk *context_vk,
         VkDescriptorSetLayout vk_set_layout, VkDescriptorSet *vk_descriptor_set) DECLSPEC_HIDDEN;
 
@@ -3508,6 +3610,7 @@ struct wined3d_adapter_vk
 
     VkPhysicalDeviceLimits device_limits;
     VkPhysicalDeviceMemoryProperties memory_properties;
+    uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
 };
 
 static inline struct wined3d_adapter_vk *wined3d_adapter_vk(struct wined3d_adapter *adapter)
@@ -4110,6 +4213,9 @@ struct wined3d_device_vk
 
     struct wined3d_vk_info vk_info;
 
+    VkPipelineCache vk_pipeline_cache;
+    char pipeline_cache_name[32];
+
     struct wined3d_null_resources_vk null_resources_vk;
     struct wined3d_null_views_vk null_views_vk;
 
@@ -4908,6 +5014,8 @@ struct wined3d_cs
     HANDLE event;
     BOOL waiting_for_event;
     LONG pending_presents;
+
+    struct wined3d_cs_profile *profile;
 };
 
 static inline void wined3d_device_context_lock(struct wined3d_device_context *context)
@@ -5963,6 +6071,14 @@ struct wined3d_rational
     UINT denominator;
 };
 
+/* The SSE2 paths are compiled for any x86 target, and selected at runtime
+ * with wined3d_cpu_has_sse2(). */
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define WINED3D_HAVE_SSE2
+#define WINED3D_SSE2_FUNC __attribute__((target("sse2")))
+bool wined3d_cpu_has_sse2(void) DECLSPEC_HIDDEN;
+#endif
+
 struct wined3d_color_key_conversion
 {
     enum wined3d_format_id dst_format;
@@ -317,6 +317,18 @@ NTSTATUS WINAPI wow64___wine_dbg_write( UINT *args )
 }
 
 
+/**********************************************************************
+ *           wow64___wine_dbg_write_record
+ */
+NTSTATUS WINAPI wow64___wine_dbg_write_record( UINT *args )
+{
+    const void *data = get_ptr( &args );
+    ULONG len = get_ulong( &args );
+
+    return __wine_dbg_write_record( data, len );
+}
+
+
 /**********************************************************************
  *           wow64___wine_unix_call
  */
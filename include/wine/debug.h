@@ -144,6 +144,7 @@ struct __wine_debug_channel
 #endif  /* !__GNUC__ && !__SUNPRO_C */
 
 extern int WINAPI __wine_dbg_write( const char *str, unsigned int len );
+extern int WINAPI __wine_dbg_write_record( const void *data, unsigned int len );
 extern unsigned char __cdecl __wine_dbg_get_channel_flags( struct __wine_debug_channel *channel );
 extern const char * __cdecl __wine_dbg_strdup( const char *str );
 extern int __cdecl __wine_dbg_output( const char *str );
@@ -171,6 +172,10 @@ extern void __cdecl __wine_set_unix_env( const char *var, const char *val );
 # define __wine_dbg_va_end(list) va_end(list)
 #endif
 
+/* returns -2 without using the arguments when binary trace records are disabled */
+extern int __wine_dbg_cdecl __wine_dbg_vlog( enum __wine_debug_class cls, struct __wine_debug_channel *channel,
+                                             const char *function, const char *format, __wine_dbg_va_list args );
+
 static const char * __wine_dbg_cdecl wine_dbg_sprintf( const char *format, ... ) __WINE_PRINTF_ATTR(1,2);
 static inline const char * __wine_dbg_cdecl wine_dbg_sprintf( const char *format, ... )
 {
@@ -202,6 +207,7 @@ static inline int __wine_dbg_cdecl wine_dbg_log( enum __wine_debug_class cls,
                                                  struct __wine_debug_channel *channel,
                                                  const char *function, const char *format, ... )
 {
+    static int use_records = 1;
     char buffer[1024];
     __wine_dbg_va_list args;
     int ret;
@@ -211,6 +217,14 @@ static inline int __wine_dbg_cdecl wine_dbg_log( enum __wine_debug_class cls,
         format++;
         function = NULL;
     }
+    if (use_records)
+    {
+        __wine_dbg_va_start( args, format );
+        ret = __wine_dbg_vlog( cls, channel, function, format, args );
+        __wine_dbg_va_end( args );
+        if (ret != -2) return ret;
+        use_records = 0;
+    }
     if ((ret = __wine_dbg_header( cls, channel, function )) == -1) return ret;
 
     __wine_dbg_va_start( args, format );